@@ -0,0 +1,1736 @@
+/*
+ * acq.c:
+ *	Acquisition engine: one polling thread per i2c bus reading all the
+ *	temperatures of every card on its bus every period, so the buses are
+ *	polled in parallel and a slow bus does not delay the others
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "smtc.h"
+#include "comm.h"
+#include "acq.h"
+#include "out.h"
+#include "deadband.h"
+#include "filter.h"
+#include "digest.h"
+#include "ror.h"
+#include "alarm.h"
+#include "hist.h"
+#include "thread.h"
+#include "flight.h"
+#include "journal.h"
+#include "led.h"
+
+#define STREAM_DEFAULT_PERIOD_MS	1000
+
+#define ACQ_DECAY_DIV	4
+
+#define ACQ_PHASE_STEP_DIV	16 // edge search step and late correction, of a cycle
+#define ACQ_PHASE_DRIFT_DIV	256 // early drift per fresh read, of a cycle
+#define ACQ_PHASE_GUARD_DIV	64 // read this long after the expected update
+#define ACQ_PHASE_LOST		4 // stale reads in a row that restart the search
+#define ACQ_PHASE_PLAIN		16 // plain reads after a search found no update
+
+#define ACQ_RT_STACK_SIZE	(256 * 1024)
+#define ACQ_RT_PRI_DEFAULT	50
+
+typedef struct
+{
+	int valid;
+	uint32_t periodUs;
+	uint64_t nextUs;
+	uint64_t lastUs;
+	int16_t last[SMTC_CH_NR];
+} AcqRateType;
+
+typedef struct
+{
+	uint32_t cycleUs; // ADC conversion cycle, 0 - unknown
+	uint32_t every; // cycles between two reports
+	uint64_t edgeUs; // expected time of the update being waited for
+	uint64_t nextUs;
+	int valid;
+	int locked;
+	int search; // reads since the search started
+	int stale; // stale reads in a row while locked
+	int plain; // plain reads left before the next search
+	int16_t last[SMTC_CH_NR];
+} AcqPhaseType;
+
+typedef struct
+{
+	int bus;
+	int boards;
+	SmtcBoardType board[SMTC_STACK_MAX];
+	AcqRateType rate[SMTC_STACK_MAX];
+	AcqPhaseType phase[SMTC_STACK_MAX];
+	uint32_t reads;
+	uint32_t stale;
+	uint64_t diagNextUs;
+	int cpu;
+	HistType jitter; // us late at each wake up
+	const AcqCfgType *cfg;
+	pthread_t thread;
+	int started;
+} AcqBusType;
+
+static volatile sig_atomic_t gAcqStop = 0;
+static pthread_mutex_t gAcqSinkMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t gAcqReads = 0;
+static uint32_t gAcqStale = 0;
+static int gAcqRtFail = 0;
+static HistType gAcqJitter;
+
+void acqStop(void)
+{
+	gAcqStop = 1;
+}
+
+static void acqSleepUntilUs(uint64_t us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = (time_t) (us / 1000000ULL);
+	ts.tv_nsec = (long) (us % 1000000ULL) * 1000L;
+	while (!gAcqStop
+		&& EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+		;
+}
+
+static uint64_t acqTsUs(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000ULL + (uint64_t)ts->tv_nsec / 1000;
+}
+
+/*
+ * acqJitter:
+ *	Count how late the thread woke up for a read due at dueUs
+ */
+static void acqJitter(AcqBusType *b, uint64_t dueUs)
+{
+	uint64_t now = commTimeUs();
+
+	histAdd(&b->jitter, now > dueUs ? now - dueUs : 0);
+}
+
+/*
+ * acqThreadStart:
+ *	Real time setup of a bus thread, done by the thread itself
+ */
+static void acqThreadStart(AcqBusType *b)
+{
+	const AcqCfgType *cfg = b->cfg;
+
+	if (cfg->rtPri > 0 && 0 != piThreadRt(b->cpu, cfg->rtPri))
+	{
+		gAcqRtFail = 1;
+	}
+}
+
+static void acqNext(struct timespec *next, int periodMs)
+{
+	struct timespec now;
+
+	next->tv_nsec += (long)periodMs * 1000000L;
+	while (next->tv_nsec >= 1000000000L)
+	{
+		next->tv_nsec -= 1000000000L;
+		next->tv_sec++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	// overrun: skip the missed periods instead of bursting to catch up
+	if (now.tv_sec > next->tv_sec
+		|| (now.tv_sec == next->tv_sec && now.tv_nsec > next->tv_nsec))
+	{
+		*next = now;
+		return;
+	}
+	while (!gAcqStop
+		&& EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, next, NULL))
+		;
+}
+
+/*
+ * acqDiagRead:
+ *	Health registers of every card of the bus every cfg->diagPeriodMs, in
+ *	the round that is due. Called with the bus locked, returns the number
+ *	of records in d[].
+ */
+static int acqDiagRead(AcqBusType *b, AcqDiagType *d)
+{
+	const AcqCfgType *cfg = b->cfg;
+	uint64_t now = commTimeUs();
+	int i;
+
+	if (cfg->diagPeriodMs <= 0 || NULL == cfg->diagSink || now < b->diagNextUs)
+	{
+		return 0;
+	}
+	b->diagNextUs = now + (uint64_t)cfg->diagPeriodMs * 1000;
+	for (i = 0; i < b->boards; i++)
+	{
+		d[i].bus = b->bus;
+		d[i].stack = b->board[i].stack;
+		d[i].ret = smtcDiagRawGet(&b->board[i], &d[i].diag);
+		d[i].tUs = commTimeUs();
+	}
+	return b->boards;
+}
+
+/*
+ * acqBusThread:
+ *	Poll the cards of one bus. The bus is locked for the whole round so
+ *	the samples of a round are consistent, and released between rounds.
+ *	Cards demoted to the slow tier are read every COMM_SLOW_TIER_DIV rounds.
+ */
+static void* acqBusThread(void *arg)
+{
+	AcqBusType *b = (AcqBusType*)arg;
+	const AcqCfgType *cfg = b->cfg;
+	AcqSampleType s[SMTC_STACK_MAX];
+	AcqDiagType d[SMTC_STACK_MAX];
+	struct timespec next;
+	uint64_t dueUs;
+	uint32_t round;
+	int periodMs = cfg->periodMs;
+	int i, n, nd;
+
+	acqThreadStart(b);
+	// the bus budget stretches the period
+	if (cfg->budget > 0 && b->boards * 1000 > cfg->budget * periodMs)
+	{
+		periodMs = (b->boards * 1000 + cfg->budget - 1) / cfg->budget;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (round = 0; !gAcqStop && (cfg->rounds == 0 || round < cfg->rounds);
+		round++)
+	{
+		n = 0;
+		commLock(b->bus);
+		for (i = 0; i < b->boards; i++)
+		{
+			if (!commPollDue(b->bus, SLAVE_OWN_ADDRESS_BASE + b->board[i].stack,
+				round))
+			{
+				continue;
+			}
+			s[n].bus = b->bus;
+			s[n].stack = b->board[i].stack;
+			s[n].ret = smtcReadRawAll(&b->board[i], s[n].raw);
+			s[n].tUs = commTimeUs();
+			n++;
+		}
+		nd = acqDiagRead(b, d);
+		commUnlock(b->bus);
+		pthread_mutex_lock(&gAcqSinkMutex);
+		for (i = 0; i < n; i++)
+		{
+			cfg->sink(&s[i], cfg->arg);
+		}
+		for (i = 0; i < nd; i++)
+		{
+			cfg->diagSink(&d[i], cfg->arg);
+		}
+		pthread_mutex_unlock(&gAcqSinkMutex);
+		if (cfg->rounds == 0 || round + 1 < cfg->rounds)
+		{
+			dueUs = acqTsUs(&next) + (uint64_t)periodMs * 1000;
+			acqNext(&next, periodMs);
+			acqJitter(b, dueUs);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * acqRateUpdate:
+ *	New period of a card after a read: the fastest one as soon as any
+ *	channel changes faster than the threshold, then back to the slowest
+ *	one by 1/ACQ_DECAY_DIV of the period at every quiet read.
+ */
+static void acqRateUpdate(const AcqCfgType *cfg, AcqRateType *r,
+	const AcqSampleType *s)
+{
+	int64_t diff, maxDiff = 0;
+	uint64_t dt;
+	uint32_t minUs = (uint32_t)cfg->minPeriodMs * 1000;
+	uint32_t maxUs = (uint32_t)cfg->periodMs * 1000;
+	int ch;
+
+	if (s->ret != SMTC_OK)
+	{
+		return;
+	}
+	if (r->valid && s->tUs > r->lastUs)
+	{
+		for (ch = 0; ch < SMTC_CH_NR; ch++)
+		{
+			diff = (int64_t)s->raw[ch] - r->last[ch];
+			if (diff < 0)
+			{
+				diff = -diff;
+			}
+			if (diff > maxDiff)
+			{
+				maxDiff = diff;
+			}
+		}
+		dt = s->tUs - r->lastUs;
+		if ((uint64_t)maxDiff * 1000000ULL > (uint64_t)cfg->rateThr * dt)
+		{
+			r->periodUs = minUs;
+		}
+		else
+		{
+			r->periodUs += r->periodUs / ACQ_DECAY_DIV + 1000;
+		}
+	}
+	if (r->periodUs < minUs)
+	{
+		r->periodUs = minUs;
+	}
+	if (r->periodUs > maxUs)
+	{
+		r->periodUs = maxUs;
+	}
+	memcpy(r->last, s->raw, sizeof(r->last));
+	r->lastUs = s->tUs;
+	r->valid = 1;
+}
+
+/*
+ * acqBusAdaptive:
+ *	Poll the cards of one bus each at its own rate (see acqRateUpdate()).
+ *	When the rates add up to more than the bus budget all the periods are
+ *	stretched by the same factor. A pass reads the cards that are due and
+ *	sleeps until the next one is.
+ */
+static void* acqBusAdaptive(void *arg)
+{
+	AcqBusType *b = (AcqBusType*)arg;
+	const AcqCfgType *cfg = b->cfg;
+	AcqSampleType s[SMTC_STACK_MAX];
+	AcqDiagType d[SMTC_STACK_MAX];
+	uint64_t now, wake, load, periodUs;
+	uint32_t pass;
+	int i, n, nd;
+
+	acqThreadStart(b);
+	now = commTimeUs();
+	for (i = 0; i < b->boards; i++)
+	{
+		b->rate[i].periodUs = (uint32_t)cfg->periodMs * 1000;
+		b->rate[i].nextUs = now;
+	}
+	for (pass = 0; !gAcqStop && (cfg->rounds == 0 || pass < cfg->rounds);
+		pass++)
+	{
+		n = 0;
+		now = commTimeUs();
+		commLock(b->bus);
+		for (i = 0; i < b->boards; i++)
+		{
+			if (b->rate[i].nextUs > now)
+			{
+				continue;
+			}
+			s[n].bus = b->bus;
+			s[n].stack = b->board[i].stack;
+			s[n].ret = smtcReadRawAll(&b->board[i], s[n].raw);
+			s[n].tUs = commTimeUs();
+			acqRateUpdate(cfg, &b->rate[i], &s[n]);
+			n++;
+		}
+		nd = acqDiagRead(b, d);
+		commUnlock(b->bus);
+		// reads per second wanted, x1000000 to stay in integers
+		load = 0;
+		for (i = 0; i < b->boards; i++)
+		{
+			load += 1000000000000ULL / b->rate[i].periodUs;
+		}
+		wake = UINT64_MAX;
+		for (i = 0; i < b->boards; i++)
+		{
+			if (b->rate[i].nextUs <= now)
+			{
+				periodUs = b->rate[i].periodUs;
+				if (cfg->budget > 0 && load > (uint64_t)cfg->budget * 1000000ULL)
+				{
+					periodUs = periodUs * load / ((uint64_t)cfg->budget * 1000000ULL);
+				}
+				b->rate[i].nextUs += periodUs;
+				if (b->rate[i].nextUs <= now)
+				{
+					b->rate[i].nextUs = now + periodUs;
+				}
+			}
+			if (b->rate[i].nextUs < wake)
+			{
+				wake = b->rate[i].nextUs;
+			}
+		}
+		pthread_mutex_lock(&gAcqSinkMutex);
+		for (i = 0; i < n; i++)
+		{
+			cfg->sink(&s[i], cfg->arg);
+		}
+		for (i = 0; i < nd; i++)
+		{
+			cfg->diagSink(&d[i], cfg->arg);
+		}
+		pthread_mutex_unlock(&gAcqSinkMutex);
+		if (cfg->rounds == 0 || pass + 1 < cfg->rounds)
+		{
+			acqSleepUntilUs(wake);
+			acqJitter(b, wake);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * acqPhaseInit:
+ *	Conversion cycle of a card from its ADC sample rates: each ADC converts
+ *	its SMTC_ADC_CH_NR channels in turn, a card has new values for all its
+ *	channels once the slower ADC went through them.
+ */
+static void acqPhaseInit(const AcqCfgType *cfg, SmtcBoardType *board,
+	AcqPhaseType *p, uint64_t now)
+{
+	SmtcAdcType adc;
+	int sps;
+
+	p->cycleUs = 0;
+	p->locked = 0;
+	p->search = 0;
+	p->stale = 0;
+	if (SMTC_OK == smtcAdcGet(board, &adc))
+	{
+		sps = adc.sps[0] < adc.sps[1] ? adc.sps[0] : adc.sps[1];
+		if (sps > 0)
+		{
+			p->cycleUs = SMTC_ADC_CH_NR * 1000000 / sps;
+		}
+	}
+	p->every = 1;
+	if (p->cycleUs > 0)
+	{
+		p->every = ((uint32_t)cfg->periodMs * 1000 + p->cycleUs - 1) / p->cycleUs;
+	}
+	p->nextUs = now;
+}
+
+/*
+ * acqPhaseUpdate:
+ *	Schedule the next read of a card after a read at s->tUs and tell if the
+ *	sample goes to the sink. Reads that return the previous values (the
+ *	ADC did not convert again yet) are dropped. Until the update time is
+ *	known the card is read every 1/ACQ_PHASE_STEP_DIV of a cycle; the first
+ *	change locks the phase and from then on the card is read just after the
+ *	expected update. A fresh read pulls the expected update a little
+ *	earlier and a stale one pushes it later, so the reads follow the drift
+ *	between the card and the Raspberry clocks.
+ */
+static int acqPhaseUpdate(const AcqCfgType *cfg, SmtcBoardType *board,
+	AcqPhaseType *p, const AcqSampleType *s)
+{
+	uint64_t t = s->tUs;
+	uint32_t step = p->cycleUs / ACQ_PHASE_STEP_DIV;
+	int fresh;
+
+	if (s->ret != SMTC_OK || p->cycleUs == 0 || p->plain > 0)
+	{
+		if (p->plain > 0)
+		{
+			p->plain--;
+		}
+		p->nextUs = t + (uint64_t)cfg->periodMs * 1000;
+		return 1;
+	}
+	fresh = !p->valid || 0 != memcmp(p->last, s->raw, sizeof(p->last));
+	memcpy(p->last, s->raw, sizeof(p->last));
+	if (!p->valid)
+	{
+		// a first value, but not an update time
+		p->valid = 1;
+		p->nextUs = t + step;
+		return 1;
+	}
+	if (fresh)
+	{
+		if (p->locked)
+		{
+			p->edgeUs -= p->cycleUs / ACQ_PHASE_DRIFT_DIV;
+		}
+		else
+		{
+			p->edgeUs = t;
+			p->locked = 1;
+		}
+		p->stale = 0;
+		p->search = 0;
+		p->edgeUs += (uint64_t)p->every * p->cycleUs;
+		if (p->edgeUs <= t)
+		{
+			// overrun, keep the phase and skip the missed cycles
+			p->edgeUs += ((t - p->edgeUs) / p->cycleUs + 1) * p->cycleUs;
+		}
+		p->nextUs = p->edgeUs + p->cycleUs / ACQ_PHASE_GUARD_DIV;
+		return 1;
+	}
+	if (!p->locked)
+	{
+		if (++p->search > 2 * ACQ_PHASE_STEP_DIV)
+		{
+			// the values do not move, the update time cannot be found
+			p->search = 0;
+			p->plain = ACQ_PHASE_PLAIN;
+			p->nextUs = t + (uint64_t)cfg->periodMs * 1000;
+			return 1;
+		}
+		p->nextUs = t + step;
+		return 0;
+	}
+	if (++p->stale > ACQ_PHASE_LOST)
+	{
+		// the rate changed or the ADC was reinitialized
+		acqPhaseInit(cfg, board, p, t);
+		p->nextUs = t + step;
+		return 0;
+	}
+	p->edgeUs += step;
+	p->nextUs = p->edgeUs + p->cycleUs / ACQ_PHASE_GUARD_DIV;
+	return 0;
+}
+
+/*
+ * acqBusPhase:
+ *	Poll the cards of one bus in step with their ADC conversions (see
+ *	acqPhaseUpdate()), every card at its own phase
+ */
+static void* acqBusPhase(void *arg)
+{
+	AcqBusType *b = (AcqBusType*)arg;
+	const AcqCfgType *cfg = b->cfg;
+	AcqSampleType s[SMTC_STACK_MAX];
+	AcqDiagType d[SMTC_STACK_MAX];
+	uint64_t now, wake;
+	uint32_t pass;
+	int i, n, nd;
+
+	acqThreadStart(b);
+	now = commTimeUs();
+	commLock(b->bus);
+	for (i = 0; i < b->boards; i++)
+	{
+		acqPhaseInit(cfg, &b->board[i], &b->phase[i], now);
+	}
+	commUnlock(b->bus);
+	for (pass = 0; !gAcqStop && (cfg->rounds == 0 || pass < cfg->rounds);
+		pass++)
+	{
+		n = 0;
+		now = commTimeUs();
+		commLock(b->bus);
+		for (i = 0; i < b->boards; i++)
+		{
+			if (b->phase[i].nextUs > now)
+			{
+				continue;
+			}
+			s[n].bus = b->bus;
+			s[n].stack = b->board[i].stack;
+			s[n].ret = smtcReadRawAll(&b->board[i], s[n].raw);
+			s[n].tUs = commTimeUs();
+			b->reads++;
+			if (acqPhaseUpdate(cfg, &b->board[i], &b->phase[i], &s[n]))
+			{
+				n++;
+			}
+			else
+			{
+				b->stale++;
+			}
+		}
+		nd = acqDiagRead(b, d);
+		commUnlock(b->bus);
+		wake = UINT64_MAX;
+		for (i = 0; i < b->boards; i++)
+		{
+			if (b->phase[i].nextUs < wake)
+			{
+				wake = b->phase[i].nextUs;
+			}
+		}
+		pthread_mutex_lock(&gAcqSinkMutex);
+		for (i = 0; i < n; i++)
+		{
+			cfg->sink(&s[i], cfg->arg);
+		}
+		for (i = 0; i < nd; i++)
+		{
+			cfg->diagSink(&d[i], cfg->arg);
+		}
+		pthread_mutex_unlock(&gAcqSinkMutex);
+		if (cfg->rounds == 0 || pass + 1 < cfg->rounds)
+		{
+			acqSleepUntilUs(wake);
+			acqJitter(b, wake);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * acqReadsGet:
+ *	Card reads of the last acqRun() with the phase lock, and how many of
+ *	them returned no new conversion
+ */
+void acqReadsGet(uint32_t *reads, uint32_t *stale)
+{
+	*reads = gAcqReads;
+	*stale = gAcqStale;
+}
+
+/*
+ * acqJitterGet:
+ *	Wake up lateness of all the bus threads of the last acqRun(), in us.
+ *	Returns 0, or -1 when the real time setup failed (no permission) and
+ *	the threads ran with the normal scheduling.
+ */
+int acqJitterGet(HistType *jitter)
+{
+	*jitter = gAcqJitter;
+	return gAcqRtFail ? -1 : 0;
+}
+
+/*
+ * acqRun:
+ *	Discover the cards on the configured buses, then poll them until
+ *	cfg->rounds rounds are done or acqStop() is called. The sink is called
+ *	from the bus threads, one call at a time; cfg->card is called for every
+ *	card found before that, from the calling thread. Returns the number of
+ *	cards polled or a negative SMTC_ERR_xxx code.
+ */
+int acqRun(const AcqCfgType *cfg)
+{
+	static AcqBusType bus[COMM_BUS_MAX];
+	SmtcTopoType topo[SMTC_STACK_MAX];
+	pthread_attr_t attr;
+	long cpus;
+	int i, j, n;
+	int total = 0;
+
+	if (NULL == cfg || NULL == cfg->sink || cfg->periodMs <= 0
+		|| cfg->busCount <= 0 || cfg->busCount > COMM_BUS_MAX
+		|| cfg->minPeriodMs > cfg->periodMs
+		|| (cfg->phaseLock && cfg->minPeriodMs > 0))
+	{
+		return SMTC_ERR_ARG;
+	}
+	gAcqStop = 0;
+	gAcqReads = 0;
+	gAcqStale = 0;
+	gAcqRtFail = 0;
+	histInit(&gAcqJitter);
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	for (i = 0; i < cfg->busCount; i++)
+	{
+		memset(&bus[i], 0, sizeof(AcqBusType));
+		bus[i].bus = cfg->buses[i];
+		bus[i].cfg = cfg;
+		bus[i].cpu = cfg->rtPri > 0 && cpus > 0 ? (int) ( (cfg->rtCpu + i) % cpus) : -1;
+		histInit(&bus[i].jitter);
+		if (cfg->stack >= 0)
+		{
+			// a single card: the open does the presence check
+			n = 1;
+			topo[0].stack = cfg->stack;
+		}
+		else
+		{
+			n = smtcScanBus(bus[i].bus, topo, SMTC_STACK_MAX);
+		}
+		for (j = 0; j < n; j++)
+		{
+			if (SMTC_OK != smtcOpen(&bus[i].board[bus[i].boards], bus[i].bus,
+				topo[j].stack))
+			{
+				continue;
+			}
+			if (NULL != cfg->card && 0 != cfg->card(bus[i].bus, topo[j].stack,
+				cfg->arg))
+			{
+				smtcClose(&bus[i].board[bus[i].boards]);
+				continue;
+			}
+			bus[i].boards++;
+		}
+		total += bus[i].boards;
+	}
+	if (total == 0)
+	{
+		return SMTC_ERR_NO_BOARD;
+	}
+	// locked memory: every page of the threads stays resident, small stacks
+	pthread_attr_init(&attr);
+	if (cfg->rtPri > 0)
+	{
+		pthread_attr_setstacksize(&attr, ACQ_RT_STACK_SIZE);
+		if (0 != piMemLock())
+		{
+			gAcqRtFail = 1;
+		}
+	}
+	for (i = 0; i < cfg->busCount; i++)
+	{
+		if (bus[i].boards > 0)
+		{
+			bus[i].started = 0 == pthread_create(&bus[i].thread, &attr,
+				cfg->phaseLock ? &acqBusPhase :
+				(cfg->minPeriodMs > 0 ? &acqBusAdaptive : &acqBusThread), &bus[i]);
+		}
+	}
+	pthread_attr_destroy(&attr);
+	for (i = 0; i < cfg->busCount; i++)
+	{
+		if (bus[i].started)
+		{
+			pthread_join(bus[i].thread, NULL);
+		}
+		gAcqReads += bus[i].reads;
+		gAcqStale += bus[i].stale;
+		histMerge(&gAcqJitter, &bus[i].jitter);
+		for (j = 0; j < bus[i].boards; j++)
+		{
+			smtcClose(&bus[i].board[j]);
+		}
+	}
+	return total;
+}
+
+//************************ CLI ****************************
+
+typedef struct
+{
+	int stream; // text records without the "<bus>:<id>" prefix
+	int filter;
+	int jitter; // print the wake up jitter at exit
+	const char *flightPath; // flight recorder file, NULL - none
+	uint32_t flightFrames;
+	FlightType flight;
+	const char *logDir; // durable log directory, NULL - none
+	int logSyncMs;
+	int logSyncKb;
+	JournalType journal;
+	DeadbandCfgType db[SMTC_CH_NR];
+	DeadbandStateType st[COMM_BUS_MAX][SMTC_STACK_MAX][SMTC_CH_NR];
+	int smooth; // host filters on some channel
+	FilterCfgType fc[SMTC_CH_NR];
+	FilterLanesType lanes;
+	FilterStateType fst[COMM_BUS_MAX][SMTC_STACK_MAX];
+	int quantMs; // rolling quantile window, 0 - off
+	DigestWindowType *quant[COMM_BUS_MAX][SMTC_STACK_MAX]; // channels of a card
+	uint32_t quantQuery[COMM_BUS_MAX][SMTC_STACK_MAX];
+	int rorOn; // rate of rise alarms on some channel
+	RorCfgType ror[SMTC_CH_NR];
+	RorStateType *rorSt[COMM_BUS_MAX][SMTC_STACK_MAX]; // channels of a card
+	int alarmOn; // limit alarms on some channel
+	int alarmLed; // mirror the primary limits to the LEDs of the cards
+	AlarmCfgType alarm[SMTC_CH_NR];
+	AlarmStateType *alarmSt[COMM_BUS_MAX][SMTC_STACK_MAX]; // channels of a card
+	uint32_t alarmAck[COMM_BUS_MAX][SMTC_STACK_MAX];
+	const char *eventsSpec; // alarm event records, NULL - stdout only
+	AlarmOutType events;
+} AcqReportType;
+
+static AcqReportType gReport;
+static volatile sig_atomic_t gAcqQuantQuery = 0;
+static volatile sig_atomic_t gAcqAlarmAck = 0;
+
+static const char *gPollKeys[SMTC_CH_NR] = {"t1", "t2", "t3", "t4", "t5", "t6",
+	"t7", "t8"};
+
+/*
+ * acqReportMask:
+ *	Channels of a sample to report after the deadband and heartbeat
+ *	filter. JSON records carry only the channels that passed; the
+ *	positional formats carry all of them once any channel passed.
+ */
+static int acqReportMask(AcqReportType *r, const AcqSampleType *s)
+{
+	DeadbandStateType *st = r->st[s->bus][s->stack];
+	int mask = 0;
+	int ch;
+
+	if (!r->filter || s->ret != SMTC_OK)
+	{
+		return (1 << SMTC_CH_NR) - 1;
+	}
+	for (ch = 0; ch < SMTC_CH_NR; ch++)
+	{
+		if (deadbandPass(&r->db[ch], &st[ch], s->raw[ch], s->tUs))
+		{
+			mask |= 1 << ch;
+		}
+	}
+	if (mask != 0 && outFormat() != OUT_JSON)
+	{
+		mask = (1 << SMTC_CH_NR) - 1;
+	}
+	for (ch = 0; ch < SMTC_CH_NR; ch++)
+	{
+		deadbandUpdate(&st[ch], s->raw[ch], s->tUs, mask & (1 << ch));
+	}
+	return mask;
+}
+
+static void acqQuantSignal(int sig)
+{
+	(void)sig;
+	gAcqQuantQuery++;
+}
+
+/*
+ * acqReportQuant:
+ *	Add a read to the rolling quantiles of its card. The quantiles of the
+ *	card are printed every time a slice of the window is completed and on
+ *	SIGUSR1, with the next read of the card, by the thread of its bus.
+ */
+static void acqReportQuant(AcqReportType *r, const AcqSampleType *s)
+{
+	DigestWindowType *w = r->quant[s->bus][s->stack];
+	DigestType d;
+	struct timespec ts;
+	int done = 0;
+	int ch;
+
+	for (ch = 0; ch < SMTC_CH_NR; ch++)
+	{
+		done |= digestWindowAdd(&w[ch], s->raw[ch], s->tUs);
+	}
+	if (!done && r->quantQuery[s->bus][s->stack] == (uint32_t)gAcqQuantQuery)
+	{
+		return;
+	}
+	r->quantQuery[s->bus][s->stack] = (uint32_t)gAcqQuantQuery;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	for (ch = 0; ch < SMTC_CH_NR; ch++)
+	{
+		digestWindowGet(&w[ch], &d);
+		if (outFormat() == OUT_TEXT)
+		{
+			if (!r->stream)
+			{
+				printf("%d:%d ", s->bus, s->stack);
+			}
+			printf("quant %d ", ch + 1);
+		}
+		outBegin();
+		outTag("bus", s->bus);
+		outTag("id", s->stack);
+		outTag("ch", ch + 1);
+		if (outFormat() != OUT_TEXT)
+		{
+			outLong("ts", (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+		}
+		outLong("n", (int64_t)d.count);
+		outFixed("p50", (int)lrintf(digestQuantile(&d, 0.5)), 1);
+		outFixed("p95", (int)lrintf(digestQuantile(&d, 0.95)), 1);
+		outFixed("p99", (int)lrintf(digestQuantile(&d, 0.99)), 1);
+		outEnd();
+	}
+	fflush(stdout);
+}
+
+/*
+ * acqReportEvent:
+ *	Alarm event as a JSON line to the --events output
+ */
+static void acqReportEvent(AcqReportType *r, const AcqSampleType *s, int ch,
+	const char *alarm, const char *ev, const char *key, int val)
+{
+	struct timespec ts;
+	char rec[192];
+	int len;
+
+	if (NULL == r->eventsSpec)
+	{
+		return;
+	}
+	clock_gettime(CLOCK_REALTIME, &ts);
+	len = snprintf(rec, sizeof(rec),
+		"{\"ts\":%lld,\"bus\":%d,\"id\":%d,\"ch\":%d,\"alarm\":\"%s\",\"ev\":\"%s\",\"%s\":%s%d.%d}\n",
+		(long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000, s->bus, s->stack,
+		ch + 1, alarm, ev, key, val < 0 ? "-" : "", abs(val) / 10, abs(val) % 10);
+	if (len > 0 && len < (int)sizeof(rec))
+	{
+		alarmOutSend(&r->events, rec, len);
+	}
+}
+
+/*
+ * acqReportRor:
+ *	Rate of rise of the channels of a read, a record when an alarm is
+ *	raised or cleared
+ */
+static void acqReportRor(AcqReportType *r, const AcqSampleType *s)
+{
+	RorStateType *st = r->rorSt[s->bus][s->stack];
+	struct timespec ts;
+	float rate;
+	int ev;
+	int ch;
+
+	for (ch = 0; ch < SMTC_CH_NR; ch++)
+	{
+		if (!rorActive(&r->ror[ch]))
+		{
+			continue;
+		}
+		ev = rorUpdate(&r->ror[ch], &st[ch], s->raw[ch], s->tUs, &rate);
+		if (ev == ROR_NONE)
+		{
+			continue;
+		}
+		if (outFormat() == OUT_TEXT)
+		{
+			if (!r->stream)
+			{
+				printf("%d:%d ", s->bus, s->stack);
+			}
+			printf("ror %d %s ", ch + 1, ev == ROR_ON ? "on" : "off");
+		}
+		outBegin();
+		outTag("bus", s->bus);
+		outTag("id", s->stack);
+		outTag("ch", ch + 1);
+		if (outFormat() != OUT_TEXT)
+		{
+			clock_gettime(CLOCK_REALTIME, &ts);
+			outLong("ts", (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+			outInt("ror", ev == ROR_ON);
+		}
+		outFixed("rate", (int)lrintf(rate * 10), 1);
+		outEnd();
+		fflush(stdout);
+		acqReportEvent(r, s, ch, "ror", ev == ROR_ON ? "on" : "off", "rate",
+			(int)lrintf(rate * 10));
+	}
+}
+
+static void acqAlarmSignal(int sig)
+{
+	(void)sig;
+	gAcqAlarmAck++;
+}
+
+/*
+ * acqAlarmLed:
+ *	Mirror the primary limit of every channel with alarms to the LED of the
+ *	card: on above a high limit, below a low one. The LED threshold is in
+ *	whole degrees; a channel whose limit is out of the LED range is left
+ *	alone with a warning.
+ */
+static void acqAlarmLed(AcqReportType *r, int bus, int stack)
+{
+	SmtcBoardType board;
+	int ch, level, deg, ret = SMTC_OK;
+
+	if (SMTC_OK != smtcOpen(&board, bus, stack))
+	{
+		fprintf(stderr, "%d:%d Fail to mirror the alarms to the LEDs\n", bus, stack);
+		return;
+	}
+	for (ch = 0; ch < SMTC_CH_NR && ret == SMTC_OK; ch++)
+	{
+		level = alarmPrimary(&r->alarm[ch]);
+		if (level < 0)
+		{
+			continue;
+		}
+		deg = (int)lrintf( (float)r->alarm[ch].limit[level] / SMTC_TEMP_SCALE);
+		if (deg < LED_THRESHOLD_MIN || deg > LED_THRESHOLD_MAX)
+		{
+			fprintf(stderr, "%d:%d:%d Limit %d out of the LED range [%d, %d], LED not set\n",
+				bus, stack, ch + 1, deg, LED_THRESHOLD_MIN, LED_THRESHOLD_MAX);
+			continue;
+		}
+		ret = smtcLedThresholdSet(&board, ch + 1, deg);
+		if (ret == SMTC_OK)
+		{
+			ret = smtcLedModeSet(&board, ch + 1,
+				level == ALARM_L ? SMTC_LED_BELOW : SMTC_LED_ABOVE);
+		}
+	}
+	if (ret != SMTC_OK)
+	{
+		fprintf(stderr, "%d:%d Fail to mirror the alarms to the LEDs: %s\n", bus,
+			stack, smtcStrError(ret));
+	}
+	smtcClose(&board);
+}
+
+/*
+ * acqReportAlarm:
+ *	Limit alarms of the channels of a read, a record for every alarm
+ *	raised, cleared or acknowledged. SIGUSR2 acknowledges every alarm, each
+ *	card with its next read.
+ */
+static void acqReportAlarm(AcqReportType *r, const AcqSampleType *s)
+{
+	AlarmStateType *st = r->alarmSt[s->bus][s->stack];
+	AlarmEventType ev[2 * ALARM_LEVELS];
+	struct timespec ts;
+	int ack, n, i;
+	int ch;
+
+	ack = r->alarmAck[s->bus][s->stack] != (uint32_t)gAcqAlarmAck;
+	r->alarmAck[s->bus][s->stack] = (uint32_t)gAcqAlarmAck;
+	for (ch = 0; ch < SMTC_CH_NR; ch++)
+	{
+		n = alarmUpdate(&r->alarm[ch], &st[ch], s->raw[ch], s->tUs, ev);
+		if (ack)
+		{
+			n += alarmAck(&r->alarm[ch], &st[ch], &ev[n]);
+		}
+		for (i = 0; i < n; i++)
+		{
+			if (outFormat() == OUT_TEXT)
+			{
+				if (!r->stream)
+				{
+					printf("%d:%d ", s->bus, s->stack);
+				}
+				printf("alarm %d %s %s ", ch + 1, alarmLevelName(ev[i].level),
+					alarmEventName(ev[i].type));
+			}
+			outBegin();
+			outTag("bus", s->bus);
+			outTag("id", s->stack);
+			outTag("ch", ch + 1);
+			if (outFormat() != OUT_TEXT)
+			{
+				clock_gettime(CLOCK_REALTIME, &ts);
+				outLong("ts", (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+				outInt(alarmLevelName(ev[i].level), ev[i].type);
+			}
+			outFixed("t", s->raw[ch], 1);
+			outEnd();
+			acqReportEvent(r, s, ch, alarmLevelName(ev[i].level),
+				alarmEventName(ev[i].type), "t", s->raw[ch]);
+		}
+		if (n > 0)
+		{
+			fflush(stdout);
+		}
+	}
+}
+
+static void acqReportSink(const AcqSampleType *s, void *arg)
+{
+	AcqReportType *r = (AcqReportType*)arg;
+	AcqSampleType filtered;
+	struct timespec ts;
+	int mask;
+	int ch;
+
+	if (r->flightPath)
+	{
+		flightWrite(&r->flight, s); // every read, before the deadband
+	}
+	if (r->logDir)
+	{
+		journalAppend(&r->journal, s);
+	}
+	if (r->smooth && s->ret == SMTC_OK)
+	{
+		filtered = *s; // the files keep the raw reads
+		filterApply(&r->lanes, &r->fst[s->bus][s->stack], filtered.raw);
+		s = &filtered;
+	}
+	if (r->quantMs > 0 && s->ret == SMTC_OK)
+	{
+		acqReportQuant(r, s);
+	}
+	if (r->rorOn && s->ret == SMTC_OK)
+	{
+		acqReportRor(r, s);
+	}
+	if (r->alarmOn && s->ret == SMTC_OK)
+	{
+		acqReportAlarm(r, s);
+	}
+	mask = acqReportMask(r, s);
+	if (mask == 0)
+	{
+		return;
+	}
+	if (outFormat() == OUT_TEXT && !r->stream)
+	{
+		printf("%d:%d", s->bus, s->stack);
+		if (s->ret != SMTC_OK)
+		{
+			printf(" %s\n", smtcStrError(s->ret));
+			fflush(stdout);
+			return;
+		}
+		printf(" ");
+	}
+	outBegin();
+	outTag("bus", s->bus);
+	outTag("id", s->stack);
+	if (outFormat() != OUT_TEXT && r->stream)
+	{
+		clock_gettime(CLOCK_REALTIME, &ts);
+		outLong("ts", (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+	}
+	if (s->ret != SMTC_OK)
+	{
+		outInt("error", s->ret);
+	}
+	else
+	{
+		for (ch = 0; ch < SMTC_CH_NR; ch++)
+		{
+			if (mask & (1 << ch))
+			{
+				outFixed(gPollKeys[ch], s->raw[ch], 1);
+			}
+		}
+	}
+	outEnd();
+	fflush(stdout);
+}
+
+/*
+ * acqReportDiag:
+ *	Diagnostics record, marked "diag" in the text format. The other formats
+ *	always carry the time stamp so the health values can be trended.
+ */
+static void acqReportDiag(const AcqDiagType *d, void *arg)
+{
+	AcqReportType *r = (AcqReportType*)arg;
+	struct timespec ts;
+
+	if (outFormat() == OUT_TEXT)
+	{
+		if (!r->stream)
+		{
+			printf("%d:%d ", d->bus, d->stack);
+		}
+		printf("diag");
+		if (d->ret != SMTC_OK)
+		{
+			printf(" %s\n", smtcStrError(d->ret));
+			fflush(stdout);
+			return;
+		}
+		printf(" ");
+	}
+	outBegin();
+	outTag("bus", d->bus);
+	outTag("id", d->stack);
+	if (outFormat() != OUT_TEXT)
+	{
+		clock_gettime(CLOCK_REALTIME, &ts);
+		outLong("ts", (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+	}
+	if (d->ret != SMTC_OK)
+	{
+		outInt("error", d->ret);
+	}
+	else
+	{
+		doOutDiag(&d->diag);
+	}
+	outEnd();
+	fflush(stdout);
+}
+
+/*
+ * acqReportStats:
+ *	Reported and suppressed values per card, on stderr so the data stream
+ *	stays clean
+ */
+static void acqReportStats(AcqReportType *r)
+{
+	uint32_t rep, sup;
+	int bus, stack, ch;
+
+	if (!r->filter)
+	{
+		return;
+	}
+	for (bus = 0; bus < COMM_BUS_MAX; bus++)
+	{
+		for (stack = 0; stack < SMTC_STACK_MAX; stack++)
+		{
+			rep = sup = 0;
+			for (ch = 0; ch < SMTC_CH_NR; ch++)
+			{
+				rep += r->st[bus][stack][ch].reported;
+				sup += r->st[bus][stack][ch].suppressed;
+			}
+			if (rep + sup > 0)
+			{
+				fprintf(stderr, "%d:%d %u values reported, %u suppressed\n", bus,
+					stack, rep, sup);
+			}
+		}
+	}
+}
+
+/*
+ * acqReadsReport:
+ *	With --adc-sync, how many reads found no new conversion
+ */
+static void acqReadsReport(const AcqCfgType *cfg)
+{
+	uint32_t reads, stale;
+
+	if (!cfg->phaseLock)
+	{
+		return;
+	}
+	acqReadsGet(&reads, &stale);
+	fprintf(stderr, "%u reads, %u without a new conversion\n", reads, stale);
+}
+
+/*
+ * acqJitterReport:
+ *	Wake up lateness percentiles of the bus threads, on stderr
+ */
+static void acqJitterReport(const AcqReportType *r)
+{
+	static HistType jitter;
+
+	if (!r->jitter)
+	{
+		return;
+	}
+	if (0 != acqJitterGet(&jitter))
+	{
+		fprintf(stderr, "Real time setup failed, the threads ran with the normal scheduling\n");
+	}
+	fprintf(stderr,
+		"jitter us: n %llu p50 %llu p90 %llu p99 %llu p99.9 %llu max %llu\n",
+		(unsigned long long)jitter.count,
+		(unsigned long long)histPercentile(&jitter, 50),
+		(unsigned long long)histPercentile(&jitter, 90),
+		(unsigned long long)histPercentile(&jitter, 99),
+		(unsigned long long)histPercentile(&jitter, 99.9),
+		(unsigned long long)jitter.max);
+}
+
+/*
+ * acqReportOpen:
+ *	Files of the report: flight recorder, durable log and event output, the
+ *	quantiles query and alarm acknowledge signals
+ */
+static int acqReportOpen(AcqReportType *r)
+{
+	if (r->flightPath && 0 != flightOpen(&r->flight, r->flightPath,
+		r->flightFrames))
+	{
+		printf("Fail to open the flight recorder %s (a new file or a ring)!\n",
+			r->flightPath);
+		return ERROR;
+	}
+	if (r->logDir && 0 != journalOpen(&r->journal, r->logDir, r->logSyncMs,
+		(uint32_t)r->logSyncKb * 1024))
+	{
+		printf("Fail to open the log %s!\n", r->logDir);
+		if (r->flightPath)
+		{
+			flightClose(&r->flight);
+		}
+		return ERROR;
+	}
+	if (r->eventsSpec && 0 != alarmOutOpen(&r->events, r->eventsSpec))
+	{
+		printf("Fail to open the event output %s!\n", r->eventsSpec);
+		if (r->logDir)
+		{
+			journalClose(&r->journal, NULL);
+		}
+		if (r->flightPath)
+		{
+			flightClose(&r->flight);
+		}
+		return ERROR;
+	}
+	if (r->quantMs > 0)
+	{
+		signal(SIGUSR1, &acqQuantSignal);
+	}
+	if (r->alarmOn)
+	{
+		signal(SIGUSR2, &acqAlarmSignal);
+	}
+	return OK;
+}
+
+/*
+ * acqReportCard:
+ *	State of the report for a card found by acqRun(), allocated before the
+ *	bus threads start so the sink never allocates; the alarm limits are
+ *	mirrored to the LEDs here too, off the bus threads
+ */
+static int acqReportCard(int bus, int stack, void *arg)
+{
+	AcqReportType *r = (AcqReportType*)arg;
+	DigestWindowType *w;
+	RorStateType *st;
+	AlarmStateType *ast;
+	int ch;
+
+	if (r->quantMs > 0)
+	{
+		w = malloc(SMTC_CH_NR * sizeof(DigestWindowType));
+		if (NULL == w)
+		{
+			fprintf(stderr, "%d:%d Fail to allocate the quantiles\n", bus, stack);
+			return -1;
+		}
+		for (ch = 0; ch < SMTC_CH_NR; ch++)
+		{
+			digestWindowInit(&w[ch], (uint64_t)r->quantMs * 1000);
+		}
+		r->quant[bus][stack] = w;
+		r->quantQuery[bus][stack] = (uint32_t)gAcqQuantQuery;
+	}
+	if (r->rorOn)
+	{
+		st = malloc(SMTC_CH_NR * sizeof(RorStateType));
+		if (NULL == st)
+		{
+			fprintf(stderr, "%d:%d Fail to allocate the rate of rise\n", bus, stack);
+			return -1;
+		}
+		for (ch = 0; ch < SMTC_CH_NR; ch++)
+		{
+			rorStateInit(&st[ch]);
+		}
+		r->rorSt[bus][stack] = st;
+	}
+	if (r->alarmOn)
+	{
+		ast = malloc(SMTC_CH_NR * sizeof(AlarmStateType));
+		if (NULL == ast)
+		{
+			fprintf(stderr, "%d:%d Fail to allocate the alarms\n", bus, stack);
+			return -1;
+		}
+		for (ch = 0; ch < SMTC_CH_NR; ch++)
+		{
+			alarmStateInit(&ast[ch]);
+		}
+		r->alarmSt[bus][stack] = ast;
+		r->alarmAck[bus][stack] = (uint32_t)gAcqAlarmAck;
+		if (r->alarmLed)
+		{
+			acqAlarmLed(r, bus, stack);
+		}
+	}
+	return 0;
+}
+
+/*
+ * acqReportClose:
+ *	Close the files, the log metrics go to stderr: the loss window is the
+ *	age of the oldest frame of a batch when the batch became durable
+ */
+static void acqReportClose(AcqReportType *r)
+{
+	JournalStatsType st;
+	int bus, stack;
+
+	for (bus = 0; bus < COMM_BUS_MAX; bus++)
+	{
+		for (stack = 0; stack < SMTC_STACK_MAX; stack++)
+		{
+			free(r->quant[bus][stack]);
+			r->quant[bus][stack] = NULL;
+			free(r->rorSt[bus][stack]);
+			r->rorSt[bus][stack] = NULL;
+			free(r->alarmSt[bus][stack]);
+			r->alarmSt[bus][stack] = NULL;
+		}
+	}
+
+	if (r->flightPath)
+	{
+		flightClose(&r->flight);
+	}
+	if (r->logDir)
+	{
+		journalClose(&r->journal, &st);
+		fprintf(stderr,
+			"log: %llu frames, %llu bytes, %u segments, %u commits (avg %llu us, max %u us), loss window max %u ms, %u dropped, %u errors\n",
+			(unsigned long long)st.frames, (unsigned long long)st.bytes,
+			st.segments, st.commits,
+			(unsigned long long) (st.commits ? st.commitUs / st.commits : 0),
+			st.maxCommitUs, st.maxLossMs, st.dropped, st.errors);
+	}
+	if (r->eventsSpec)
+	{
+		fprintf(stderr, "events: %u sent, %u dropped\n", r->events.sent,
+			r->events.dropped);
+		alarmOutClose(&r->events);
+	}
+}
+
+/*
+ * acqOptions:
+ *	Options common to -poll and stream, the other arguments are positive
+ *	numbers stored in num[]. Returns how many numbers were found or
+ *	ARG_ERR.
+ */
+static int acqOptions(int argc, char *argv[], int first, int *num, int numMax,
+	AcqCfgType *cfg, AcqReportType *r)
+{
+	float rate;
+	char *p;
+	int n = 0;
+	int mb;
+	int i, ch;
+
+	memset(cfg, 0, sizeof(AcqCfgType));
+	memset(r, 0, sizeof(AcqReportType));
+	for (ch = 0; ch < SMTC_CH_NR; ch++)
+	{
+		filterInit(&r->fc[ch]);
+		rorInit(&r->ror[ch]);
+		alarmInit(&r->alarm[ch]);
+	}
+	for (i = first; i < argc; i++)
+	{
+		if (0 == strcmp(argv[i], "--jsonl"))
+		{
+			outFormatSet("json");
+		}
+		else if (0 == strcmp(argv[i], "--adaptive") && i + 1 < argc)
+		{
+			if (2 != sscanf(argv[++i], "%d:%f", &cfg->minPeriodMs, &rate)
+				|| cfg->minPeriodMs <= 0 || rate <= 0)
+			{
+				printf("Invalid adaptive rate %s!\n", argv[i]);
+				return ARG_ERR;
+			}
+			cfg->rateThr = (int) (rate * SMTC_TEMP_SCALE + 0.5f);
+		}
+		else if (0 == strcmp(argv[i], "--diag") && i + 1 < argc)
+		{
+			if (atoi(argv[++i]) <= 0)
+			{
+				printf("Invalid diagnostics period!\n");
+				return ARG_ERR;
+			}
+			cfg->diagPeriodMs = atoi(argv[i]) * 1000;
+		}
+		else if (0 == strcmp(argv[i], "--rt") && i + 1 < argc)
+		{
+			cfg->rtPri = ACQ_RT_PRI_DEFAULT;
+			if (sscanf(argv[++i], "%d:%d", &cfg->rtCpu, &cfg->rtPri) < 1
+				|| cfg->rtCpu < 0 || cfg->rtPri <= 0)
+			{
+				printf("Invalid real time setting %s!\n", argv[i]);
+				return ARG_ERR;
+			}
+			r->jitter = 1;
+		}
+		else if (0 == strcmp(argv[i], "--flight") && i + 1 < argc)
+		{
+			r->flightPath = argv[++i];
+			mb = FLIGHT_DEFAULT_MB;
+			p = strrchr(argv[i], ':');
+			if (p != NULL)
+			{
+				*p = 0;
+				mb = atoi(p + 1);
+			}
+			if (*r->flightPath == 0 || mb <= 0)
+			{
+				printf("Invalid flight recorder %s!\n", argv[i]);
+				return ARG_ERR;
+			}
+			r->flightFrames = (uint32_t) ( (uint64_t)mb * 1024 * 1024
+				/ sizeof(FrameType));
+		}
+		else if (0 == strcmp(argv[i], "--log") && i + 1 < argc)
+		{
+			r->logDir = argv[++i];
+			r->logSyncMs = JOURNAL_DEFAULT_SYNC_MS;
+			r->logSyncKb = JOURNAL_DEFAULT_SYNC_KB;
+			p = strchr(argv[i], ':');
+			if (p != NULL)
+			{
+				*p = 0;
+				if (sscanf(p + 1, "%d:%d", &r->logSyncMs, &r->logSyncKb) < 1)
+				{
+					r->logSyncMs = 0;
+				}
+			}
+			if (*r->logDir == 0 || r->logSyncMs <= 0 || r->logSyncKb <= 0)
+			{
+				printf("Invalid log %s!\n", argv[i]);
+				return ARG_ERR;
+			}
+		}
+		else if (0 == strcmp(argv[i], "--jitter"))
+		{
+			r->jitter = 1;
+		}
+		else if (0 == strcmp(argv[i], "--adc-sync"))
+		{
+			cfg->phaseLock = 1;
+		}
+		else if (0 == strcmp(argv[i], "--budget") && i + 1 < argc)
+		{
+			cfg->budget = atoi(argv[++i]);
+			if (cfg->budget <= 0)
+			{
+				printf("Invalid bus budget!\n");
+				return ARG_ERR;
+			}
+		}
+		else if (0 == strcmp(argv[i], "--deadband") && i + 1 < argc)
+		{
+			if (0 != deadbandParse(argv[++i], r->db, SMTC_CH_NR,
+				SMTC_TEMP_SCALE))
+			{
+				printf("Invalid deadband %s!\n", argv[i]);
+				return ARG_ERR;
+			}
+		}
+		else if (0 == strcmp(argv[i], "--quantiles") && i + 1 < argc)
+		{
+			if (atoi(argv[++i]) <= 0)
+			{
+				printf("Invalid quantile window!\n");
+				return ARG_ERR;
+			}
+			r->quantMs = atoi(argv[i]) * 1000;
+		}
+		else if (0 == strcmp(argv[i], "--ror") && i + 1 < argc)
+		{
+			if (0 != rorParse(argv[++i], r->ror, SMTC_CH_NR))
+			{
+				printf("Invalid rate of rise alarm %s!\n", argv[i]);
+				return ARG_ERR;
+			}
+		}
+		else if (0 == strcmp(argv[i], "--alarm") && i + 1 < argc)
+		{
+			if (0 != alarmParse(argv[++i], r->alarm, SMTC_CH_NR, SMTC_TEMP_SCALE))
+			{
+				printf("Invalid alarm %s!\n", argv[i]);
+				return ARG_ERR;
+			}
+		}
+		else if (0 == strcmp(argv[i], "--alarm-led"))
+		{
+			r->alarmLed = 1;
+		}
+		else if (0 == strcmp(argv[i], "--events") && i + 1 < argc)
+		{
+			r->eventsSpec = argv[++i];
+		}
+		else if (0 == strcmp(argv[i], "--filter") && i + 1 < argc)
+		{
+			if (0 != filterParse(argv[++i], r->fc, SMTC_CH_NR, SMTC_TEMP_SCALE))
+			{
+				printf("Invalid filter %s!\n", argv[i]);
+				return ARG_ERR;
+			}
+		}
+		else if (0 == strcmp(argv[i], "--heartbeat") && i + 1 < argc)
+		{
+			if (atoi(argv[++i]) <= 0)
+			{
+				printf("Invalid heartbeat!\n");
+				return ARG_ERR;
+			}
+			for (ch = 0; ch < SMTC_CH_NR; ch++)
+			{
+				r->db[ch].heartbeatMs = (uint32_t)atoi(argv[i]) * 1000;
+			}
+		}
+		else if (atoi(argv[i]) > 0 && n < numMax)
+		{
+			num[n++] = atoi(argv[i]);
+		}
+		else
+		{
+			printf("Invalid argument %s!\n", argv[i]);
+			return ARG_ERR;
+		}
+	}
+	if (cfg->phaseLock && cfg->minPeriodMs > 0)
+	{
+		printf("--adaptive and --adc-sync cannot be combined!\n");
+		return ARG_ERR;
+	}
+	for (ch = 0; ch < SMTC_CH_NR; ch++)
+	{
+		r->filter |= deadbandActive(&r->db[ch]);
+		r->smooth |= filterActive(&r->fc[ch]);
+		r->rorOn |= rorActive(&r->ror[ch]);
+		r->alarmOn |= alarmActive(&r->alarm[ch]);
+	}
+	filterLanes(&r->lanes, r->fc);
+	return n;
+}
+
+static void pollSignal(int sig)
+{
+	(void)sig;
+	acqStop();
+}
+
+int doPoll(int argc, char *argv[]);
+const CliCmdType CMD_POLL =
+	{
+		"-poll",
+		1,
+		&doPoll,
+		"\t-poll:      Poll the temperatures of all the cards, one thread per i2c bus\n",
+		"\tUsage:      smtc -poll <period ms> [<rounds>] [--deadband <deg>[%]] [--heartbeat <s>] [--diag <s>] [--rt <cpu>[:<prio>]] [--jitter] [--flight <file>[:<MB>]] [--log <dir>[:<sync ms>[:<KB>]]] [--filter <spec>]... [--quantiles <s>] [--ror <spec>]... [--alarm <spec>]... [--alarm-led] [--events <file|unix:path|udp:host:port>]\n",
+		"\tUsage:      smtc -poll <max period ms> --adaptive <min period ms>:<deg/s> [--budget <reads/s>] | --adc-sync\n",
+		"\tExample:    smtc --bus 1,3 -poll 100; Read every card on bus 1 and 3 every 100ms\n"};
+
+int doPoll(int argc, char *argv[])
+{
+	AcqCfgType cfg;
+	int num[2];
+	int n, ret;
+
+	n = acqOptions(argc, argv, 2, num, 2, &cfg, &gReport);
+	if (n < 0)
+	{
+		return n;
+	}
+	if (n < 1)
+	{
+		return ARG_CNT_ERR;
+	}
+	cfg.periodMs = num[0];
+	cfg.rounds = n > 1 ? (uint32_t)num[1] : 0;
+	cfg.stack = -1;
+	cfg.busCount = doBusList(cfg.buses, COMM_BUS_MAX);
+	if (cfg.busCount <= 0)
+	{
+		printf("No i2c bus found\n");
+		return ERROR;
+	}
+	cfg.sink = &acqReportSink;
+	cfg.diagSink = &acqReportDiag;
+	cfg.card = &acqReportCard;
+	cfg.arg = &gReport;
+	if (OK != acqReportOpen(&gReport))
+	{
+		return ERROR;
+	}
+	signal(SIGINT, &pollSignal);
+	signal(SIGTERM, &pollSignal);
+	ret = acqRun(&cfg);
+	acqReportClose(&gReport);
+	if (ret == SMTC_ERR_ARG)
+	{
+		printf("The adaptive minimum period must be below the period!\n");
+		return ARG_ERR;
+	}
+	if (ret < 0)
+	{
+		printf("No card found on the selected buses\n");
+		return ERROR;
+	}
+	acqReportStats(&gReport);
+	acqReadsReport(&cfg);
+	acqJitterReport(&gReport);
+	return OK;
+}
+
+int doStream(int argc, char *argv[]);
+const CliCmdType CMD_STREAM =
+	{
+		"stream",
+		2,
+		&doStream,
+		"\tstream:     Read all the temperatures of one card periodically until stopped, one line per read\n",
+		"\tUsage:      smtc <id> stream [--jsonl] [<period ms>] [--deadband <deg>[%]] [--heartbeat <s>] [--adc-sync] [--diag <s>] [--flight <file>[:<MB>]] [--log <dir>[:<sync ms>[:<KB>]]] [--filter <spec>]... [--quantiles <s>] [--ror <spec>]... [--alarm <spec>]... [--alarm-led] [--events <file|unix:path|udp:host:port>]\n",
+		"\tUsage:      smtc <id> stream --deadband <ch>:<deg>[%],<ch>:<deg>[%]... per channel deadband\n",
+		"\tExample:    smtc 0 stream --jsonl 1000 --deadband 0.5 --heartbeat 60; Print the temperatures that moved by more than 0.5 deg, all of them at least every minute\n"};
+
+/*
+ * doStream:
+ *	Long running reader for the Node-RED exec node in spawn mode and other
+ *	pipes: the process and the card handle stay up and every line is
+ *	flushed as soon as it is read. --jsonl is the same as --format json.
+ */
+int doStream(int argc, char *argv[])
+{
+	SmtcBoardType *board;
+	AcqCfgType cfg;
+	int num[1];
+	int n;
+
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
+	{
+		return ERROR;
+	}
+	n = acqOptions(argc, argv, 3, num, 1, &cfg, &gReport);
+	if (n < 0)
+	{
+		return n;
+	}
+	gReport.stream = 1;
+	cfg.periodMs = n > 0 ? num[0] : STREAM_DEFAULT_PERIOD_MS;
+	cfg.buses[0] = board->bus;
+	cfg.busCount = 1;
+	cfg.stack = board->stack;
+	cfg.sink = &acqReportSink;
+	cfg.diagSink = &acqReportDiag;
+	cfg.card = &acqReportCard;
+	cfg.arg = &gReport;
+	if (OK != acqReportOpen(&gReport))
+	{
+		return ERROR;
+	}
+	signal(SIGINT, &pollSignal);
+	signal(SIGTERM, &pollSignal);
+	signal(SIGPIPE, &pollSignal);
+	n = acqRun(&cfg);
+	acqReportClose(&gReport);
+	if (n == SMTC_ERR_ARG)
+	{
+		printf("The adaptive minimum period must be below the period!\n");
+		return ARG_ERR;
+	}
+	if (n < 0)
+	{
+		return ERROR;
+	}
+	acqReportStats(&gReport);
+	acqReadsReport(&cfg);
+	acqJitterReport(&gReport);
+	return OK;
+}
@@ -0,0 +1,57 @@
+#ifndef ACQ_H_
+#define ACQ_H_
+
+#include <stdint.h>
+#include "smtc.h"
+#include "comm.h"
+#include "hist.h"
+
+typedef struct
+{
+	int bus;
+	int stack;
+	uint64_t tUs;
+	int ret; // SMTC_OK or the read error, raw[] is valid only for SMTC_OK
+	int16_t raw[SMTC_CH_NR];
+} AcqSampleType;
+
+typedef void (*AcqSinkType)(const AcqSampleType *sample, void *arg);
+typedef int (*AcqCardType)(int bus, int stack, void *arg);
+
+typedef struct
+{
+	int bus;
+	int stack;
+	uint64_t tUs;
+	int ret; // SMTC_OK or the read error
+	SmtcDiagRawType diag;
+} AcqDiagType;
+
+typedef void (*AcqDiagSinkType)(const AcqDiagType *diag, void *arg);
+
+typedef struct
+{
+	int buses[COMM_BUS_MAX];
+	int busCount;
+	int stack; // -1 - every card found on the buses
+	int periodMs; // the slowest period with the adaptive rate
+	int minPeriodMs; // > 0 enables the adaptive rate
+	int rateThr; // raw units per second that switch a card to minPeriodMs
+	int budget; // block reads per second per bus, 0 - no limit
+	int phaseLock; // read just after the ADC conversions, not with minPeriodMs
+	uint32_t rounds; // 0 - until acqStop()
+	int rtPri; // > 0 - SCHED_FIFO priority of the bus threads, locked memory
+	int rtCpu; // with rtPri, the bus threads are pinned from this cpu on
+	int diagPeriodMs; // health registers of every card, 0 - never
+	AcqSinkType sink;
+	AcqDiagSinkType diagSink; // called like sink, with the same arg
+	AcqCardType card; // every card found, before the threads start: 0 or -1 to skip it, NULL - none
+	void *arg;
+} AcqCfgType;
+
+int acqRun(const AcqCfgType *cfg);
+void acqStop(void);
+void acqReadsGet(uint32_t *reads, uint32_t *stale);
+int acqJitterGet(HistType *jitter);
+
+#endif //ACQ_H_
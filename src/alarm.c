@@ -0,0 +1,378 @@
+/*
+ * alarm.c:
+ *	Host alarms on the temperatures: high-high, high and low limits per
+ *	channel with hysteresis, on and off delays and acknowledgement. An
+ *	alarm is raised when its limit is passed for the on delay and cleared
+ *	when the value is back inside the limit by the hysteresis for the off
+ *	delay; a raised alarm waits for an acknowledgement even after it
+ *	cleared. The alarm events can be sent as one line records to a file or
+ *	a datagram socket, for the supervisory systems.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "smtc.h"
+#include "alarm.h"
+
+static const char *gAlarmLevelNames[ALARM_LEVELS] = {"hh", "h", "l"};
+static const char *gAlarmEventNames[] = {"off", "on", "ack"};
+
+void alarmInit(AlarmCfgType *cfg)
+{
+	memset(cfg, 0, sizeof(AlarmCfgType));
+}
+
+int alarmActive(const AlarmCfgType *cfg)
+{
+	int level;
+
+	for (level = 0; level < ALARM_LEVELS; level++)
+	{
+		if (cfg->set[level])
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void alarmStateInit(AlarmStateType *st)
+{
+	int level;
+
+	for (level = 0; level < ALARM_LEVELS; level++)
+	{
+		st->lvl[level].active = 0;
+		st->lvl[level].acked = 1;
+		st->lvl[level].changeMs = -1;
+	}
+}
+
+const char* alarmLevelName(int level)
+{
+	return gAlarmLevelNames[level];
+}
+
+const char* alarmEventName(int type)
+{
+	return gAlarmEventNames[type];
+}
+
+/*
+ * alarmPrimary:
+ *	The limit mirrored to the LED of the card: high, else high-high, else
+ *	low. -1 if none is set.
+ */
+int alarmPrimary(const AlarmCfgType *cfg)
+{
+	if (cfg->set[ALARM_H])
+	{
+		return ALARM_H;
+	}
+	if (cfg->set[ALARM_HH])
+	{
+		return ALARM_HH;
+	}
+	return cfg->set[ALARM_L] ? ALARM_L : -1;
+}
+
+/*
+ * alarmCond:
+ *	Tells if the value is past the limit; an active alarm needs the value
+ *	back by the hysteresis to be inside
+ */
+static int alarmCond(const AlarmCfgType *cfg, int level, int active, int val)
+{
+	int lim = cfg->limit[level];
+
+	if (level == ALARM_L)
+	{
+		return active ? val < lim + cfg->hyst : val < lim;
+	}
+	return active ? val > lim - cfg->hyst : val > lim;
+}
+
+/*
+ * alarmUpdate:
+ *	Evaluate the limits of a channel on a read taken at tUs (monotonic).
+ *	Returns how many events were stored in ev[].
+ */
+int alarmUpdate(const AlarmCfgType *cfg, AlarmStateType *st, int16_t val,
+	uint64_t tUs, AlarmEventType ev[ALARM_LEVELS])
+{
+	int64_t ms = (int64_t) (tUs / 1000);
+	AlarmLevelType *l;
+	int level, cond;
+	int n = 0;
+
+	for (level = 0; level < ALARM_LEVELS; level++)
+	{
+		if (!cfg->set[level])
+		{
+			continue;
+		}
+		l = &st->lvl[level];
+		cond = alarmCond(cfg, level, l->active, val);
+		if (cond == l->active)
+		{
+			l->changeMs = -1;
+			continue;
+		}
+		if (l->changeMs < 0)
+		{
+			l->changeMs = ms;
+		}
+		if (ms - l->changeMs < (l->active ? cfg->offMs : cfg->onMs))
+		{
+			continue;
+		}
+		l->active = cond;
+		l->changeMs = -1;
+		if (cond)
+		{
+			l->acked = 0;
+		}
+		ev[n].level = level;
+		ev[n++].type = cond ? ALARM_EV_ON : ALARM_EV_OFF;
+	}
+	return n;
+}
+
+/*
+ * alarmAck:
+ *	Acknowledge the alarms of a channel raised since the last
+ *	acknowledgement, active or cleared. Returns the number of events.
+ */
+int alarmAck(const AlarmCfgType *cfg, AlarmStateType *st,
+	AlarmEventType ev[ALARM_LEVELS])
+{
+	int level;
+	int n = 0;
+
+	for (level = 0; level < ALARM_LEVELS; level++)
+	{
+		if (cfg->set[level] && !st->lvl[level].acked)
+		{
+			st->lvl[level].acked = 1;
+			ev[n].level = level;
+			ev[n++].type = ALARM_EV_ACK;
+		}
+	}
+	return n;
+}
+
+static int alarmSetting(const char *s, AlarmCfgType *cfg, int scale)
+{
+	char kind[8];
+	float v;
+	int level;
+
+	if (2 != sscanf(s, "%7[a-z]:%f", kind, &v))
+	{
+		return -1;
+	}
+	for (level = 0; level < ALARM_LEVELS; level++)
+	{
+		if (0 == strcmp(kind, gAlarmLevelNames[level]))
+		{
+			cfg->set[level] = 1;
+			cfg->limit[level] = (int) (v * scale + (v < 0 ? -0.5f : 0.5f));
+			return 0;
+		}
+	}
+	if (v < 0)
+	{
+		return -1;
+	}
+	if (0 == strcmp(kind, "hyst"))
+	{
+		cfg->hyst = (int) (v * scale + 0.5f);
+	}
+	else if (0 == strcmp(kind, "on"))
+	{
+		cfg->onMs = (uint32_t) (v * 1000);
+	}
+	else if (0 == strcmp(kind, "off"))
+	{
+		cfg->offMs = (uint32_t) (v * 1000);
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * alarmParse:
+ *	"[<ch>[-<ch>]=]<setting>:<value>" on every channel or on some channels
+ *	(1 based), the settings are the limits hh, h and l in engineering
+ *	units, hyst in engineering units and the on and off delays in seconds.
+ *	Returns 0 or -1 for a bad spec.
+ */
+int alarmParse(const char *spec, AlarmCfgType *cfg, int channels, int scale)
+{
+	const char *p;
+	int first = 1, last = channels;
+	int ch;
+
+	p = strchr(spec, '=');
+	if (NULL != p)
+	{
+		if (2 != sscanf(spec, "%d-%d=", &first, &last))
+		{
+			first = last = atoi(spec);
+		}
+		if (first < 1 || last > channels || first > last)
+		{
+			return -1;
+		}
+		spec = p + 1;
+	}
+	for (ch = first; ch <= last; ch++)
+	{
+		if (0 != alarmSetting(spec, &cfg[ch - 1], scale))
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int alarmOutOpenAs(AlarmOutType *out, const char *spec)
+{
+	struct addrinfo hints, *ai;
+	struct sockaddr_un un;
+	char host[256];
+	const char *port;
+
+	memset(out, 0, sizeof(AlarmOutType));
+	out->fd = -1;
+	if (0 == strncmp(spec, "udp:", 4))
+	{
+		port = strrchr(spec + 4, ':');
+		if (NULL == port || port - (spec + 4) >= (int)sizeof(host))
+		{
+			return -1;
+		}
+		memcpy(host, spec + 4, port - (spec + 4));
+		host[port - (spec + 4)] = 0;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+		if (0 != getaddrinfo(host, port + 1, &hints, &ai))
+		{
+			return -1;
+		}
+		out->fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (out->fd >= 0 && 0 != connect(out->fd, ai->ai_addr, ai->ai_addrlen))
+		{
+			close(out->fd);
+			out->fd = -1;
+		}
+		freeaddrinfo(ai);
+		out->sock = 1;
+	}
+	else if (0 == strncmp(spec, "unix:", 5))
+	{
+		memset(&un, 0, sizeof(un));
+		un.sun_family = AF_UNIX;
+		if (strlen(spec + 5) >= sizeof(un.sun_path))
+		{
+			return -1;
+		}
+		strcpy(un.sun_path, spec + 5);
+		out->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+		if (out->fd >= 0 && 0 != connect(out->fd, (struct sockaddr*)&un, sizeof(un)))
+		{
+			close(out->fd);
+			out->fd = -1;
+		}
+		out->sock = 1;
+	}
+	else
+	{
+		out->fd = open(spec, O_WRONLY | O_CREAT | O_APPEND | O_NOFOLLOW | O_CLOEXEC,
+			0644);
+	}
+	return out->fd >= 0 ? 0 : -1;
+}
+
+/*
+ * alarmOutOpen:
+ *	Event output: "udp:<host>:<port>", "unix:<datagram socket path>" or a
+ *	file the records are appended to. The socket path and the file are
+ *	opened with the rights of the user running the setuid binary, a file
+ *	never through a symbolic link. Returns 0 or -1.
+ */
+int alarmOutOpen(AlarmOutType *out, const char *spec)
+{
+	int ret;
+
+	if (0 != doUserBegin())
+	{
+		return -1;
+	}
+	ret = alarmOutOpenAs(out, spec);
+	if (0 != doUserEnd())
+	{
+		alarmOutClose(out);
+		return -1;
+	}
+	return ret;
+}
+
+/*
+ * alarmOutSend:
+ *	One record, one datagram or one append. A socket never blocks the
+ *	caller: with no receiver or a full queue the record is counted as
+ *	dropped.
+ */
+void alarmOutSend(AlarmOutType *out, const char *rec, int len)
+{
+	ssize_t ret;
+
+	if (out->fd < 0)
+	{
+		return;
+	}
+	if (out->sock)
+	{
+		ret = send(out->fd, rec, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+	}
+	else
+	{
+		ret = write(out->fd, rec, len);
+	}
+	if (ret == len)
+	{
+		out->sent++;
+	}
+	else
+	{
+		out->dropped++;
+	}
+}
+
+void alarmOutClose(AlarmOutType *out)
+{
+	if (out->fd >= 0)
+	{
+		close(out->fd);
+		out->fd = -1;
+	}
+}
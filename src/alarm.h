@@ -0,0 +1,72 @@
+#ifndef ALARM_H_
+#define ALARM_H_
+
+#include <stdint.h>
+
+enum
+{
+	ALARM_HH = 0,
+	ALARM_H,
+	ALARM_L,
+	ALARM_LEVELS
+};
+
+enum
+{
+	ALARM_EV_OFF = 0,
+	ALARM_EV_ON,
+	ALARM_EV_ACK
+};
+
+typedef struct
+{
+	int set[ALARM_LEVELS];
+	int limit[ALARM_LEVELS]; // raw units
+	int hyst; // raw units, an alarm clears this far inside its limit
+	uint32_t onMs; // the limit must be passed this long to raise
+	uint32_t offMs; // and be back this long to clear
+} AlarmCfgType;
+
+typedef struct
+{
+	int active;
+	int acked; // 0 - raised and not acknowledged yet, even if cleared since
+	int64_t changeMs; // the condition differs from "active" since, -1 - it does not
+} AlarmLevelType;
+
+typedef struct
+{
+	AlarmLevelType lvl[ALARM_LEVELS];
+} AlarmStateType;
+
+typedef struct
+{
+	int level;
+	int type; // ALARM_EV_xxx
+} AlarmEventType;
+
+typedef struct
+{
+	int fd;
+	int sock;
+	uint32_t sent;
+	uint32_t dropped;
+} AlarmOutType;
+
+void alarmInit(AlarmCfgType *cfg);
+int alarmActive(const AlarmCfgType *cfg);
+void alarmStateInit(AlarmStateType *st);
+int alarmUpdate(const AlarmCfgType *cfg, AlarmStateType *st, int16_t val,
+	uint64_t tUs, AlarmEventType ev[ALARM_LEVELS]);
+int alarmAck(const AlarmCfgType *cfg, AlarmStateType *st,
+	AlarmEventType ev[ALARM_LEVELS]);
+int alarmPrimary(const AlarmCfgType *cfg);
+const char* alarmLevelName(int level);
+const char* alarmEventName(int type);
+int alarmParse(const char *spec, AlarmCfgType *cfg, int channels, int scale);
+
+int alarmOutOpen(AlarmOutType *out, const char *spec);
+void alarmOutSend(AlarmOutType *out, const char *rec, int len);
+void alarmOutClose(AlarmOutType *out);
+
+#endif //ALARM_H_
@@ -0,0 +1,681 @@
+/*
+ * analyze.c:
+ *	Statistics over the segment files written by --log: per channel count,
+ *	min, max, mean, standard deviation, time above a threshold and an
+ *	optional histogram, over a time range, and the p50/p95/p99 of t-digests.
+ *	The files are mapped and cut in chunks of frames scanned by one thread
+ *	per core on the raw int16 values; the per thread results, digests
+ *	included, are merged at the end.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "smtc.h"
+#include "comm.h"
+#include "out.h"
+#include "journal.h"
+#include "digest.h"
+
+#define ANALYZE_FILES_MAX		4096
+#define ANALYZE_CHUNK_FRAMES	(256 * 1024)
+#define ANALYZE_THREADS_MAX		64
+#define ANALYZE_CARDS			(COMM_BUS_MAX * SMTC_STACK_MAX)
+#define ANALYZE_KEYS			(ANALYZE_CARDS * SMTC_CH_NR)
+#define ANALYZE_GAP_MAX_MS		60000 // longer gaps do not count as time above
+#define ANALYZE_BINS_MAX		1000
+
+typedef struct
+{
+	uint64_t count;
+	int64_t sum;
+	int64_t sumSq;
+	int16_t min;
+	int16_t max;
+	int64_t aboveMs;
+} AnalyzeAccType;
+
+typedef struct
+{
+	uint32_t frames;
+	uint32_t invalid;
+	uint32_t errors;
+	AnalyzeAccType acc[ANALYZE_KEYS];
+	uint32_t *hist; // [ANALYZE_KEYS][bins]
+	DigestType *digest[ANALYZE_KEYS]; // on the first value of the channel
+} AnalyzeResultType;
+
+typedef struct
+{
+	int64_t firstMs; // 0 - the card has no frame in the chunk
+	int64_t lastMs;
+	uint8_t firstAbove; // channels above the threshold in the first frame
+} AnalyzeEdgeType;
+
+typedef struct
+{
+	int file;
+	uint64_t first; // frame index
+	uint64_t count;
+	AnalyzeEdgeType edge[ANALYZE_CARDS]; // for the time above across chunks
+} AnalyzeChunkType;
+
+typedef struct
+{
+	int64_t fromMs;
+	int64_t toMs;
+	int above; // raw threshold
+	int histLo; // raw
+	int histHi;
+	int bins;
+	int files;
+	char *name[ANALYZE_FILES_MAX];
+	const uint8_t *map[ANALYZE_FILES_MAX];
+	size_t size[ANALYZE_FILES_MAX];
+	int chunks;
+	AnalyzeChunkType *chunk;
+	int next; // next chunk to scan
+	pthread_mutex_t mutex;
+} AnalyzeJobType;
+
+static AnalyzeJobType gJob;
+
+static int analyzeKey(const FrameType *f, int ch)
+{
+	return ( (int)f->bus * SMTC_STACK_MAX + f->stack) * SMTC_CH_NR + ch;
+}
+
+/*
+ * analyzeScan:
+ *	One chunk of frames into the thread results. Time above the threshold
+ *	adds the time since the previous frame of the same card while the
+ *	channel is above; for the first frame of each card the previous one is
+ *	in another chunk, analyzeEdges() adds that interval after the merge.
+ */
+static void analyzeScan(const AnalyzeJobType *job, AnalyzeChunkType *c,
+	AnalyzeResultType *r)
+{
+	const FrameType *frame = (const FrameType*) (job->map[c->file]
+		+ sizeof(JournalHeaderType));
+	const FrameType *f;
+	AnalyzeAccType *a;
+	int64_t dt;
+	uint64_t i;
+	int card, ch, key, v, bin;
+
+	for (i = c->first; i < c->first + c->count; i++)
+	{
+		f = &frame[i];
+		if (!frameValid(f) || f->bus >= COMM_BUS_MAX || f->stack >= SMTC_STACK_MAX)
+		{
+			r->invalid++;
+			continue;
+		}
+		if (f->tMs < job->fromMs || f->tMs >= job->toMs)
+		{
+			continue;
+		}
+		r->frames++;
+		if (f->ret != SMTC_OK)
+		{
+			r->errors++;
+			continue;
+		}
+		card = f->bus * SMTC_STACK_MAX + f->stack;
+		dt = c->edge[card].lastMs ? f->tMs - c->edge[card].lastMs : 0;
+		if (dt < 0 || dt > ANALYZE_GAP_MAX_MS)
+		{
+			dt = 0;
+		}
+		if (c->edge[card].lastMs == 0)
+		{
+			c->edge[card].firstMs = f->tMs;
+			for (ch = 0; ch < SMTC_CH_NR; ch++)
+			{
+				if (f->raw[ch] > job->above)
+				{
+					c->edge[card].firstAbove |= (uint8_t) (1 << ch);
+				}
+			}
+		}
+		c->edge[card].lastMs = f->tMs;
+		for (ch = 0; ch < SMTC_CH_NR; ch++)
+		{
+			key = analyzeKey(f, ch);
+			a = &r->acc[key];
+			v = f->raw[ch];
+			if (a->count == 0 || v < a->min)
+			{
+				a->min = (int16_t)v;
+			}
+			if (a->count == 0 || v > a->max)
+			{
+				a->max = (int16_t)v;
+			}
+			a->count++;
+			a->sum += v;
+			a->sumSq += (int64_t)v * v;
+			if (v > job->above)
+			{
+				a->aboveMs += dt;
+			}
+			if (NULL == r->digest[key])
+			{
+				r->digest[key] = malloc(sizeof(DigestType));
+				if (NULL != r->digest[key])
+				{
+					digestInit(r->digest[key]);
+				}
+			}
+			if (NULL != r->digest[key])
+			{
+				digestAdd(r->digest[key], (float)v);
+			}
+			if (job->bins > 0 && v >= job->histLo && v < job->histHi)
+			{
+				bin = (int) ( (int64_t) (v - job->histLo) * job->bins
+					/ (job->histHi - job->histLo));
+				r->hist[(size_t)key * job->bins + bin]++;
+			}
+		}
+	}
+}
+
+static void* analyzeThread(void *arg)
+{
+	AnalyzeResultType *r = (AnalyzeResultType*)arg;
+	int c;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&gJob.mutex);
+		c = gJob.next < gJob.chunks ? gJob.next++ : -1;
+		pthread_mutex_unlock(&gJob.mutex);
+		if (c < 0)
+		{
+			break;
+		}
+		analyzeScan(&gJob, &gJob.chunk[c], r);
+	}
+	return NULL;
+}
+
+static void analyzeMerge(AnalyzeResultType *dst, AnalyzeResultType *src,
+	int bins)
+{
+	const AnalyzeAccType *s;
+	AnalyzeAccType *d;
+	size_t i;
+	int k;
+
+	dst->frames += src->frames;
+	dst->invalid += src->invalid;
+	dst->errors += src->errors;
+	for (k = 0; k < ANALYZE_KEYS; k++)
+	{
+		s = &src->acc[k];
+		d = &dst->acc[k];
+		if (s->count == 0)
+		{
+			continue;
+		}
+		if (d->count == 0 || s->min < d->min)
+		{
+			d->min = s->min;
+		}
+		if (d->count == 0 || s->max > d->max)
+		{
+			d->max = s->max;
+		}
+		d->count += s->count;
+		d->sum += s->sum;
+		d->sumSq += s->sumSq;
+		d->aboveMs += s->aboveMs;
+		if (NULL == dst->digest[k])
+		{
+			dst->digest[k] = src->digest[k]; // taken over
+			src->digest[k] = NULL;
+		}
+		else if (NULL != src->digest[k])
+		{
+			digestMerge(dst->digest[k], src->digest[k]);
+		}
+	}
+	for (i = 0; i < (size_t)ANALYZE_KEYS * bins; i++)
+	{
+		dst->hist[i] += src->hist[i];
+	}
+}
+
+/*
+ * analyzeEdges:
+ *	Time above between the last frame of a card in a chunk and its first
+ *	frame in the next chunk that has one, so the result does not depend on
+ *	the chunks and the threads
+ */
+static void analyzeEdges(const AnalyzeJobType *job, AnalyzeResultType *r)
+{
+	const AnalyzeEdgeType *e;
+	int64_t prevMs, dt;
+	int card, c, ch;
+
+	for (card = 0; card < ANALYZE_CARDS; card++)
+	{
+		prevMs = 0;
+		for (c = 0; c < job->chunks; c++)
+		{
+			e = &job->chunk[c].edge[card];
+			if (e->lastMs == 0)
+			{
+				continue;
+			}
+			dt = prevMs ? e->firstMs - prevMs : 0;
+			for (ch = 0; ch < SMTC_CH_NR && dt > 0 && dt <= ANALYZE_GAP_MAX_MS; ch++)
+			{
+				if (e->firstAbove & (1 << ch))
+				{
+					r->acc[card * SMTC_CH_NR + ch].aboveMs += dt;
+				}
+			}
+			prevMs = e->lastMs;
+		}
+	}
+}
+
+static void analyzeFree(AnalyzeResultType *r)
+{
+	int k;
+
+	for (k = 0; k < ANALYZE_KEYS; k++)
+	{
+		free(r->digest[k]);
+		r->digest[k] = NULL;
+	}
+	free(r->hist);
+	r->hist = NULL;
+}
+
+static int analyzeNameCmp(const void *a, const void *b)
+{
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/*
+ * analyzeAddPath:
+ *	A segment file, or every segment file of a directory
+ */
+static int analyzeAddPath(AnalyzeJobType *job, const char *path)
+{
+	char name[JOURNAL_NAME_MAX + 32];
+	struct dirent *e;
+	struct stat st;
+	unsigned int n;
+	DIR *d;
+
+	if (0 != stat(path, &st))
+	{
+		printf("Fail to open %s: %s\n", path, strerror(errno));
+		return ERROR;
+	}
+	if (!S_ISDIR(st.st_mode))
+	{
+		if (job->files >= ANALYZE_FILES_MAX)
+		{
+			printf("Too many files!\n");
+			return ERROR;
+		}
+		job->name[job->files++] = strdup(path);
+		return OK;
+	}
+	d = opendir(path);
+	if (NULL == d)
+	{
+		printf("Fail to open %s: %s\n", path, strerror(errno));
+		return ERROR;
+	}
+	while ( (e = readdir(d)) != NULL)
+	{
+		if (1 != sscanf(e->d_name, "seg-%u.smtc", &n))
+		{
+			continue;
+		}
+		if (job->files >= ANALYZE_FILES_MAX
+			|| snprintf(name, sizeof(name), "%s/%s", path, e->d_name)
+				>= (int)sizeof(name))
+		{
+			closedir(d);
+			printf("Too many files!\n");
+			return ERROR;
+		}
+		job->name[job->files++] = strdup(name);
+	}
+	closedir(d);
+	return OK;
+}
+
+/*
+ * analyzeMapFiles:
+ *	Map the files with a valid header and cut them in chunks
+ */
+static int analyzeMapFiles(AnalyzeJobType *job)
+{
+	const JournalHeaderType *h;
+	struct stat st;
+	uint64_t frames, first;
+	int i, fd;
+
+	job->chunks = 0;
+	for (i = 0; i < job->files; i++)
+	{
+		job->map[i] = NULL;
+		fd = open(job->name[i], O_RDONLY);
+		if (fd < 0 || 0 != fstat(fd, &st)
+			|| (size_t)st.st_size < sizeof(JournalHeaderType))
+		{
+			printf("Skip %s, not a segment file\n", job->name[i]);
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+			continue;
+		}
+		job->map[i] = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (MAP_FAILED == job->map[i])
+		{
+			job->map[i] = NULL;
+			continue;
+		}
+		h = (const JournalHeaderType*)job->map[i];
+		if (0 != memcmp(h->magic, JOURNAL_MAGIC, sizeof(h->magic))
+			|| h->version != JOURNAL_VERSION || h->frameSize != sizeof(FrameType))
+		{
+			printf("Skip %s, not a segment file\n", job->name[i]);
+			munmap((void*)job->map[i], (size_t)st.st_size);
+			job->map[i] = NULL;
+			continue;
+		}
+		job->size[i] = (size_t)st.st_size;
+		madvise((void*)job->map[i], job->size[i], MADV_SEQUENTIAL);
+		frames = (job->size[i] - sizeof(JournalHeaderType)) / sizeof(FrameType);
+		job->chunks += (int) ( (frames + ANALYZE_CHUNK_FRAMES - 1)
+			/ ANALYZE_CHUNK_FRAMES);
+	}
+	job->chunk = calloc(job->chunks > 0 ? job->chunks : 1, sizeof(AnalyzeChunkType));
+	if (NULL == job->chunk)
+	{
+		return ERROR;
+	}
+	job->chunks = 0;
+	for (i = 0; i < job->files; i++)
+	{
+		if (NULL == job->map[i])
+		{
+			continue;
+		}
+		frames = (job->size[i] - sizeof(JournalHeaderType)) / sizeof(FrameType);
+		for (first = 0; first < frames; first += ANALYZE_CHUNK_FRAMES)
+		{
+			job->chunk[job->chunks].file = i;
+			job->chunk[job->chunks].first = first;
+			job->chunk[job->chunks].count = frames - first < ANALYZE_CHUNK_FRAMES ?
+				frames - first : ANALYZE_CHUNK_FRAMES;
+			job->chunks++;
+		}
+	}
+	return OK;
+}
+
+/*
+ * analyzeTime:
+ *	"YYYY-MM-DD[THH:MM[:SS]]" local time or ms since the epoch
+ */
+static int analyzeTime(const char *s, int64_t *ms)
+{
+	struct tm tm;
+	const char *end;
+	char *num;
+
+	memset(&tm, 0, sizeof(tm));
+	end = strptime(s, "%Y-%m-%dT%H:%M:%S", &tm);
+	if (NULL == end)
+	{
+		memset(&tm, 0, sizeof(tm));
+		end = strptime(s, "%Y-%m-%dT%H:%M", &tm);
+	}
+	if (NULL == end)
+	{
+		memset(&tm, 0, sizeof(tm));
+		end = strptime(s, "%Y-%m-%d", &tm);
+	}
+	if (NULL != end && *end == 0)
+	{
+		tm.tm_isdst = -1;
+		*ms = (int64_t)mktime(&tm) * 1000;
+		return 0;
+	}
+	*ms = strtoll(s, &num, 10);
+	return (*num == 0 && *s != 0) ? 0 : -1;
+}
+
+static void analyzeReport(const AnalyzeJobType *job, AnalyzeResultType *r)
+{
+	const AnalyzeAccType *a;
+	double mean, var;
+	int k, b;
+
+	for (k = 0; k < ANALYZE_KEYS; k++)
+	{
+		a = &r->acc[k];
+		if (a->count == 0)
+		{
+			continue;
+		}
+		mean = (double)a->sum / a->count;
+		var = (double)a->sumSq / a->count - mean * mean;
+		if (outFormat() == OUT_TEXT)
+		{
+			printf("%d:%d:%d ", k / (SMTC_STACK_MAX * SMTC_CH_NR),
+				k / SMTC_CH_NR % SMTC_STACK_MAX, k % SMTC_CH_NR + 1);
+		}
+		outBegin();
+		outTag("bus", k / (SMTC_STACK_MAX * SMTC_CH_NR));
+		outTag("id", k / SMTC_CH_NR % SMTC_STACK_MAX);
+		outTag("ch", k % SMTC_CH_NR + 1);
+		outLong("n", (int64_t)a->count);
+		outFixed("min", a->min, 1);
+		outFixed("max", a->max, 1);
+		outFixed("mean", (int)lrint(mean * 10), 2);
+		outFixed("stddev", (int)lrint(sqrt(var > 0 ? var : 0) * 10), 2);
+		if (NULL != r->digest[k])
+		{
+			outFixed("p50", (int)lrintf(digestQuantile(r->digest[k], 0.5) * 10), 2);
+			outFixed("p95", (int)lrintf(digestQuantile(r->digest[k], 0.95) * 10), 2);
+			outFixed("p99", (int)lrintf(digestQuantile(r->digest[k], 0.99) * 10), 2);
+		}
+		outLong("above_s", a->aboveMs / 1000);
+		outEnd();
+		for (b = 0; b < job->bins; b++)
+		{
+			if (outFormat() == OUT_TEXT)
+			{
+				printf("  ");
+			}
+			outBegin();
+			outTag("bus", k / (SMTC_STACK_MAX * SMTC_CH_NR));
+			outTag("id", k / SMTC_CH_NR % SMTC_STACK_MAX);
+			outTag("ch", k % SMTC_CH_NR + 1);
+			outFixed("bin", job->histLo
+				+ (int) ( (int64_t)b * (job->histHi - job->histLo) / job->bins), 1);
+			outLong("n", r->hist[(size_t)k * job->bins + b]);
+			outEnd();
+		}
+	}
+}
+
+int doAnalyze(int argc, char *argv[]);
+const CliCmdType CMD_ANALYZE =
+	{
+		"-analyze",
+		1,
+		&doAnalyze,
+		"\t-analyze:   Per channel statistics over the segment files of --log, scanned on all the cores\n",
+		"\tUsage:      smtc -analyze <dir|file>... [--from <time>] [--to <time>] [--above <deg>] [--hist <lo>:<hi>:<bins>] [--threads <n>]\n",
+		"\tUsage:      <time> is YYYY-MM-DD[THH:MM[:SS]] local time or ms since the epoch\n",
+		"\tExample:    smtc -analyze /var/lib/smtc/log --from 2026-01-01 --above 250; Min, max, mean, stddev and the time above 250 deg C of every channel since new year\n"};
+
+int doAnalyze(int argc, char *argv[])
+{
+	static AnalyzeResultType total;
+	AnalyzeResultType *res;
+	pthread_t thread[ANALYZE_THREADS_MAX];
+	float lo, hi, above = 1e9f;
+	long cpus;
+	int threads = 0, started = 0;
+	int i, ret = OK;
+
+	memset(&gJob, 0, sizeof(gJob));
+	gJob.fromMs = INT64_MIN;
+	gJob.toMs = INT64_MAX;
+	for (i = 2; i < argc; i++)
+	{
+		if (0 == strcmp(argv[i], "--from") && i + 1 < argc)
+		{
+			ret = analyzeTime(argv[++i], &gJob.fromMs) ? ARG_ERR : OK;
+		}
+		else if (0 == strcmp(argv[i], "--to") && i + 1 < argc)
+		{
+			ret = analyzeTime(argv[++i], &gJob.toMs) ? ARG_ERR : OK;
+		}
+		else if (0 == strcmp(argv[i], "--above") && i + 1 < argc)
+		{
+			above = (float)atof(argv[++i]);
+		}
+		else if (0 == strcmp(argv[i], "--hist") && i + 1 < argc)
+		{
+			if (3 != sscanf(argv[++i], "%f:%f:%d", &lo, &hi, &gJob.bins)
+				|| hi <= lo || gJob.bins <= 0 || gJob.bins > ANALYZE_BINS_MAX)
+			{
+				ret = ARG_ERR;
+			}
+			gJob.histLo = (int)lrintf(lo * SMTC_TEMP_SCALE);
+			gJob.histHi = (int)lrintf(hi * SMTC_TEMP_SCALE);
+		}
+		else if (0 == strcmp(argv[i], "--threads") && i + 1 < argc)
+		{
+			threads = atoi(argv[++i]);
+			ret = threads > 0 ? OK : ARG_ERR;
+		}
+		else
+		{
+			ret = analyzeAddPath(&gJob, argv[i]);
+		}
+		if (ret != OK)
+		{
+			if (ret == ARG_ERR)
+			{
+				printf("Invalid argument %s!\n", argv[i]);
+			}
+			return ret;
+		}
+	}
+	if (gJob.files == 0)
+	{
+		return ARG_CNT_ERR;
+	}
+	gJob.above = above > 3000 ? INT32_MAX : (int)lrintf(above * SMTC_TEMP_SCALE);
+	qsort(gJob.name, gJob.files, sizeof(char*), &analyzeNameCmp);
+	if (OK != analyzeMapFiles(&gJob))
+	{
+		return ERROR;
+	}
+	if (threads == 0)
+	{
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (int)cpus : 1;
+	}
+	if (threads > ANALYZE_THREADS_MAX)
+	{
+		threads = ANALYZE_THREADS_MAX;
+	}
+	if (threads > gJob.chunks)
+	{
+		threads = gJob.chunks > 0 ? gJob.chunks : 1;
+	}
+	res = calloc(threads, sizeof(AnalyzeResultType));
+	if (NULL == res)
+	{
+		return ERROR;
+	}
+	memset(&total, 0, sizeof(total));
+	pthread_mutex_init(&gJob.mutex, NULL);
+	for (i = 0; i <= threads && ret == OK; i++)
+	{
+		AnalyzeResultType *r = i < threads ? &res[i] : &total;
+
+		if (gJob.bins > 0)
+		{
+			r->hist = calloc((size_t)ANALYZE_KEYS * gJob.bins, sizeof(uint32_t));
+			ret = NULL == r->hist ? ERROR : OK;
+		}
+	}
+	for (started = 0; started < threads && ret == OK; started++)
+	{
+		if (0 != pthread_create(&thread[started], NULL, &analyzeThread, &res[started]))
+		{
+			break;
+		}
+	}
+	if (ret == OK && started < threads)
+	{
+		analyzeThread(&res[started]); // scan here what the missing threads would have
+	}
+	for (i = 0; i < started; i++)
+	{
+		pthread_join(thread[i], NULL);
+	}
+	for (i = 0; i < threads && ret == OK; i++)
+	{
+		analyzeMerge(&total, &res[i], gJob.bins);
+	}
+	if (ret == OK)
+	{
+		analyzeEdges(&gJob, &total);
+		analyzeReport(&gJob, &total);
+		fprintf(stderr, "%d files, %u frames in range, %u read errors, %u invalid, %d threads\n",
+			gJob.files, total.frames, total.errors, total.invalid, threads);
+	}
+	for (i = 0; i < threads; i++)
+	{
+		analyzeFree(&res[i]);
+	}
+	free(res);
+	analyzeFree(&total);
+	for (i = 0; i < gJob.files; i++)
+	{
+		if (NULL != gJob.map[i])
+		{
+			munmap((void*)gJob.map[i], gJob.size[i]);
+		}
+		free(gJob.name[i]);
+	}
+	free(gJob.chunk);
+	return ret;
+}
@@ -0,0 +1,261 @@
+/*
+ * bench.c:
+ *	Timing benchmark: a fixed rate acquisition loop on one card for a given
+ *	time, measuring how late each read starts against its schedule, how
+ *	long the bus transaction takes and how long the sample takes to reach
+ *	a consumer thread. The results are percentile tables, so runs with
+ *	different kernels, scheduler settings, transports or code can be
+ *	compared.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "smtc.h"
+#include "comm.h"
+#include "hist.h"
+#include "thread.h"
+
+#define BENCH_QUEUE_SIZE	1024 // power of two
+#define BENCH_DEFAULT_ID	"0"
+#define BENCH_RT_PRI_DEFAULT	50
+
+typedef struct
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	uint64_t doneUs[BENCH_QUEUE_SIZE]; // time each sample was read
+	uint32_t head;
+	uint32_t tail;
+	uint32_t dropped;
+	int stop;
+} BenchQueueType;
+
+static volatile sig_atomic_t gBenchStop = 0;
+static BenchQueueType gBenchQueue;
+static HistType gBenchSched;
+static HistType gBenchXfer;
+static HistType gBenchDeliver;
+
+static void benchSignal(int sig)
+{
+	(void)sig;
+	gBenchStop = 1;
+}
+
+static void benchPush(BenchQueueType *q, uint64_t doneUs)
+{
+	pthread_mutex_lock(&q->mutex);
+	if (q->head - q->tail < BENCH_QUEUE_SIZE)
+	{
+		q->doneUs[q->head % BENCH_QUEUE_SIZE] = doneUs;
+		q->head++;
+	}
+	else
+	{
+		q->dropped++;
+	}
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->mutex);
+}
+
+/*
+ * benchConsumer:
+ *	Stands for the application: takes the samples as soon as they are
+ *	signaled and counts how old they are on arrival
+ */
+static void* benchConsumer(void *arg)
+{
+	BenchQueueType *q = (BenchQueueType*)arg;
+	uint64_t doneUs, now;
+
+	pthread_mutex_lock(&q->mutex);
+	for (;;)
+	{
+		while (q->head == q->tail && !q->stop)
+		{
+			pthread_cond_wait(&q->cond, &q->mutex);
+		}
+		if (q->head == q->tail)
+		{
+			break;
+		}
+		doneUs = q->doneUs[q->tail % BENCH_QUEUE_SIZE];
+		q->tail++;
+		pthread_mutex_unlock(&q->mutex);
+		now = commTimeUs();
+		histAdd(&gBenchDeliver, now > doneUs ? now - doneUs : 0);
+		pthread_mutex_lock(&q->mutex);
+	}
+	pthread_mutex_unlock(&q->mutex);
+	return NULL;
+}
+
+/*
+ * benchLoop:
+ *	The producer: absolute time schedule, a missed period is counted late
+ *	and the schedule goes on from the next one
+ */
+static uint32_t benchLoop(SmtcBoardType *board, int periodMs, int seconds)
+{
+	int16_t raw[SMTC_CH_NR];
+	struct timespec ts;
+	uint64_t startUs, dueUs, endUs, t0, t1;
+	uint64_t periodUs = (uint64_t)periodMs * 1000;
+	uint32_t errors = 0;
+
+	startUs = commTimeUs();
+	endUs = startUs + (uint64_t)seconds * 1000000ULL;
+	for (dueUs = startUs; !gBenchStop && dueUs < endUs; dueUs += periodUs)
+	{
+		ts.tv_sec = (time_t) (dueUs / 1000000ULL);
+		ts.tv_nsec = (long) (dueUs % 1000000ULL) * 1000L;
+		while (!gBenchStop
+			&& EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+			;
+		t0 = commTimeUs();
+		histAdd(&gBenchSched, t0 - dueUs);
+		if (SMTC_OK != smtcReadRawAll(board, raw))
+		{
+			errors++;
+		}
+		t1 = commTimeUs();
+		histAdd(&gBenchXfer, t1 - t0);
+		benchPush(&gBenchQueue, t1);
+		while (dueUs + periodUs < t1)
+		{
+			dueUs += periodUs; // overrun, skip the missed periods
+		}
+	}
+	return errors;
+}
+
+int doBench(int argc, char *argv[]);
+const CliCmdType CMD_BENCH =
+	{
+		"-bench",
+		1,
+		&doBench,
+		"\t-bench:     Measure the sampling jitter, the bus transaction time and the delivery latency of a fixed rate loop\n",
+		"\tUsage:      smtc -bench <period ms> <seconds> [<id>] [--rt <cpu>[:<prio>]] [--transport <i2c|sim|replay:file>]\n",
+		"",
+		"\tExample:    smtc -bench 10 60 0 --rt 3; Read card 0 every 10ms for a minute on a real time thread\n"};
+
+int doBench(int argc, char *argv[])
+{
+	SmtcBoardType *board;
+	pthread_t consumer;
+	const char *id = BENCH_DEFAULT_ID;
+	int periodMs = 0, seconds = 0;
+	int rtCpu = -1, rtPri = 0;
+	int rtFail = 0;
+	uint32_t errors;
+	int n = 0;
+	int i;
+
+	for (i = 2; i < argc; i++)
+	{
+		if (0 == strcmp(argv[i], "--rt") && i + 1 < argc)
+		{
+			rtPri = BENCH_RT_PRI_DEFAULT;
+			if (sscanf(argv[++i], "%d:%d", &rtCpu, &rtPri) < 1 || rtCpu < 0
+				|| rtPri <= 0)
+			{
+				printf("Invalid real time setting %s!\n", argv[i]);
+				return ARG_ERR;
+			}
+		}
+		else if (0 == strcmp(argv[i], "--transport") && i + 1 < argc)
+		{
+			if (0 != commTransportSet(argv[++i]))
+			{
+				printf("Invalid transport %s!\n", argv[i]);
+				return ARG_ERR;
+			}
+		}
+		else if (n == 0 && atoi(argv[i]) > 0)
+		{
+			periodMs = atoi(argv[i]);
+			n++;
+		}
+		else if (n == 1 && atoi(argv[i]) > 0)
+		{
+			seconds = atoi(argv[i]);
+			n++;
+		}
+		else if (n == 2)
+		{
+			id = argv[i];
+			n++;
+		}
+		else
+		{
+			printf("Invalid argument %s!\n", argv[i]);
+			return ARG_ERR;
+		}
+	}
+	if (n < 2)
+	{
+		return ARG_CNT_ERR;
+	}
+	board = doBoardOpen(id);
+	if (NULL == board)
+	{
+		return ERROR;
+	}
+	histInit(&gBenchSched);
+	histInit(&gBenchXfer);
+	histInit(&gBenchDeliver);
+	memset(&gBenchQueue, 0, sizeof(gBenchQueue));
+	pthread_mutex_init(&gBenchQueue.mutex, NULL);
+	pthread_cond_init(&gBenchQueue.cond, NULL);
+	if (rtPri > 0)
+	{
+		rtFail = 0 != piMemLock();
+	}
+	if (0 != pthread_create(&consumer, NULL, &benchConsumer, &gBenchQueue))
+	{
+		printf("Fail to start the consumer thread!\n");
+		return ERROR;
+	}
+	if (rtPri > 0)
+	{
+		rtFail |= 0 != piThreadRt(rtCpu, rtPri);
+	}
+	signal(SIGINT, &benchSignal);
+	signal(SIGTERM, &benchSignal);
+	errors = benchLoop(board, periodMs, seconds);
+	pthread_mutex_lock(&gBenchQueue.mutex);
+	gBenchQueue.stop = 1;
+	pthread_cond_signal(&gBenchQueue.cond);
+	pthread_mutex_unlock(&gBenchQueue.mutex);
+	pthread_join(consumer, NULL);
+
+	printf("# transport %s, bus %d, card %d, period %dms, %u read errors, %u samples dropped\n",
+		commTransportGet()->name, board->bus, board->stack, periodMs, errors,
+		gBenchQueue.dropped);
+	if (rtFail)
+	{
+		printf("# real time setup failed, normal scheduling\n");
+	}
+	else if (rtPri > 0)
+	{
+		printf("# SCHED_FIFO %d on cpu %d, memory locked\n", rtPri, rtCpu);
+	}
+	printf("\n");
+	histPrint(stdout, "schedule lateness (us)", &gBenchSched);
+	histPrint(stdout, "bus transaction (us)", &gBenchXfer);
+	histPrint(stdout, "delivery to consumer (us)", &gBenchDeliver);
+	return OK;
+}
@@ -0,0 +1,166 @@
+/*
+ * bustest.c:
+ *	Bus load test: round robin bulk temperature reads from every card in
+ *	the stack, reporting throughput, errors and sample freshness per card
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "smtc.h"
+#include "comm.h"
+#include "fault.h"
+
+#define BUSTEST_STACK_MAX	8
+#define TEMP_PLAUSIBLE_MIN	(-2700)
+#define TEMP_PLAUSIBLE_MAX	(18200)
+
+typedef struct
+{
+	int dev;
+	u32 ok;
+	u32 err;
+	u32 suspect;
+	uint64_t lastOkUs;
+	uint64_t ageSumUs;
+	uint64_t ageMaxUs;
+} BusTestBoardType;
+
+int doBusTest(int argc, char *argv[]);
+const CliCmdType CMD_BUS_TEST =
+	{
+		"-bustest",
+		1,
+		&doBusTest,
+		"\t-bustest:   Read all the cards in the stack in a loop and display throughput, errors and sample age\n",
+		"\tUsage:      smtc -bustest <rounds>\n",
+		"",
+		"\tExample:    smtc -bustest 1000; Read 1000 times all the temperatures of every card\n"};
+
+int doBusTest(int argc, char *argv[])
+{
+	BusTestBoardType b[BUSTEST_STACK_MAX];
+	FaultStatsType fs;
+	u8 buff[TEMP_DATA_SIZE * TCP_CH_NR_MAX];
+	CommStatsType st;
+	CommHealthType h;
+	s16 val;
+	uint64_t start, now, elapsed, age;
+	int bus = doBusDefault();
+	int rounds, r, i, ch, cnt = 0;
+
+	if (argc != 3)
+	{
+		return ARG_CNT_ERR;
+	}
+	rounds = atoi(argv[2]);
+	if (rounds <= 0)
+	{
+		printf("Invalid rounds number!\n");
+		return ARG_ERR;
+	}
+	memset(b, 0, sizeof(b));
+	for (i = 0; i < BUSTEST_STACK_MAX; i++)
+	{
+		b[i].dev = commOpen(bus, SLAVE_OWN_ADDRESS_BASE + i);
+		if (b[i].dev > 0
+			&& OK != i2cMem8Probe(b[i].dev, REVISION_MAJOR_MEM_ADD, buff, 1))
+		{
+			commClose(b[i].dev);
+			b[i].dev = 0;
+		}
+		if (b[i].dev > 0)
+		{
+			cnt++;
+		}
+	}
+	if (cnt == 0)
+	{
+		printf("No card detected!\n");
+		return ERROR;
+	}
+	start = commTimeUs();
+	for (i = 0; i < BUSTEST_STACK_MAX; i++)
+	{
+		b[i].lastOkUs = start;
+	}
+	for (r = 0; r < rounds; r++)
+	{
+		for (i = 0; i < BUSTEST_STACK_MAX; i++)
+		{
+			if (b[i].dev <= 0
+				|| !commPollDue(bus, SLAVE_OWN_ADDRESS_BASE + i, r))
+			{
+				continue;
+			}
+			if (OK != i2cMem8Read(b[i].dev, TCP_VAL1_ADD, buff, sizeof(buff)))
+			{
+				b[i].err++;
+			}
+			else
+			{
+				b[i].ok++;
+				b[i].lastOkUs = commTimeUs();
+				for (ch = 0; ch < TCP_CH_NR_MAX; ch++)
+				{
+					memcpy(&val, &buff[TEMP_DATA_SIZE * ch], sizeof(val));
+					if (val < TEMP_PLAUSIBLE_MIN || val > TEMP_PLAUSIBLE_MAX)
+					{
+						b[i].suspect++;
+						break;
+					}
+				}
+			}
+		}
+		now = commTimeUs();
+		for (i = 0; i < BUSTEST_STACK_MAX; i++)
+		{
+			if (b[i].dev > 0)
+			{
+				age = now - b[i].lastOkUs;
+				b[i].ageSumUs += age;
+				if (age > b[i].ageMaxUs)
+				{
+					b[i].ageMaxUs = age;
+				}
+			}
+		}
+	}
+	elapsed = commTimeUs() - start;
+	if (elapsed == 0)
+	{
+		elapsed = 1;
+	}
+	printf("%d card(s), %d rounds in %.3f s\n", cnt, rounds, elapsed / 1e6);
+	printf(
+		"Id      ok     err suspect   reads/s  age avg ms  age max ms retries health\n");
+	for (i = 0; i < BUSTEST_STACK_MAX; i++)
+	{
+		if (b[i].dev <= 0)
+		{
+			continue;
+		}
+		commStatsGet(bus, SLAVE_OWN_ADDRESS_BASE + i, &st);
+		commHealthGet(bus, SLAVE_OWN_ADDRESS_BASE + i, &h);
+		printf("%2d %7u %7u %7u %9.1f %11.2f %11.2f %7u %3d%s\n", i, b[i].ok,
+			b[i].err, b[i].suspect, b[i].ok * 1e6 / elapsed,
+			b[i].ageSumUs / 1e3 / rounds, b[i].ageMaxUs / 1e3, st.retries, h.score,
+			h.tier == COMM_TIER_SLOW ? " slow" : "");
+		commClose(b[i].dev);
+	}
+	if (faultActive())
+	{
+		faultStatsGet(&fs);
+		printf("Injected: %u nak, %u stuck, %u corrupt, %.1f ms latency\n",
+			fs.injected[FAULT_NAK], fs.injected[FAULT_STUCK],
+			fs.injected[FAULT_CORRUPT], fs.delayUs / 1e3);
+	}
+	return OK;
+}
@@ -0,0 +1,267 @@
+/*
+ * cache.c:
+ *	Card topology cache shared by all the processes using the library:
+ *	presence, revision, card type and sensor types per bus and stack level,
+ *	kept in a small file on tmpfs so it does not survive a reboot.
+ *
+ *	Entries expire after SMTC_CACHE_TTL seconds (0 disables the cache), a
+ *	missing card after CACHE_ABSENT_TTL_S seconds so a card plugged in is
+ *	seen soon, and are dropped on the first failed transaction with the
+ *	card. Every entry
+ *	is written with a single pwrite() and carries a checksum, a torn entry
+ *	reads as a miss.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#define _GNU_SOURCE // secure_getenv
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "smtc.h"
+#include "comm.h"
+#include "cache.h"
+
+#define CACHE_DIR		"/dev/shm"
+#define CACHE_MAGIC		0x534d5431 // "SMT1"
+
+typedef struct
+{
+	u32 magic;
+	u8 state;
+	u8 hwMajor;
+	u8 hwMinor;
+	u8 fwMajor;
+	u8 fwMinor;
+	u8 cardTypeValid;
+	u8 cardType;
+	u8 typesValid;
+	u8 types[SMTC_CH_NR];
+	uint64_t timeS;
+	u32 sum;
+} CacheEntryType;
+
+static int gCacheFd = -1;
+static int gCacheTtl = -1;
+static pthread_once_t gCacheOnce = PTHREAD_ONCE_INIT;
+
+/*
+ * cacheOpen:
+ *	The file is created by the first process and writable only by its
+ *	owner, the setuid binary runs as root and the library as the user; the
+ *	others read it. A file that is not ours, not root's or that others can
+ *	write is not trusted and the cache stays off.
+ */
+static void cacheOpen(void)
+{
+	const char *env = secure_getenv("SMTC_CACHE_TTL");
+	const char *tr;
+	char name[64];
+	struct stat sb;
+
+	gCacheTtl = env ? atoi(env) : CACHE_DEFAULT_TTL_S;
+	tr = commTransportGet()->name;
+	// replayed traffic must come from the trace, not from a cache
+	if (gCacheTtl <= 0 || 0 == strcmp(tr, "replay"))
+	{
+		return;
+	}
+	snprintf(name, sizeof(name), CACHE_DIR "/smtc_cache_%s", tr);
+	gCacheFd = open(name, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+		0644);
+	if (gCacheFd < 0 && errno == EEXIST)
+	{
+		gCacheFd = open(name, O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+		if (gCacheFd < 0 && errno == EACCES)
+		{
+			gCacheFd = open(name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+		}
+	}
+	if (gCacheFd < 0)
+	{
+		return;
+	}
+	if (0 != fstat(gCacheFd, &sb))
+	{
+		close(gCacheFd);
+		gCacheFd = -1;
+		return;
+	}
+	if (S_ISREG(sb.st_mode) && sb.st_uid == geteuid()
+		&& (sb.st_mode & (S_IWGRP | S_IWOTH)))
+	{
+		// left writable by an older version: drop what others could write
+		if (0 == ftruncate(gCacheFd, 0) && 0 == fchmod(gCacheFd, 0644))
+		{
+			sb.st_mode &= ~(S_IWGRP | S_IWOTH);
+		}
+	}
+	if (!S_ISREG(sb.st_mode) || (sb.st_uid != geteuid() && sb.st_uid != 0)
+		|| (sb.st_mode & (S_IWGRP | S_IWOTH)))
+	{
+		close(gCacheFd);
+		gCacheFd = -1;
+	}
+}
+
+static uint64_t cacheNowS(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec;
+}
+
+static u32 cacheSum(const CacheEntryType *e)
+{
+	const u8 *p = (const u8*)e;
+	u32 sum = 0x12345;
+	size_t i;
+
+	for (i = 0; i < offsetof(CacheEntryType, sum); i++)
+	{
+		sum = sum * 31 + p[i];
+	}
+	return sum;
+}
+
+static off_t cacheOffset(int bus, int stack)
+{
+	return (off_t) (bus * SMTC_STACK_MAX + stack) * sizeof(CacheEntryType);
+}
+
+static int cacheRead(int bus, int stack, CacheEntryType *e)
+{
+	pthread_once(&gCacheOnce, cacheOpen);
+	if (gCacheFd < 0 || bus < 0 || bus >= COMM_BUS_MAX || stack < 0
+		|| stack >= SMTC_STACK_MAX)
+	{
+		return 0;
+	}
+	if (pread(gCacheFd, e, sizeof(*e), cacheOffset(bus, stack)) != sizeof(*e)
+		|| e->magic != CACHE_MAGIC || e->sum != cacheSum(e))
+	{
+		return 0;
+	}
+	return 1;
+}
+
+static void cacheWrite(int bus, int stack, CacheEntryType *e)
+{
+	pthread_once(&gCacheOnce, cacheOpen);
+	if (gCacheFd < 0 || bus < 0 || bus >= COMM_BUS_MAX || stack < 0
+		|| stack >= SMTC_STACK_MAX)
+	{
+		return;
+	}
+	e->magic = CACHE_MAGIC;
+	e->sum = cacheSum(e);
+	if (pwrite(gCacheFd, e, sizeof(*e), cacheOffset(bus, stack)) != sizeof(*e))
+	{
+		return;
+	}
+}
+
+/*
+ * cacheLookup:
+ *	Returns CACHE_PRESENT and fills the revision, card type and sensor types
+ *	of the handle, CACHE_ABSENT for a card known to be missing or CACHE_MISS.
+ */
+int cacheLookup(int bus, int stack, SmtcBoardType *board)
+{
+	CacheEntryType e;
+	uint64_t ttl;
+
+	if (!cacheRead(bus, stack, &e) || e.state == CACHE_MISS)
+	{
+		return CACHE_MISS;
+	}
+	ttl = (uint64_t)gCacheTtl;
+	if (e.state == CACHE_ABSENT && ttl > CACHE_ABSENT_TTL_S)
+	{
+		ttl = CACHE_ABSENT_TTL_S;
+	}
+	if (cacheNowS() - e.timeS > ttl)
+	{
+		return CACHE_MISS;
+	}
+	if (e.state == CACHE_PRESENT)
+	{
+		board->hwMajor = e.hwMajor;
+		board->hwMinor = e.hwMinor;
+		board->fwMajor = e.fwMajor;
+		board->fwMinor = e.fwMinor;
+		board->cardType = e.cardTypeValid ? e.cardType : -1;
+		board->typesValid = e.typesValid;
+		memcpy(board->types, e.types, SMTC_CH_NR);
+	}
+	return e.state;
+}
+
+/*
+ * cacheStore:
+ *	Save what the handle knows about the card. "probed" is set when the
+ *	card was just read from the bus and restarts the TTL; updates of the
+ *	card type or sensor types keep the time stamp of the entry so it still
+ *	expires one TTL after the last probe.
+ */
+void cacheStore(const SmtcBoardType *board, int probed)
+{
+	CacheEntryType e;
+	uint64_t timeS = cacheNowS();
+
+	if (!probed)
+	{
+		if (!cacheRead(board->bus, board->stack, &e) || e.state != CACHE_PRESENT)
+		{
+			return;
+		}
+		timeS = e.timeS;
+	}
+	memset(&e, 0, sizeof(e));
+	e.state = CACHE_PRESENT;
+	e.hwMajor = board->hwMajor;
+	e.hwMinor = board->hwMinor;
+	e.fwMajor = board->fwMajor;
+	e.fwMinor = board->fwMinor;
+	e.cardTypeValid = board->cardType >= 0;
+	e.cardType = board->cardType >= 0 ? (u8)board->cardType : 0;
+	e.typesValid = (u8)board->typesValid;
+	memcpy(e.types, board->types, SMTC_CH_NR);
+	e.timeS = timeS;
+	cacheWrite(board->bus, board->stack, &e);
+}
+
+void cacheStoreAbsent(int bus, int stack)
+{
+	CacheEntryType e;
+
+	memset(&e, 0, sizeof(e));
+	e.state = CACHE_ABSENT;
+	e.timeS = cacheNowS();
+	cacheWrite(bus, stack, &e);
+}
+
+void cacheInvalidate(int bus, int stack)
+{
+	CacheEntryType e;
+
+	if (!cacheRead(bus, stack, &e) || e.state == CACHE_MISS)
+	{
+		return;
+	}
+	memset(&e, 0, sizeof(e));
+	cacheWrite(bus, stack, &e);
+}
@@ -0,0 +1,21 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include "libsmtc.h"
+
+#define CACHE_DEFAULT_TTL_S	60
+#define CACHE_ABSENT_TTL_S	5 // a missing card, shorter to see a card plugged in
+
+enum
+{
+	CACHE_MISS = 0,
+	CACHE_PRESENT,
+	CACHE_ABSENT
+};
+
+int cacheLookup(int bus, int stack, SmtcBoardType *board);
+void cacheStore(const SmtcBoardType *board, int probed);
+void cacheStoreAbsent(int bus, int stack);
+void cacheInvalidate(int bus, int stack);
+
+#endif //CACHE_H_
@@ -8,14 +8,25 @@
  *	Author: Alexandru Burcea
  ***********************************************************************
  */
+#define _GNU_SOURCE // secure_getenv
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <sys/ioctl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
+#include "smtc.h"
 #include "comm.h"
+#include "trace.h"
+#include "fault.h"
 
 #define I2C_SLAVE	0x0703
 #define I2C_SMBUS	0x0720	/* SMBus-level access */
@@ -40,25 +51,735 @@
 #define I2C_SMBUS_BLOCK_MAX	32	/* As specified in SMBus standard */
 #define I2C_SMBUS_I2C_BLOCK_MAX	32	/* Not specified but we use same structure */
 
+#define COMM_BACKOFF_MIN_US		200
+#define COMM_BACKOFF_MAX_US		20000
+#define COMM_HEALTH_ALPHA		0.125f
+#define COMM_LATENCY_REF_US		2000.0f
+#define COMM_DEMOTE_SCORE		50
+#define COMM_PROMOTE_SCORE		80
 
-int i2cSetup(int addr)
+typedef struct
+{
+	int used;
+	int bus;
+	int addr;
+	int handle;
+} CommDevType;
+
+typedef struct
+{
+	int refs;
+	int handle;
+	int depth; // commLock() nesting of the owner thread
+	int atomic; // commLockAtomic() nesting of the owner thread
+	sem_t *sem;
+	pthread_mutex_t mutex; // recursive
+} CommBusType;
+
+static const CommTransportType *gTransport = NULL;
+static CommStatsType gStats[COMM_BUS_MAX][COMM_ADDR_MAX];
+static CommHealthType gHealth[COMM_BUS_MAX][COMM_ADDR_MAX];
+static int gRetryTimes = -1;
+static pthread_mutex_t gStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+static CommDevType gDev[COMM_DEV_MAX];
+static pthread_mutex_t gDevMutex = PTHREAD_MUTEX_INITIALIZER;
+static CommBusType gBus[COMM_BUS_MAX];
+static pthread_once_t gBusOnce = PTHREAD_ONCE_INIT;
+
+uint64_t commTimeUs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+//************************ i2c-dev backend ****************************
+
+static int i2cDevOpen(int bus)
 {
-	int file;
 	char filename[40];
-	sprintf(filename, "/dev/i2c-1");
 
-	if ( (file = open(filename, O_RDWR)) < 0)
+	snprintf(filename, sizeof(filename), "/dev/i2c-%d", bus);
+	return open(filename, O_RDWR);
+}
+
+static int i2cDevClose(int handle)
+{
+	return close(handle);
+}
+
+/*
+ * i2cDevXfer:
+ *	Register access as one combined I2C_RDWR transaction (write register
+ *	address, repeated start, read data) instead of a write() / read() syscall
+ *	pair. Falls back to the plain calls on adapters without I2C_FUNC_I2C.
+ */
+static int i2cDevXfer(int handle, int addr, const uint8_t *wr, int wrSize,
+	uint8_t *rd, int rdSize)
+{
+	struct i2c_msg msgs[2];
+	struct i2c_rdwr_ioctl_data data;
+	int n = 0;
+
+	if (wrSize > 0)
+	{
+		msgs[n].addr = addr;
+		msgs[n].flags = 0;
+		msgs[n].len = wrSize;
+		msgs[n].buf = (uint8_t*)wr;
+		n++;
+	}
+	if (rdSize > 0)
+	{
+		msgs[n].addr = addr;
+		msgs[n].flags = I2C_M_RD;
+		msgs[n].len = rdSize;
+		msgs[n].buf = rd;
+		n++;
+	}
+	if (n == 0)
+	{
+		return 0;
+	}
+	data.msgs = msgs;
+	data.nmsgs = n;
+	if (ioctl(handle, I2C_RDWR, &data) == n)
+	{
+		return 0;
+	}
+	if (errno != EOPNOTSUPP && errno != EINVAL)
 	{
-		printf("Failed to open the bus.");
 		return -1;
 	}
-	if (ioctl(file, I2C_SLAVE, addr) < 0)
+	// the fd is shared by all the slaves on the bus, retarget it
+	if (ioctl(handle, I2C_SLAVE, addr) < 0)
 	{
-		printf("Failed to acquire bus access and/or talk to slave.\n");
 		return -1;
 	}
+	if (wrSize > 0 && write(handle, wr, wrSize) != wrSize)
+	{
+		return -1;
+	}
+	if (rdSize > 0 && read(handle, rd, rdSize) != rdSize)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+static int i2cDevBuses(int *list, int max)
+{
+	DIR *dir;
+	struct dirent *ent;
+	int bus;
+	int n = 0;
 
-	return file;
+	dir = opendir("/dev");
+	if (NULL == dir)
+	{
+		return 0;
+	}
+	while (n < max && NULL != (ent = readdir(dir)))
+	{
+		if (1 == sscanf(ent->d_name, "i2c-%d", &bus) && bus >= 0
+			&& bus < COMM_BUS_MAX)
+		{
+			list[n++] = bus;
+		}
+	}
+	closedir(dir);
+	return n;
+}
+
+const CommTransportType COMM_TRANSPORT_I2C =
+	{"i2c", &i2cDevOpen, &i2cDevClose, &i2cDevXfer, &i2cDevBuses};
+
+//************************ Transport selection ****************************
+
+/*
+ * commTransportSet:
+ *	Select the transport backend by name ("i2c", "sim", "replay:<file>").
+ *	Must be called before the first commOpen(); the SMTC_TRANSPORT
+ *	environment variable is used when nobody called it. Setting SMTC_RECORD
+ *	to a file name records all the bus traffic to that file, SMTC_FAULT
+ *	enables the fault injection (see fault.c). The environment knobs are
+ *	read with secure_getenv(): the setuid binary ignores them, they would
+ *	let any user make root write a file or answer from a fake bus.
+ */
+int commTransportSet(const char *spec)
+{
+	const char *env;
+
+	if (NULL == gTransport)
+	{
+		env = secure_getenv("SMTC_RECORD");
+		if (env && *env && 0 != traceRecordOpen(env))
+		{
+			return -1;
+		}
+		if (0 != faultSetup(secure_getenv("SMTC_FAULT")))
+		{
+			return -1;
+		}
+	}
+	if (NULL == spec || 0 == strcmp(spec, COMM_TRANSPORT_I2C.name))
+	{
+		gTransport = &COMM_TRANSPORT_I2C;
+	}
+	else if (0 == strcmp(spec, COMM_TRANSPORT_SIM.name))
+	{
+		gTransport = &COMM_TRANSPORT_SIM;
+	}
+	else if (0 == strncmp(spec, "replay:", 7))
+	{
+		if (0 != traceReplayLoad(spec + 7))
+		{
+			return -1;
+		}
+		gTransport = &COMM_TRANSPORT_REPLAY;
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+const CommTransportType* commTransportGet(void)
+{
+	if (NULL == gTransport)
+	{
+		if (0 != commTransportSet(secure_getenv("SMTC_TRANSPORT")))
+		{
+			gTransport = &COMM_TRANSPORT_I2C;
+		}
+	}
+	return gTransport;
+}
+
+/*
+ * commBusList:
+ *	Numbers of the buses reachable through the selected transport, sorted
+ */
+int commBusList(int *list, int max)
+{
+	const CommTransportType *tr = commTransportGet();
+	int n, i, j, aux;
+
+	if (NULL == list || max <= 0)
+	{
+		return 0;
+	}
+	n = tr->buses(list, max);
+	for (i = 1; i < n; i++)
+	{
+		aux = list[i];
+		for (j = i; j > 0 && list[j - 1] > aux; j--)
+		{
+			list[j] = list[j - 1];
+		}
+		list[j] = aux;
+	}
+	return n;
+}
+
+//************************ Device handles ****************************
+
+static void commBusInit(void)
+{
+	pthread_mutexattr_t attr;
+	int i;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	for (i = 0; i < COMM_BUS_MAX; i++)
+	{
+		pthread_mutex_init(&gBus[i].mutex, &attr);
+	}
+	pthread_mutexattr_destroy(&attr);
+}
+
+/*
+ * commLock:
+ *	Take a bus for the calling thread, nesting allowed. The other threads
+ *	wait on the bus mutex; on the i2c transport the other processes wait on
+ *	the named semaphore shared with the other Sequent Microsystems tools,
+ *	"/SMI2C_SEM" for bus 1 and "/SMI2C_SEM_<bus>" for the others. Every
+ *	transaction takes its bus, hold it longer to keep a sequence of
+ *	transactions together.
+ */
+int commLock(int bus)
+{
+	CommBusType *b;
+	char name[32];
+
+	if (bus < 0 || bus >= COMM_BUS_MAX)
+	{
+		return -1;
+	}
+	pthread_once(&gBusOnce, commBusInit);
+	b = &gBus[bus];
+	pthread_mutex_lock(&b->mutex);
+	if (b->depth++ > 0 || commTransportGet() != &COMM_TRANSPORT_I2C)
+	{
+		return 0;
+	}
+	if (NULL == b->sem)
+	{
+		if (bus == COMM_DEFAULT_BUS)
+		{
+			snprintf(name, sizeof(name), "/SMI2C_SEM");
+		}
+		else
+		{
+			snprintf(name, sizeof(name), "/SMI2C_SEM_%d", bus);
+		}
+		b->sem = sem_open(name, O_CREAT, 0666, 1);
+		if (SEM_FAILED == b->sem)
+		{
+			b->sem = NULL;
+			return 0;
+		}
+	}
+	while (0 != sem_wait(b->sem) && errno == EINTR)
+		;
+	return 0;
+}
+
+int commUnlock(int bus)
+{
+	CommBusType *b;
+
+	if (bus < 0 || bus >= COMM_BUS_MAX || gBus[bus].depth == 0)
+	{
+		return -1;
+	}
+	b = &gBus[bus];
+	if (--b->depth == 0 && NULL != b->sem)
+	{
+		sem_post(b->sem);
+	}
+	pthread_mutex_unlock(&b->mutex);
+	return 0;
+}
+
+/*
+ * commLockAtomic:
+ *	Take a bus for a sequence that must not be interleaved with the other
+ *	threads, as a read-modify-write: unlike commLock() the bus is kept
+ *	during the retry backoff of the transactions.
+ */
+int commLockAtomic(int bus)
+{
+	if (0 != commLock(bus))
+	{
+		return -1;
+	}
+	gBus[bus].atomic++;
+	return 0;
+}
+
+int commUnlockAtomic(int bus)
+{
+	if (bus < 0 || bus >= COMM_BUS_MAX || gBus[bus].atomic == 0)
+	{
+		return -1;
+	}
+	gBus[bus].atomic--;
+	return commUnlock(bus);
+}
+
+/*
+ * commRelease:
+ *	Give up the bus the calling thread holds, whatever its nesting, so the
+ *	other threads use it while this one waits. Returns the nesting for
+ *	commRetake(), 0 if the thread does not hold the bus or holds it for an
+ *	atomic sequence.
+ */
+static int commRelease(int bus)
+{
+	CommBusType *b = &gBus[bus];
+	int depth, i;
+
+	pthread_once(&gBusOnce, commBusInit);
+	if (0 != pthread_mutex_trylock(&b->mutex))
+	{
+		return 0; // another thread holds it
+	}
+	depth = b->atomic > 0 ? 0 : b->depth;
+	pthread_mutex_unlock(&b->mutex);
+	for (i = 0; i < depth; i++)
+	{
+		commUnlock(bus);
+	}
+	return depth;
+}
+
+static void commRetake(int bus, int depth)
+{
+	while (depth-- > 0)
+	{
+		commLock(bus);
+	}
+}
+
+/*
+ * commOpen:
+ *	Open a slave on a bus through the selected transport. Returns a device
+ *	handle > 0 used by the rest of the comm API, or -1. All the slaves on a
+ *	bus share one backend handle, opened with the first of them and closed
+ *	with the last.
+ */
+int commOpen(int bus, int addr)
+{
+	const CommTransportType *tr = commTransportGet();
+	int handle;
+	int i;
+
+	if (bus < 0 || bus >= COMM_BUS_MAX || addr < 0 || addr >= COMM_ADDR_MAX)
+	{
+		return -1;
+	}
+	pthread_once(&gBusOnce, commBusInit);
+	pthread_mutex_lock(&gDevMutex);
+	for (i = 1; i < COMM_DEV_MAX && gDev[i].used; i++)
+		;
+	if (i == COMM_DEV_MAX)
+	{
+		pthread_mutex_unlock(&gDevMutex);
+		return -1;
+	}
+	if (gBus[bus].refs == 0)
+	{
+		handle = tr->open(bus);
+		if (handle < 0)
+		{
+			pthread_mutex_unlock(&gDevMutex);
+			return -1;
+		}
+		gBus[bus].handle = handle;
+	}
+	gBus[bus].refs++;
+	gDev[i].used = 1;
+	gDev[i].bus = bus;
+	gDev[i].addr = addr;
+	gDev[i].handle = gBus[bus].handle;
+	pthread_mutex_unlock(&gDevMutex);
+	return i;
+}
+
+static CommDevType* commDevGet(int dev)
+{
+	if (dev <= 0 || dev >= COMM_DEV_MAX || !gDev[dev].used)
+	{
+		return NULL;
+	}
+	return &gDev[dev];
+}
+
+int commClose(int dev)
+{
+	CommDevType *d = commDevGet(dev);
+	int ret;
+
+	if (NULL == d)
+	{
+		return -1;
+	}
+	ret = 0;
+	pthread_mutex_lock(&gDevMutex);
+	d->used = 0;
+	if (--gBus[d->bus].refs == 0)
+	{
+		ret = gTransport->close(gBus[d->bus].handle);
+	}
+	pthread_mutex_unlock(&gDevMutex);
+	return ret;
+}
+
+static int commBackendXfer(CommDevType *d, const uint8_t *wr, int wrSize,
+	uint8_t *rd, int rdSize)
+{
+	uint64_t start;
+	int ret;
+
+	// the handle is shared with the other slaves on the bus
+	commLock(d->bus);
+	if (!traceRecordActive())
+	{
+		ret = gTransport->xfer(d->handle, d->addr, wr, wrSize, rd, rdSize);
+	}
+	else
+	{
+		start = commTimeUs();
+		ret = gTransport->xfer(d->handle, d->addr, wr, wrSize, rd, rdSize);
+		traceRecord(d->bus, d->addr, start, (uint32_t) (commTimeUs() - start),
+			wr, wrSize, rd, rdSize, ret);
+	}
+	commUnlock(d->bus);
+	return ret;
+}
+
+/*
+ * commHealthUpdate:
+ *	Per slave health score from the exponential averages of the attempt
+ *	error rate and duration: 100 for a card that always answers within
+ *	COMM_LATENCY_REF_US, lower as it fails or slows down. Cards falling below
+ *	COMM_DEMOTE_SCORE move to the slow tier until they recover above
+ *	COMM_PROMOTE_SCORE.
+ */
+static void commHealthUpdate(CommHealthType *h, uint64_t us, int ret)
+{
+	float lat;
+
+	if (h->latencyUs == 0)
+	{
+		h->latencyUs = (float)us;
+	}
+	h->errRate += COMM_HEALTH_ALPHA * ( (ret != 0 ? 1.0f : 0.0f) - h->errRate);
+	h->latencyUs += COMM_HEALTH_ALPHA * ((float)us - h->latencyUs);
+	lat = h->latencyUs > COMM_LATENCY_REF_US ?
+		COMM_LATENCY_REF_US / h->latencyUs : 1.0f;
+	h->score = (int) (100.0f * (1.0f - h->errRate) * lat + 0.5f);
+	if (h->tier == COMM_TIER_FAST && h->score < COMM_DEMOTE_SCORE)
+	{
+		h->tier = COMM_TIER_SLOW;
+	}
+	else if (h->tier == COMM_TIER_SLOW && h->score > COMM_PROMOTE_SCORE)
+	{
+		h->tier = COMM_TIER_FAST;
+	}
+}
+
+static void commStatsUpdate(CommDevType *d, int bytes, uint64_t us, int ret)
+{
+	CommStatsType *st;
+
+	if (d->addr < 0 || d->addr >= COMM_ADDR_MAX)
+	{
+		return;
+	}
+	st = &gStats[d->bus][d->addr];
+	pthread_mutex_lock(&gStatsMutex);
+	st->xfers++;
+	if (ret != 0)
+	{
+		st->errors++;
+	}
+	else
+	{
+		st->bytes += bytes;
+	}
+	st->busyUs += us;
+	if (us > st->maxUs)
+	{
+		st->maxUs = (uint32_t)us;
+	}
+	commHealthUpdate(&gHealth[d->bus][d->addr], us, ret);
+	pthread_mutex_unlock(&gStatsMutex);
+}
+
+/*
+ * commFaultXfer:
+ *	Transaction with the injected faults; the injected delays hold the bus
+ *	like a slow or stuck slave would
+ */
+static int commFaultXfer(CommDevType *d, const uint8_t *wr, int wrSize,
+	uint8_t *rd, int rdSize)
+{
+	int fault;
+	int ret;
+
+	if (!faultActive())
+	{
+		return commBackendXfer(d, wr, wrSize, rd, rdSize);
+	}
+	commLock(d->bus);
+	fault = faultPre(d->bus, d->addr);
+	if (fault == FAULT_NAK || fault == FAULT_STUCK)
+	{
+		ret = -1;
+	}
+	else
+	{
+		ret = commBackendXfer(d, wr, wrSize, rd, rdSize);
+		if (ret == 0 && fault == FAULT_CORRUPT)
+		{
+			faultCorrupt(rd, rdSize);
+		}
+	}
+	commUnlock(d->bus);
+	return ret;
+}
+
+static int commAttempt(CommDevType *d, const uint8_t *wr, int wrSize,
+	uint8_t *rd, int rdSize)
+{
+	uint64_t start;
+	int ret;
+
+	start = commTimeUs();
+	ret = commFaultXfer(d, wr, wrSize, rd, rdSize);
+	commStatsUpdate(d, wrSize + rdSize, commTimeUs() - start, ret);
+	return ret;
+}
+
+/*
+ * commTier:
+ *	Health tier of a slave, updated by the threads of the other buses
+ */
+static int commTier(int bus, int addr)
+{
+	int tier;
+
+	pthread_mutex_lock(&gStatsMutex);
+	tier = gHealth[bus][addr].tier;
+	pthread_mutex_unlock(&gStatsMutex);
+	return tier;
+}
+
+static void commBackoff(int attempt)
+{
+	struct timespec ts;
+	long us = COMM_BACKOFF_MIN_US;
+
+	while (--attempt > 0 && us < COMM_BACKOFF_MAX_US)
+	{
+		us *= 2;
+	}
+	if (us > COMM_BACKOFF_MAX_US)
+	{
+		us = COMM_BACKOFF_MAX_US;
+	}
+	ts.tv_sec = 0;
+	ts.tv_nsec = us * 1000;
+	nanosleep(&ts, NULL);
+}
+
+/*
+ * commXfer:
+ *	One transaction, retried up to RETRY_TIMES times (SMTC_RETRY overrides)
+ *	with exponential backoff. Cards in the slow tier get a single attempt
+ *	so a failing card cannot hold the bus for the others, and the bus held
+ *	by the caller is released during the backoff.
+ */
+int commXfer(int dev, const uint8_t *wr, int wrSize, uint8_t *rd, int rdSize)
+{
+	CommDevType *d = commDevGet(dev);
+	const char *env;
+	int attempts = 1;
+	int ret, i, depth;
+
+	if (NULL == d || wrSize < 0 || rdSize < 0 || wrSize > COMM_XFER_MAX
+		|| rdSize > COMM_XFER_MAX || (rdSize > 0 && NULL == rd))
+	{
+		return -1;
+	}
+	if (gRetryTimes < 0)
+	{
+		env = secure_getenv("SMTC_RETRY");
+		gRetryTimes = env ? atoi(env) : RETRY_TIMES;
+	}
+	if (d->addr < COMM_ADDR_MAX && commTier(d->bus, d->addr) == COMM_TIER_FAST)
+	{
+		attempts += gRetryTimes > 0 ? gRetryTimes : 0;
+	}
+	ret = commAttempt(d, wr, wrSize, rd, rdSize);
+	for (i = 1; ret != 0 && i < attempts; i++)
+	{
+		depth = commRelease(d->bus);
+		commBackoff(i);
+		commRetake(d->bus, depth);
+		pthread_mutex_lock(&gStatsMutex);
+		gStats[d->bus][d->addr].retries++;
+		pthread_mutex_unlock(&gStatsMutex);
+		ret = commAttempt(d, wr, wrSize, rd, rdSize);
+	}
+	return ret;
+}
+
+/*
+ * commProbe:
+ *	Single attempt transaction for presence checks: no retries, and a
+ *	missing card neither counts as an error nor loses health.
+ */
+int commProbe(int dev, const uint8_t *wr, int wrSize, uint8_t *rd, int rdSize)
+{
+	CommDevType *d = commDevGet(dev);
+
+	if (NULL == d || wrSize < 0 || rdSize < 0 || wrSize > COMM_XFER_MAX
+		|| rdSize > COMM_XFER_MAX || (rdSize > 0 && NULL == rd))
+	{
+		return -1;
+	}
+	return commFaultXfer(d, wr, wrSize, rd, rdSize);
+}
+
+/*
+ * commStatsGet:
+ *	Transaction counters for one slave since the start of the process
+ */
+int commStatsGet(int bus, int addr, CommStatsType *stats)
+{
+	if (bus < 0 || bus >= COMM_BUS_MAX || addr < 0 || addr >= COMM_ADDR_MAX
+		|| NULL == stats)
+	{
+		return -1;
+	}
+	pthread_mutex_lock(&gStatsMutex);
+	*stats = gStats[bus][addr];
+	pthread_mutex_unlock(&gStatsMutex);
+	return 0;
+}
+
+int commHealthGet(int bus, int addr, CommHealthType *health)
+{
+	if (bus < 0 || bus >= COMM_BUS_MAX || addr < 0 || addr >= COMM_ADDR_MAX
+		|| NULL == health)
+	{
+		return -1;
+	}
+	pthread_mutex_lock(&gStatsMutex);
+	*health = gHealth[bus][addr];
+	if (health->latencyUs == 0)
+	{
+		health->score = 100;
+	}
+	pthread_mutex_unlock(&gStatsMutex);
+	return 0;
+}
+
+/*
+ * commPollDue:
+ *	Tells a poller whether a slave should be read in polling round "round":
+ *	every round for the fast tier, every COMM_SLOW_TIER_DIV rounds for the
+ *	slow tier.
+ */
+int commPollDue(int bus, int addr, uint32_t round)
+{
+	if (bus < 0 || bus >= COMM_BUS_MAX || addr < 0 || addr >= COMM_ADDR_MAX)
+	{
+		return 1;
+	}
+	if (commTier(bus, addr) == COMM_TIER_SLOW)
+	{
+		return (round % COMM_SLOW_TIER_DIV) == 0;
+	}
+	return 1;
+}
+
+int i2cSetup(int bus, int addr)
+{
+	int dev;
+
+	dev = commOpen(bus, addr);
+	if (dev < 0)
+	{
+		printf("Failed to open the bus and/or talk to slave.\n");
+		return -1;
+	}
+	return dev;
 }
 
 int i2cMem8Read(int dev, int add, uint8_t* buff, int size)
@@ -77,17 +798,24 @@ int i2cMem8Read(int dev, int add, uint8_t* buff, int size)
 
 	intBuff[0] = 0xff & add;
 
-	if (write(dev, intBuff, 1) != 1)
+	if (0 != commXfer(dev, intBuff, 1, buff, size))
 	{
-		//printf("Fail to select mem add!\n");
+		//printf("Fail to read memory!\n");
 		return -1;
 	}
-	if (read(dev, buff, size) != size)
+	return 0; //OK
+}
+
+int i2cMem8Probe(int dev, int add, uint8_t* buff, int size)
+{
+	uint8_t intBuff[1];
+
+	if (NULL == buff || size > I2C_SMBUS_BLOCK_MAX)
 	{
-		//printf("Fail to read memory!\n");
 		return -1;
 	}
-	return 0; //OK
+	intBuff[0] = 0xff & add;
+	return commProbe(dev, intBuff, 1, buff, size);
 }
 
 int i2cMem8Write(int dev, int add, uint8_t* buff, int size)
@@ -107,13 +835,10 @@ int i2cMem8Write(int dev, int add, uint8_t* buff, int size)
 	intBuff[0] = 0xff & add;
 	memcpy(&intBuff[1], buff, size);
 
-	if (write(dev, intBuff, size + 1) != size + 1)
+	if (0 != commXfer(dev, intBuff, size + 1, NULL, 0))
 	{
 		//printf("Fail to write memory!\n");
 		return -1;
 	}
 	return 0;
 }
-
-
-
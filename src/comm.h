@@ -3,9 +3,78 @@
 
 #include <stdint.h>
 
-int i2cSetup(int addr);
+#define COMM_DEFAULT_BUS	1
+#define COMM_BUS_MAX		32
+#define COMM_DEV_MAX		256
+#define COMM_XFER_MAX		32
+#define COMM_ADDR_MAX		128
+#define COMM_SLOW_TIER_DIV	8
+
+enum
+{
+	COMM_TIER_FAST = 0,
+	COMM_TIER_SLOW
+};
+
+/*
+ * Transport backend: moves raw bytes to and from the slaves on one bus. One
+ * backend handle serves every slave on its bus, "xfer" addresses the slave.
+ * "xfer" is the only data primitive, a write of wrSize bytes followed
+ * (repeated start) by a read of rdSize bytes; either part may be empty.
+ * "buses" fills the numbers of the buses the backend can reach.
+ */
+typedef struct
+{
+	const char *name;
+	int (*open)(int bus); // returns backend handle >= 0 or -1
+	int (*close)(int handle);
+	int (*xfer)(int handle, int addr, const uint8_t *wr, int wrSize,
+		uint8_t *rd, int rdSize);
+	int (*buses)(int *list, int max); // returns the number of buses
+} CommTransportType;
+
+typedef struct
+{
+	uint32_t xfers;
+	uint32_t errors;
+	uint64_t bytes;
+	uint64_t busyUs;
+	uint32_t maxUs;
+	uint32_t retries;
+} CommStatsType;
+
+typedef struct
+{
+	int score; // 0..100
+	int tier;
+	float errRate;
+	float latencyUs;
+} CommHealthType;
+
+extern const CommTransportType COMM_TRANSPORT_I2C;
+extern const CommTransportType COMM_TRANSPORT_SIM;
+
+int commTransportSet(const char *spec);
+const CommTransportType* commTransportGet(void);
+
+int commOpen(int bus, int addr);
+int commClose(int dev);
+int commXfer(int dev, const uint8_t *wr, int wrSize, uint8_t *rd, int rdSize);
+int commProbe(int dev, const uint8_t *wr, int wrSize, uint8_t *rd, int rdSize);
+int commBusList(int *list, int max);
+int commLock(int bus);
+int commUnlock(int bus);
+int commLockAtomic(int bus);
+int commUnlockAtomic(int bus);
+int commStatsGet(int bus, int addr, CommStatsType *stats);
+int commHealthGet(int bus, int addr, CommHealthType *health);
+int commPollDue(int bus, int addr, uint32_t round);
+uint64_t commTimeUs(void);
+
+int i2cSetup(int bus, int addr);
 int i2cMem8Read(int dev, int add, uint8_t* buff, int size);
 int i2cMem8Write(int dev, int add, uint8_t* buff, int size);
+int i2cMem8Probe(int dev, int add, uint8_t* buff, int size);
 
 
 #endif //COMM_H_
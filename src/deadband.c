@@ -0,0 +1,146 @@
+/*
+ * deadband.c:
+ *	Change driven reporting: a channel value is reported only when it moved
+ *	away from the last reported value by more than the deadband, or when
+ *	nothing was reported for the heartbeat interval
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "deadband.h"
+
+int deadbandActive(const DeadbandCfgType *cfg)
+{
+	return cfg->abs > 0 || cfg->pctX10 > 0 || cfg->heartbeatMs > 0;
+}
+
+/*
+ * deadbandPass:
+ *	Tells if a new value has to be reported. With both an absolute and a
+ *	percent deadband the larger of the two applies, so the absolute one is
+ *	the floor for values close to zero. With a heartbeat but no deadband
+ *	only the unchanged values are suppressed.
+ */
+int deadbandPass(const DeadbandCfgType *cfg, const DeadbandStateType *st,
+	int16_t val, uint64_t tUs)
+{
+	int32_t diff, band, pct;
+
+	if (!st->valid)
+	{
+		return 1;
+	}
+	if (cfg->heartbeatMs > 0
+		&& tUs - st->lastUs >= (uint64_t)cfg->heartbeatMs * 1000)
+	{
+		return 1;
+	}
+	if (cfg->abs <= 0 && cfg->pctX10 <= 0)
+	{
+		return cfg->heartbeatMs == 0 || val != st->last;
+	}
+	diff = (int32_t)val - st->last;
+	if (diff < 0)
+	{
+		diff = -diff;
+	}
+	band = cfg->abs;
+	pct = (st->last < 0 ? -(int32_t)st->last : st->last) * cfg->pctX10 / 1000;
+	if (pct > band)
+	{
+		band = pct;
+	}
+	return diff > band;
+}
+
+/*
+ * deadbandUpdate:
+ *	Account a value, reported or suppressed
+ */
+void deadbandUpdate(DeadbandStateType *st, int16_t val, uint64_t tUs,
+	int reported)
+{
+	if (reported)
+	{
+		st->valid = 1;
+		st->last = val;
+		st->lastUs = tUs;
+		st->reported++;
+	}
+	else
+	{
+		st->suppressed++;
+	}
+}
+
+static int deadbandValue(const char *s, DeadbandCfgType *cfg, int scale)
+{
+	char *end;
+	double v;
+
+	v = strtod(s, &end);
+	if (end == s || v < 0)
+	{
+		return -1;
+	}
+	if (*end == '%' && end[1] == 0)
+	{
+		cfg->pctX10 = (int) (v * 10 + 0.5);
+	}
+	else if (*end == 0)
+	{
+		cfg->abs = (int) (v * scale + 0.5);
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * deadbandParse:
+ *	"<value>[%]" sets the deadband of every channel, "<ch>:<value>[%],..."
+ *	the one of some channels (1 based). Absolute values are in engineering
+ *	units, "scale" raw units each. Returns 0 or -1 for a bad spec.
+ */
+int deadbandParse(const char *spec, DeadbandCfgType *cfg, int channels,
+	int scale)
+{
+	char buff[128];
+	char *tok, *save, *p;
+	int ch, i;
+
+	if (NULL == strchr(spec, ':'))
+	{
+		for (i = 0; i < channels; i++)
+		{
+			if (0 != deadbandValue(spec, &cfg[i], scale))
+			{
+				return -1;
+			}
+		}
+		return 0;
+	}
+	snprintf(buff, sizeof(buff), "%s", spec);
+	for (tok = strtok_r(buff, ",", &save); tok != NULL;
+		tok = strtok_r(NULL, ",", &save))
+	{
+		p = strchr(tok, ':');
+		ch = atoi(tok);
+		if (NULL == p || ch < 1 || ch > channels
+			|| 0 != deadbandValue(p + 1, &cfg[ch - 1], scale))
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
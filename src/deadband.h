@@ -0,0 +1,30 @@
+#ifndef DEADBAND_H_
+#define DEADBAND_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+	int abs; // raw units, 0 - off
+	int pctX10; // percent of the last reported value x10, 0 - off
+	uint32_t heartbeatMs; // report at least this often, 0 - off
+} DeadbandCfgType;
+
+typedef struct
+{
+	int valid;
+	int16_t last;
+	uint64_t lastUs;
+	uint32_t reported;
+	uint32_t suppressed;
+} DeadbandStateType;
+
+int deadbandActive(const DeadbandCfgType *cfg);
+int deadbandPass(const DeadbandCfgType *cfg, const DeadbandStateType *st,
+	int16_t val, uint64_t tUs);
+void deadbandUpdate(DeadbandStateType *st, int16_t val, uint64_t tUs,
+	int reported);
+int deadbandParse(const char *spec, DeadbandCfgType *cfg, int channels,
+	int scale);
+
+#endif //DEADBAND_H_
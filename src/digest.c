@@ -0,0 +1,286 @@
+/*
+ * digest.c:
+ *	Streaming quantiles in constant memory: a merging t-digest (Dunning)
+ *	keeps the distribution of any number of values in a bounded set of
+ *	centroids, finer at the tails where p95/p99 are read. Digests merge
+ *	into one another, so quantiles over several windows, cards or threads
+ *	come from merging their digests instead of sorting the values.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "digest.h"
+
+// new centroids of one compression: a full buffer, or the centroids and
+// the buffer of a digest merged into one with an empty buffer
+#define DIGEST_ADD_MAX		(DIGEST_CENTROIDS_MAX + DIGEST_BUFFER)
+#define DIGEST_MERGE_MAX	(DIGEST_CENTROIDS_MAX + DIGEST_ADD_MAX)
+
+/*
+ * digestK:
+ *	Scale function k1, a centroid spans at most one unit of k, which
+ *	makes the centroids small close to q 0 and 1
+ */
+static double digestK(double q)
+{
+	return DIGEST_COMPRESSION / (2 * M_PI) * asin(2 * q - 1);
+}
+
+static double digestKInv(double k)
+{
+	if (k >= DIGEST_COMPRESSION / 4.0)
+	{
+		return 1;
+	}
+	return (sin(k * 2 * M_PI / DIGEST_COMPRESSION) + 1) / 2;
+}
+
+static int digestCmp(const void *a, const void *b)
+{
+	float x = ( (const DigestCentroidType*)a)->mean;
+	float y = ( (const DigestCentroidType*)b)->mean;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * digestCompress:
+ *	Merge the centroids with the buffered values and "n" more centroids:
+ *	only the new ones are sorted, the centroids are already in order. The
+ *	buffered values and "n" together are at most DIGEST_ADD_MAX.
+ */
+static void digestCompress(DigestType *d, const DigestCentroidType *in, int n)
+{
+	DigestCentroidType add[DIGEST_ADD_MAX];
+	DigestCentroidType all[DIGEST_MERGE_MAX];
+	DigestCentroidType cur;
+	double total = 0, done = 0, limit;
+	int cnt = 0, na = 0;
+	int i, j;
+
+	for (i = 0; i < d->buffered; i++)
+	{
+		add[na].mean = d->buf[i];
+		add[na++].weight = 1;
+	}
+	for (i = 0; i < n; i++)
+	{
+		add[na++] = in[i];
+	}
+	d->buffered = 0;
+	if (na == 0)
+	{
+		return;
+	}
+	qsort(add, na, sizeof(DigestCentroidType), &digestCmp);
+	for (i = 0, j = 0; i < d->centroids || j < na;)
+	{
+		if (j == na || (i < d->centroids && d->c[i].mean <= add[j].mean))
+		{
+			all[cnt] = d->c[i++];
+		}
+		else
+		{
+			all[cnt] = add[j++];
+		}
+		total += all[cnt++].weight;
+	}
+	d->centroids = 0;
+	cur = all[0];
+	limit = total * digestKInv(digestK(0) + 1);
+	for (i = 1; i < cnt; i++)
+	{
+		if (done + cur.weight + all[i].weight <= limit
+			|| d->centroids == DIGEST_CENTROIDS_MAX - 1)
+		{
+			cur.weight += all[i].weight;
+			cur.mean += (all[i].mean - cur.mean) * all[i].weight / cur.weight;
+			continue;
+		}
+		d->c[d->centroids++] = cur;
+		done += cur.weight;
+		limit = total * digestKInv(digestK(done / total) + 1);
+		cur = all[i];
+	}
+	d->c[d->centroids++] = cur;
+}
+
+void digestInit(DigestType *d)
+{
+	d->count = 0;
+	d->min = 0;
+	d->max = 0;
+	d->centroids = 0;
+	d->buffered = 0;
+}
+
+void digestAdd(DigestType *d, float v)
+{
+	if (d->count == 0 || v < d->min)
+	{
+		d->min = v;
+	}
+	if (d->count == 0 || v > d->max)
+	{
+		d->max = v;
+	}
+	d->count++;
+	d->buf[d->buffered++] = v;
+	if (d->buffered == DIGEST_BUFFER)
+	{
+		digestCompress(d, NULL, 0);
+	}
+}
+
+/*
+ * digestMerge:
+ *	Add the values of "src" to "dst"
+ */
+void digestMerge(DigestType *dst, const DigestType *src)
+{
+	DigestCentroidType in[DIGEST_ADD_MAX];
+	int n = 0;
+	int i;
+
+	if (src->count == 0)
+	{
+		return;
+	}
+	if (dst->buffered > 0)
+	{
+		digestCompress(dst, NULL, 0); // room for all of src
+	}
+	if (dst->count == 0 || src->min < dst->min)
+	{
+		dst->min = src->min;
+	}
+	if (dst->count == 0 || src->max > dst->max)
+	{
+		dst->max = src->max;
+	}
+	dst->count += src->count;
+	for (i = 0; i < src->centroids; i++)
+	{
+		in[n++] = src->c[i];
+	}
+	for (i = 0; i < src->buffered; i++)
+	{
+		in[n].mean = src->buf[i];
+		in[n++].weight = 1;
+	}
+	digestCompress(dst, in, n);
+}
+
+/*
+ * digestQuantile:
+ *	Value at quantile q (0..1), interpolated between the centroid centers
+ *	and the extremes. 0 for an empty digest.
+ */
+float digestQuantile(DigestType *d, double q)
+{
+	const DigestCentroidType *c = d->c;
+	double target, cum = 0, left, right;
+	int i;
+
+	if (d->buffered > 0)
+	{
+		digestCompress(d, NULL, 0);
+	}
+	if (d->centroids == 0)
+	{
+		return 0;
+	}
+	target = q * d->count;
+	if (target <= c[0].weight / 2)
+	{
+		return d->min + (float) ( (c[0].mean - d->min) * target * 2 / c[0].weight);
+	}
+	for (i = 0; i < d->centroids - 1; i++)
+	{
+		left = cum + c[i].weight / 2;
+		right = cum + c[i].weight + c[i + 1].weight / 2;
+		if (target <= right)
+		{
+			return c[i].mean + (float) ( (c[i + 1].mean - c[i].mean)
+				* (target - left) / (right - left));
+		}
+		cum += c[i].weight;
+	}
+	left = d->count - c[i].weight / 2;
+	if (target >= d->count)
+	{
+		return d->max;
+	}
+	return c[i].mean + (float) ( (d->max - c[i].mean) * (target - left)
+		/ (d->count - left));
+}
+
+void digestWindowInit(DigestWindowType *w, uint64_t windowUs)
+{
+	int i;
+
+	w->sliceUs = windowUs / DIGEST_SLICES;
+	if (w->sliceUs == 0)
+	{
+		w->sliceUs = 1;
+	}
+	w->startUs = 0;
+	w->cur = 0;
+	for (i = 0; i < DIGEST_SLICES; i++)
+	{
+		digestInit(&w->slice[i]);
+	}
+}
+
+/*
+ * digestWindowAdd:
+ *	Add a value taken at tUs, the slices older than the window are
+ *	dropped first. Returns 1 when a slice was completed.
+ */
+int digestWindowAdd(DigestWindowType *w, float v, uint64_t tUs)
+{
+	int done = 0;
+	int i;
+
+	if (w->startUs == 0)
+	{
+		w->startUs = tUs;
+	}
+	for (i = 0; tUs - w->startUs >= w->sliceUs && i < DIGEST_SLICES; i++)
+	{
+		w->cur = (w->cur + 1) % DIGEST_SLICES;
+		digestInit(&w->slice[w->cur]);
+		w->startUs += w->sliceUs;
+		done = 1;
+	}
+	if (tUs - w->startUs >= w->sliceUs)
+	{
+		w->startUs = tUs; // idle for more than the window
+	}
+	digestAdd(&w->slice[w->cur], v);
+	return done;
+}
+
+/*
+ * digestWindowGet:
+ *	The digest of the whole window
+ */
+void digestWindowGet(const DigestWindowType *w, DigestType *d)
+{
+	int i;
+
+	digestInit(d);
+	for (i = 0; i < DIGEST_SLICES; i++)
+	{
+		digestMerge(d, &w->slice[i]);
+	}
+}
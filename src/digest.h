@@ -0,0 +1,53 @@
+#ifndef DIGEST_H_
+#define DIGEST_H_
+
+#include <stdint.h>
+
+#define DIGEST_COMPRESSION	100 // about 1% of the tails, less in the middle
+#define DIGEST_CENTROIDS_MAX	DIGEST_COMPRESSION
+#define DIGEST_BUFFER		256
+#define DIGEST_SLICES		6
+
+typedef struct
+{
+	float mean;
+	float weight;
+} DigestCentroidType;
+
+/*
+ * Merging t-digest: a bounded set of centroids, small ones at the tails,
+ * large ones in the middle. Values are buffered and merged in batches.
+ */
+typedef struct
+{
+	double count;
+	float min;
+	float max;
+	int centroids;
+	int buffered;
+	DigestCentroidType c[DIGEST_CENTROIDS_MAX];
+	float buf[DIGEST_BUFFER];
+} DigestType;
+
+/*
+ * Rolling window of DIGEST_SLICES digests, each one sliceUs long: the
+ * window holds the last full slices and the current one
+ */
+typedef struct
+{
+	uint64_t sliceUs;
+	uint64_t startUs; // of the current slice, 0 - nothing added yet
+	int cur;
+	DigestType slice[DIGEST_SLICES];
+} DigestWindowType;
+
+void digestInit(DigestType *d);
+void digestAdd(DigestType *d, float v);
+void digestMerge(DigestType *dst, const DigestType *src);
+float digestQuantile(DigestType *d, double q);
+
+void digestWindowInit(DigestWindowType *w, uint64_t windowUs);
+int digestWindowAdd(DigestWindowType *w, float v, uint64_t tUs);
+void digestWindowGet(const DigestWindowType *w, DigestType *d);
+
+#endif //DIGEST_H_
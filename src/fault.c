@@ -0,0 +1,223 @@
+/*
+ * fault.c:
+ *	Fault injection on the bus transactions, used to measure how the
+ *	acquisition degrades with a noisy bus and to tune the retry policy
+ *
+ *	Configured with SMTC_FAULT, a comma separated list of:
+ *	  nak=<p>          probability of a failed transaction
+ *	  stuck=<p>:<ms>   probability the bus locks up for <ms> milliseconds
+ *	  latency=<us>     fixed latency added to every transaction
+ *	  jitter=<us>      random latency in [0, jitter] added on top
+ *	  corrupt=<p>      probability of one flipped bit in the read data
+ *	  bus=<n>          only inject on this bus
+ *	  addr=<a>[/<a>]   only inject on these slave addresses
+ *	  seed=<n>         random seed, for reproducible runs
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "comm.h"
+#include "fault.h"
+
+#define FAULT_ADDR_MAX	128
+
+typedef struct
+{
+	int active;
+	double nak;
+	double stuck;
+	int stuckMs;
+	int latencyUs;
+	int jitterUs;
+	double corrupt;
+	int bus;
+	int addrFilter;
+	uint8_t addr[FAULT_ADDR_MAX];
+	unsigned int seed;
+	uint64_t stuckUntilUs[COMM_BUS_MAX];
+} FaultCfgType;
+
+static FaultCfgType gFault;
+static FaultStatsType gFaultStats;
+static pthread_mutex_t gFaultMutex = PTHREAD_MUTEX_INITIALIZER;
+
+int faultSetup(const char *spec)
+{
+	char buff[256];
+	char *tok, *save, *addrSave, *val, *p;
+	int a;
+
+	memset(&gFault, 0, sizeof(gFault));
+	memset(&gFaultStats, 0, sizeof(gFaultStats));
+	gFault.bus = -1;
+	gFault.seed = (unsigned int)time(NULL);
+	if (NULL == spec || 0 == *spec)
+	{
+		return 0;
+	}
+	strncpy(buff, spec, sizeof(buff) - 1);
+	buff[sizeof(buff) - 1] = 0;
+	for (tok = strtok_r(buff, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+	{
+		val = strchr(tok, '=');
+		if (NULL == val)
+		{
+			return -1;
+		}
+		*val++ = 0;
+		if (0 == strcmp(tok, "nak"))
+		{
+			gFault.nak = atof(val);
+		}
+		else if (0 == strcmp(tok, "stuck"))
+		{
+			gFault.stuck = atof(val);
+			p = strchr(val, ':');
+			gFault.stuckMs = p ? atoi(p + 1) : 100;
+		}
+		else if (0 == strcmp(tok, "latency"))
+		{
+			gFault.latencyUs = atoi(val);
+		}
+		else if (0 == strcmp(tok, "jitter"))
+		{
+			gFault.jitterUs = atoi(val);
+		}
+		else if (0 == strcmp(tok, "corrupt"))
+		{
+			gFault.corrupt = atof(val);
+		}
+		else if (0 == strcmp(tok, "bus"))
+		{
+			gFault.bus = atoi(val);
+		}
+		else if (0 == strcmp(tok, "addr"))
+		{
+			gFault.addrFilter = 1;
+			for (p = strtok_r(val, "/", &addrSave); p;
+				p = strtok_r(NULL, "/", &addrSave))
+			{
+				a = (int)strtol(p, NULL, 0);
+				if (a >= 0 && a < FAULT_ADDR_MAX)
+				{
+					gFault.addr[a] = 1;
+				}
+			}
+		}
+		else if (0 == strcmp(tok, "seed"))
+		{
+			gFault.seed = (unsigned int)strtoul(val, NULL, 0);
+		}
+		else
+		{
+			return -1;
+		}
+	}
+	gFault.active = 1;
+	return 0;
+}
+
+int faultActive(void)
+{
+	return gFault.active;
+}
+
+static double faultRand(void)
+{
+	return (double)rand_r(&gFault.seed) / ((double)RAND_MAX + 1);
+}
+
+static void faultSleep(uint64_t us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (long)(us % 1000000) * 1000;
+	nanosleep(&ts, NULL);
+}
+
+/*
+ * faultPre:
+ *	Called before every transaction, with the bus held. Spends the injected
+ *	latency and returns the fault to apply to this transaction (FAULT_NONE,
+ *	FAULT_NAK, FAULT_STUCK: fail without touching the bus once the stuck
+ *	time is over, FAULT_CORRUPT: do the transaction then corrupt the data
+ *	with faultCorrupt()).
+ */
+int faultPre(int bus, int addr)
+{
+	uint64_t delay, now;
+	int fault = FAULT_NONE;
+
+	if (!gFault.active || (gFault.bus >= 0 && bus != gFault.bus)
+		|| (gFault.addrFilter
+			&& (addr < 0 || addr >= FAULT_ADDR_MAX || !gFault.addr[addr])))
+	{
+		return FAULT_NONE;
+	}
+	pthread_mutex_lock(&gFaultMutex);
+	delay = gFault.latencyUs;
+	if (gFault.jitterUs > 0)
+	{
+		delay += (uint64_t) (faultRand() * gFault.jitterUs);
+	}
+	now = commTimeUs();
+	if (now >= gFault.stuckUntilUs[bus] && gFault.stuck > 0
+		&& faultRand() < gFault.stuck)
+	{
+		gFault.stuckUntilUs[bus] = now + (uint64_t)gFault.stuckMs * 1000;
+	}
+	if (now < gFault.stuckUntilUs[bus])
+	{
+		// the slave holds the bus until it lets go
+		delay += gFault.stuckUntilUs[bus] - now;
+		fault = FAULT_STUCK;
+	}
+	else if (gFault.nak > 0 && faultRand() < gFault.nak)
+	{
+		fault = FAULT_NAK;
+	}
+	else if (gFault.corrupt > 0 && faultRand() < gFault.corrupt)
+	{
+		fault = FAULT_CORRUPT;
+	}
+	gFaultStats.injected[fault]++;
+	gFaultStats.delayUs += delay;
+	pthread_mutex_unlock(&gFaultMutex);
+	if (delay > 0)
+	{
+		faultSleep(delay);
+	}
+	return fault;
+}
+
+void faultCorrupt(uint8_t *buff, int size)
+{
+	int bit;
+
+	if (size <= 0)
+	{
+		return;
+	}
+	pthread_mutex_lock(&gFaultMutex);
+	bit = (int) (faultRand() * size * 8);
+	pthread_mutex_unlock(&gFaultMutex);
+	buff[bit / 8] ^= 1 << (bit % 8);
+}
+
+void faultStatsGet(FaultStatsType *stats)
+{
+	pthread_mutex_lock(&gFaultMutex);
+	*stats = gFaultStats;
+	pthread_mutex_unlock(&gFaultMutex);
+}
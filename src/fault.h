@@ -0,0 +1,27 @@
+#ifndef FAULT_H_
+#define FAULT_H_
+
+#include <stdint.h>
+
+enum
+{
+	FAULT_NONE = 0,
+	FAULT_NAK,
+	FAULT_STUCK,
+	FAULT_CORRUPT,
+	FAULT_COUNT
+};
+
+typedef struct
+{
+	uint32_t injected[FAULT_COUNT];
+	uint64_t delayUs;
+} FaultStatsType;
+
+int faultSetup(const char *spec);
+int faultActive(void);
+int faultPre(int bus, int addr);
+void faultCorrupt(uint8_t *buff, int size);
+void faultStatsGet(FaultStatsType *stats);
+
+#endif //FAULT_H_
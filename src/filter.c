@@ -0,0 +1,216 @@
+/*
+ * filter.c:
+ *	Host filters on the temperatures, next to the moving average of the
+ *	card: median of 3 or 5 reads to drop the spikes, exponential moving
+ *	average and a one state Kalman filter. Each card is filtered as one
+ *	vector of channels; the settings per channel are coefficients of the
+ *	lanes, an unused stage of a channel has neutral coefficients instead
+ *	of a branch, so the cost is the same whatever the mix.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "filter.h"
+
+#define FILTER_MIN(a, b)	( (a) < (b) ? (a) : (b))
+#define FILTER_MAX(a, b)	( (a) < (b) ? (b) : (a))
+#define FILTER_SORT(a, b)	do { float t_ = FILTER_MIN(a, b); b = FILTER_MAX(a, b); a = t_; } while (0)
+
+void filterInit(FilterCfgType *cfg)
+{
+	cfg->median = 1;
+	cfg->alpha = 1;
+	cfg->q = 0;
+	cfg->r = 0;
+}
+
+int filterActive(const FilterCfgType *cfg)
+{
+	return cfg->median > 1 || cfg->alpha < 1 || cfg->q > 0;
+}
+
+/*
+ * filterLanes:
+ *	Lane coefficients from the channel settings. A channel without Kalman
+ *	gets q 1 and r 0: the gain is 1 and the estimate is the input.
+ */
+void filterLanes(FilterLanesType *lanes, const FilterCfgType cfg[FILTER_LANES])
+{
+	int ch;
+
+	for (ch = 0; ch < FILTER_LANES; ch++)
+	{
+		lanes->med3[ch] = cfg[ch].median == 3;
+		lanes->med5[ch] = cfg[ch].median == 5;
+		lanes->alpha[ch] = cfg[ch].alpha;
+		lanes->q[ch] = cfg[ch].q > 0 ? cfg[ch].q : 1;
+		lanes->r[ch] = cfg[ch].q > 0 ? cfg[ch].r : 0;
+	}
+}
+
+/*
+ * filterApply:
+ *	Filter the raw values of one read of a card in place. The first read
+ *	fills the state, so the filters start settled on it.
+ */
+void filterApply(const FilterLanesType *lanes, FilterStateType *st,
+	int16_t raw[FILTER_LANES])
+{
+	float z[FILTER_LANES];
+	float a, b, c, d, e, m3, m5, p, k;
+	int p1, p2, p3, p4;
+	int ch, i;
+
+	for (ch = 0; ch < FILTER_LANES; ch++)
+	{
+		z[ch] = raw[ch];
+	}
+	if (!st->valid)
+	{
+		for (i = 0; i < FILTER_MEDIAN_MAX; i++)
+		{
+			memcpy(st->win[i], z, sizeof(z));
+		}
+		memcpy(st->ema, z, sizeof(z));
+		memcpy(st->x, z, sizeof(z));
+		memcpy(st->p, lanes->r, sizeof(st->p));
+		st->pos = 0;
+		st->valid = 1;
+	}
+	st->pos = (st->pos + 1) % FILTER_MEDIAN_MAX;
+	memcpy(st->win[st->pos], z, sizeof(z));
+	p1 = (st->pos + FILTER_MEDIAN_MAX - 1) % FILTER_MEDIAN_MAX;
+	p2 = (st->pos + FILTER_MEDIAN_MAX - 2) % FILTER_MEDIAN_MAX;
+	p3 = (st->pos + FILTER_MEDIAN_MAX - 3) % FILTER_MEDIAN_MAX;
+	p4 = (st->pos + FILTER_MEDIAN_MAX - 4) % FILTER_MEDIAN_MAX;
+
+	for (ch = 0; ch < FILTER_LANES; ch++)
+	{
+		a = st->win[st->pos][ch];
+		b = st->win[p1][ch];
+		c = st->win[p2][ch];
+		d = st->win[p3][ch];
+		e = st->win[p4][ch];
+		m3 = FILTER_MAX(FILTER_MIN(a, b), FILTER_MIN(FILTER_MAX(a, b), c));
+		// sorting network of 5, the median ends in the middle
+		FILTER_SORT(a, b);
+		FILTER_SORT(d, e);
+		FILTER_SORT(c, e);
+		FILTER_SORT(c, d);
+		FILTER_SORT(b, e);
+		FILTER_SORT(a, d);
+		FILTER_SORT(a, c);
+		FILTER_SORT(b, d);
+		FILTER_SORT(b, c);
+		m5 = c;
+		z[ch] = lanes->med5[ch] * m5 + lanes->med3[ch] * m3
+			+ (1 - lanes->med3[ch] - lanes->med5[ch]) * z[ch];
+	}
+	for (ch = 0; ch < FILTER_LANES; ch++)
+	{
+		st->ema[ch] += lanes->alpha[ch] * (z[ch] - st->ema[ch]);
+		z[ch] = st->ema[ch];
+	}
+	for (ch = 0; ch < FILTER_LANES; ch++)
+	{
+		p = st->p[ch] + lanes->q[ch];
+		k = p / (p + lanes->r[ch]);
+		st->x[ch] += k * (z[ch] - st->x[ch]);
+		st->p[ch] = (1 - k) * p;
+		z[ch] = st->x[ch];
+	}
+	for (ch = 0; ch < FILTER_LANES; ch++)
+	{
+		raw[ch] = (int16_t) (z[ch] + (z[ch] < 0 ? -0.5f : 0.5f));
+	}
+}
+
+/*
+ * filterStage:
+ *	"median:<3|5>", "ema:<alpha>", "kalman:<process deg>:<noise deg>" or
+ *	"off" on one channel; the Kalman noises are standard deviations per
+ *	read in engineering units
+ */
+static int filterStage(const char *s, FilterCfgType *cfg, int scale)
+{
+	float v1, v2;
+	int n;
+
+	if (0 == strcmp(s, "off"))
+	{
+		filterInit(cfg);
+		return 0;
+	}
+	if (1 == sscanf(s, "median:%d", &n))
+	{
+		if (n != 1 && n != 3 && n != FILTER_MEDIAN_MAX)
+		{
+			return -1;
+		}
+		cfg->median = n;
+		return 0;
+	}
+	if (1 == sscanf(s, "ema:%f", &v1))
+	{
+		if (v1 <= 0 || v1 > 1)
+		{
+			return -1;
+		}
+		cfg->alpha = v1;
+		return 0;
+	}
+	if (2 == sscanf(s, "kalman:%f:%f", &v1, &v2))
+	{
+		if (v1 <= 0 || v2 < 0)
+		{
+			return -1;
+		}
+		cfg->q = (v1 * scale) * (v1 * scale);
+		cfg->r = (v2 * scale) * (v2 * scale);
+		return 0;
+	}
+	return -1;
+}
+
+/*
+ * filterParse:
+ *	"[<ch>[-<ch>]=]<stage>": a stage on every channel or on some channels
+ *	(1 based). Repeated specs add the stages. Returns 0 or -1 for a bad
+ *	spec.
+ */
+int filterParse(const char *spec, FilterCfgType *cfg, int channels, int scale)
+{
+	const char *p;
+	int first = 1, last = channels;
+	int ch;
+
+	p = strchr(spec, '=');
+	if (NULL != p)
+	{
+		if (2 != sscanf(spec, "%d-%d=", &first, &last))
+		{
+			first = last = atoi(spec);
+		}
+		if (first < 1 || last > channels || first > last)
+		{
+			return -1;
+		}
+		spec = p + 1;
+	}
+	for (ch = first; ch <= last; ch++)
+	{
+		if (0 != filterStage(spec, &cfg[ch - 1], scale))
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
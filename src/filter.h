@@ -0,0 +1,53 @@
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <stdint.h>
+#include "libsmtc.h"
+
+#define FILTER_LANES		SMTC_CH_NR
+#define FILTER_MEDIAN_MAX	5
+
+/*
+ * Host filters of one channel, applied in this order: median of the last
+ * N reads (spike rejection), exponential moving average, Kalman.
+ */
+typedef struct
+{
+	int median; // 1 - off, 3 or 5
+	float alpha; // EMA weight of the new value, 1 - off
+	float q; // Kalman process noise, raw units squared per read, 0 - off
+	float r; // Kalman measurement noise, raw units squared
+} FilterCfgType;
+
+/*
+ * Coefficients of the channels of a card as structure of arrays, one lane
+ * per channel, so the filters run on all the channels with vector
+ * instructions and no branch
+ */
+typedef struct
+{
+	float med3[FILTER_LANES]; // 1 selects the median of 3
+	float med5[FILTER_LANES];
+	float alpha[FILTER_LANES];
+	float q[FILTER_LANES];
+	float r[FILTER_LANES];
+} FilterLanesType;
+
+typedef struct
+{
+	int valid;
+	int pos; // newest slot of win[]
+	float win[FILTER_MEDIAN_MAX][FILTER_LANES];
+	float ema[FILTER_LANES];
+	float x[FILTER_LANES]; // Kalman estimate
+	float p[FILTER_LANES]; // Kalman error variance
+} FilterStateType;
+
+int filterActive(const FilterCfgType *cfg);
+void filterInit(FilterCfgType *cfg);
+void filterLanes(FilterLanesType *lanes, const FilterCfgType cfg[FILTER_LANES]);
+void filterApply(const FilterLanesType *lanes, FilterStateType *st,
+	int16_t raw[FILTER_LANES]);
+int filterParse(const char *spec, FilterCfgType *cfg, int channels, int scale);
+
+#endif //FILTER_H_
@@ -0,0 +1,420 @@
+/*
+ * flight.c:
+ *	Flight recorder: a fixed size file mapped in memory holding a ring of
+ *	the last sample frames. Writing a frame is a copy into the mapping, no
+ *	system call; a helper thread flushes the dirty pages to the disk every
+ *	FLIGHT_SYNC_MS so a watchdog power cycle loses at most that much. The
+ *	frames check themselves, after a crash the reader keeps the consistent
+ *	ones and the writer goes on after the last of them.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "smtc.h"
+#include "out.h"
+#include "flight.h"
+
+static size_t flightSize(uint32_t frames)
+{
+	return FLIGHT_HEADER_SIZE + (size_t)frames * sizeof(FrameType);
+}
+
+static int flightHeaderValid(const FlightHeaderType *h, size_t fileSize)
+{
+	return 0 == memcmp(h->magic, FLIGHT_MAGIC, sizeof(h->magic))
+		&& h->version == FLIGHT_VERSION && h->frameSize == sizeof(FrameType)
+		&& h->frames > 0 && flightSize(h->frames) == fileSize;
+}
+
+static void* flightSyncThread(void *arg)
+{
+	FlightType *fl = (FlightType*)arg;
+	struct timespec ts;
+	int stop = 0;
+
+	while (!stop)
+	{
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += FLIGHT_SYNC_MS / 1000;
+		ts.tv_nsec += (long) (FLIGHT_SYNC_MS % 1000) * 1000000L;
+		if (ts.tv_nsec >= 1000000000L)
+		{
+			ts.tv_nsec -= 1000000000L;
+			ts.tv_sec++;
+		}
+		pthread_mutex_lock(&fl->syncMutex);
+		while (!fl->syncStop
+			&& ETIMEDOUT != pthread_cond_timedwait(&fl->syncCond, &fl->syncMutex, &ts))
+			;
+		stop = fl->syncStop;
+		pthread_mutex_unlock(&fl->syncMutex);
+		msync(fl->map, fl->size, MS_SYNC);
+	}
+	return NULL;
+}
+
+static int flightMapFd(FlightType *fl, int prot)
+{
+	fl->map = mmap(NULL, fl->size, prot, MAP_SHARED, fl->fd, 0);
+	if (MAP_FAILED == fl->map)
+	{
+		fl->map = NULL;
+		close(fl->fd);
+		fl->fd = -1;
+		return -1;
+	}
+	fl->frame = (FrameType*) (fl->map + FLIGHT_HEADER_SIZE);
+	return 0;
+}
+
+/*
+ * flightCreate:
+ *	Open the ring file, creating it with room for fl->frames frames. An
+ *	existing ring of the same size is kept, one of another size is started
+ *	over; any other file that is not empty is refused, and so are symbolic
+ *	links. Returns 0 or -1.
+ */
+static int flightCreate(FlightType *fl, const char *path)
+{
+	FlightHeaderType h;
+	struct stat st;
+	int ring;
+
+	fl->fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0644);
+	if (fl->fd < 0 && errno == EEXIST)
+	{
+		fl->fd = open(path, O_RDWR | O_NOFOLLOW);
+	}
+	if (fl->fd < 0)
+	{
+		return -1;
+	}
+	if (0 != fstat(fl->fd, &st) || !S_ISREG(st.st_mode))
+	{
+		close(fl->fd);
+		fl->fd = -1;
+		return -1;
+	}
+	ring = st.st_size > 0 && sizeof(h) == pread(fl->fd, &h, sizeof(h), 0)
+		&& flightHeaderValid(&h, (size_t)st.st_size);
+	if (st.st_size > 0 && !ring)
+	{
+		close(fl->fd); // not a ring, not ours to overwrite
+		fl->fd = -1;
+		errno = EEXIST;
+		return -1;
+	}
+	if (!ring || h.frames != fl->frames)
+	{
+		// new ring: reserve the blocks now, a full disk must not fault later
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, FLIGHT_MAGIC, sizeof(h.magic));
+		h.version = FLIGHT_VERSION;
+		h.frameSize = sizeof(FrameType);
+		h.frames = fl->frames;
+		if (0 != ftruncate(fl->fd, 0)
+			|| 0 != posix_fallocate(fl->fd, 0, (off_t)fl->size)
+			|| sizeof(h) != pwrite(fl->fd, &h, sizeof(h), 0))
+		{
+			close(fl->fd);
+			fl->fd = -1;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * flightOpen:
+ *	Open the ring file for writing with the rights of the user running
+ *	smtc, see flightCreate(), and continue after its last frame. Returns 0
+ *	or -1.
+ */
+int flightOpen(FlightType *fl, const char *path, uint32_t frames)
+{
+	FlightScanType scan;
+	int ret;
+
+	memset(fl, 0, sizeof(FlightType));
+	fl->fd = -1;
+	if (frames == 0 || 0 != doUserBegin())
+	{
+		return -1;
+	}
+	fl->frames = frames;
+	fl->size = flightSize(frames);
+	ret = flightCreate(fl, path);
+	if (0 != doUserEnd())
+	{
+		ret = -1;
+	}
+	if (ret != 0)
+	{
+		if (fl->fd >= 0)
+		{
+			close(fl->fd);
+			fl->fd = -1;
+		}
+		return -1;
+	}
+	if (0 != flightMapFd(fl, PROT_READ | PROT_WRITE))
+	{
+		return -1;
+	}
+	flightScan(fl, &scan);
+	fl->seq = scan.last;
+	fl->writer = 1;
+	pthread_mutex_init(&fl->syncMutex, NULL);
+	pthread_cond_init(&fl->syncCond, NULL);
+	if (0 != pthread_create(&fl->syncThread, NULL, &flightSyncThread, fl))
+	{
+		fl->writer = 0;
+		flightClose(fl);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * flightWrite:
+ *	Next frame of the ring, a memory copy
+ */
+void flightWrite(FlightType *fl, const AcqSampleType *s)
+{
+	FrameType f;
+
+	if (NULL == fl->map)
+	{
+		return;
+	}
+	if (++fl->seq == 0)
+	{
+		fl->seq = 1;
+	}
+	frameFill(&f, s, fl->seq);
+	memcpy(&fl->frame[fl->seq % fl->frames], &f, sizeof(FrameType));
+}
+
+/*
+ * flightMap:
+ *	Open a ring file read only, with the rights of the user running smtc
+ */
+int flightMap(FlightType *fl, const char *path)
+{
+	FlightHeaderType h;
+	struct stat st;
+
+	memset(fl, 0, sizeof(FlightType));
+	if (0 != doUserBegin())
+	{
+		fl->fd = -1;
+		return -1;
+	}
+	fl->fd = open(path, O_RDONLY);
+	if (0 != doUserEnd() && fl->fd >= 0)
+	{
+		close(fl->fd);
+		fl->fd = -1;
+	}
+	if (fl->fd < 0)
+	{
+		return -1;
+	}
+	if (0 != fstat(fl->fd, &st) || sizeof(h) != pread(fl->fd, &h, sizeof(h), 0)
+		|| !flightHeaderValid(&h, (size_t)st.st_size))
+	{
+		close(fl->fd);
+		fl->fd = -1;
+		errno = EINVAL;
+		return -1;
+	}
+	fl->frames = h.frames;
+	fl->size = flightSize(h.frames);
+	if (0 != flightMapFd(fl, PROT_READ))
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * flightScan:
+ *	Consistent and torn frames of the ring. The consistent frames are the
+ *	sequence numbers first..last, with holes where a frame was torn.
+ */
+void flightScan(const FlightType *fl, FlightScanType *scan)
+{
+	const FrameType *f;
+	uint32_t i;
+
+	memset(scan, 0, sizeof(FlightScanType));
+	for (i = 0; i < fl->frames; i++)
+	{
+		f = &fl->frame[i];
+		if (!frameValid(f))
+		{
+			if (f->seq != 0)
+			{
+				scan->torn++;
+			}
+			continue;
+		}
+		if (scan->valid == 0 || f->seq < scan->first)
+		{
+			scan->first = f->seq;
+		}
+		if (f->seq > scan->last)
+		{
+			scan->last = f->seq;
+		}
+		scan->valid++;
+	}
+}
+
+/*
+ * flightFrame:
+ *	The frame with a sequence number, NULL if it was overwritten or torn
+ */
+const FrameType* flightFrame(const FlightType *fl, uint32_t seq)
+{
+	const FrameType *f = &fl->frame[seq % fl->frames];
+
+	return frameValid(f) && f->seq == seq ? f : NULL;
+}
+
+void flightClose(FlightType *fl)
+{
+	if (fl->writer)
+	{
+		pthread_mutex_lock(&fl->syncMutex);
+		fl->syncStop = 1;
+		pthread_cond_signal(&fl->syncCond);
+		pthread_mutex_unlock(&fl->syncMutex);
+		pthread_join(fl->syncThread, NULL);
+		fl->writer = 0;
+	}
+	if (NULL != fl->map)
+	{
+		munmap(fl->map, fl->size);
+		fl->map = NULL;
+	}
+	if (fl->fd >= 0)
+	{
+		close(fl->fd);
+		fl->fd = -1;
+	}
+}
+
+//************************ CLI ****************************
+
+static const char *gFlightKeys[SMTC_CH_NR] = {"t1", "t2", "t3", "t4", "t5",
+	"t6", "t7", "t8"};
+
+static void flightOut(const FrameType *f)
+{
+	int ch;
+
+	if (outFormat() == OUT_TEXT)
+	{
+		printf("%d:%d ", f->bus, f->stack);
+	}
+	outBegin();
+	outTag("bus", f->bus);
+	outTag("id", f->stack);
+	outLong("seq", f->seq);
+	outLong("ts", f->tMs);
+	if (f->ret != SMTC_OK)
+	{
+		outInt("error", f->ret);
+	}
+	else
+	{
+		for (ch = 0; ch < SMTC_CH_NR; ch++)
+		{
+			outFixed(gFlightKeys[ch], f->raw[ch], 1);
+		}
+	}
+	outEnd();
+}
+
+int doFlight(int argc, char *argv[]);
+const CliCmdType CMD_FLIGHT =
+	{
+		"-flight",
+		1,
+		&doFlight,
+		"\t-flight:    Print the frames kept by a flight recorder file (-poll/stream --flight), oldest first\n",
+		"\tUsage:      smtc -flight <file> [<last frames>]\n",
+		"",
+		"\tExample:    smtc -flight /var/lib/smtc/flight.bin 100; Print the last 100 frames recorded before the reboot\n"};
+
+int doFlight(int argc, char *argv[])
+{
+	FlightType fl;
+	FlightScanType scan;
+	const FrameType *f;
+	uint32_t seq, first;
+	time_t t;
+	char when[32];
+
+	if (argc != 3 && argc != 4)
+	{
+		return ARG_CNT_ERR;
+	}
+	if (argc == 4 && atoi(argv[3]) <= 0)
+	{
+		return ARG_ERR;
+	}
+	if (0 != flightMap(&fl, argv[2]))
+	{
+		printf("Fail to open the flight recorder %s: %s\n", argv[2],
+			strerror(errno));
+		return ERROR;
+	}
+	flightScan(&fl, &scan);
+	first = scan.first;
+	if (argc == 4 && scan.last - first + 1 > (uint32_t)atoi(argv[3]))
+	{
+		first = scan.last - (uint32_t)atoi(argv[3]) + 1;
+	}
+	for (seq = first; scan.valid > 0 && seq - first <= scan.last - first; seq++)
+	{
+		f = flightFrame(&fl, seq);
+		if (f != NULL)
+		{
+			flightOut(f);
+		}
+	}
+	fflush(stdout);
+	if (scan.valid > 0)
+	{
+		f = flightFrame(&fl, scan.last);
+		t = (time_t) (f->tMs / 1000);
+		strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&t));
+		fprintf(stderr,
+			"%u frames (#%u..#%u), %u torn, last consistent frame #%u at %s.%03d\n",
+			scan.valid, scan.first, scan.last, scan.torn, scan.last, when,
+			(int) (f->tMs % 1000));
+	}
+	else
+	{
+		fprintf(stderr, "No frame recorded, %u torn\n", scan.torn);
+	}
+	flightClose(&fl);
+	return OK;
+}
@@ -0,0 +1,53 @@
+#ifndef FLIGHT_H_
+#define FLIGHT_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include "frame.h"
+
+#define FLIGHT_MAGIC		"SMTCFLT1"
+#define FLIGHT_VERSION		1
+#define FLIGHT_HEADER_SIZE	4096
+#define FLIGHT_DEFAULT_MB	16
+#define FLIGHT_SYNC_MS		1000
+
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t frameSize;
+	uint32_t frames;
+	uint32_t reserved;
+} FlightHeaderType;
+
+typedef struct
+{
+	int fd;
+	uint8_t *map;
+	size_t size;
+	FrameType *frame;
+	uint32_t frames;
+	uint32_t seq; // last frame written or recovered
+	int writer;
+	int syncStop;
+	pthread_t syncThread;
+	pthread_mutex_t syncMutex;
+	pthread_cond_t syncCond;
+} FlightType;
+
+typedef struct
+{
+	uint32_t valid; // consistent frames in the ring
+	uint32_t torn; // written but inconsistent
+	uint32_t first; // oldest consistent sequence number
+	uint32_t last; // newest consistent sequence number, 0 - empty
+} FlightScanType;
+
+int flightOpen(FlightType *fl, const char *path, uint32_t frames);
+void flightWrite(FlightType *fl, const AcqSampleType *s);
+int flightMap(FlightType *fl, const char *path);
+void flightScan(const FlightType *fl, FlightScanType *scan);
+const FrameType* flightFrame(const FlightType *fl, uint32_t seq);
+void flightClose(FlightType *fl);
+
+#endif //FLIGHT_H_
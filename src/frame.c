@@ -0,0 +1,61 @@
+/*
+ * frame.c:
+ *	Fixed size sample frames for the files written by the acquisition
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "frame.h"
+
+#define FRAME_FNV_BASIS	2166136261u
+#define FRAME_FNV_PRIME	16777619u
+
+static uint32_t frameHash(const FrameType *f)
+{
+	const uint8_t *p = (const uint8_t*)f;
+	uint32_t h = FRAME_FNV_BASIS;
+	size_t i;
+
+	for (i = 0; i < offsetof(FrameType, check); i++)
+	{
+		h = (h ^ p[i]) * FRAME_FNV_PRIME;
+	}
+	return h;
+}
+
+/*
+ * frameFill:
+ *	Frame of a sample, time stamped with the wall clock now
+ */
+void frameFill(FrameType *f, const AcqSampleType *s, uint32_t seq)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	memset(f, 0, sizeof(FrameType));
+	f->seq = seq;
+	f->bus = (uint8_t)s->bus;
+	f->stack = (uint8_t)s->stack;
+	f->ret = (int16_t)s->ret;
+	f->tMs = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	if (s->ret == SMTC_OK)
+	{
+		memcpy(f->raw, s->raw, sizeof(f->raw));
+	}
+	f->check = frameHash(f);
+}
+
+int frameValid(const FrameType *f)
+{
+	return f->seq != 0 && f->check == frameHash(f);
+}
@@ -0,0 +1,27 @@
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <stdint.h>
+#include "acq.h"
+
+/*
+ * Sample frame as stored in files (flight recorder, logs): fixed size,
+ * little endian, self checking so a torn or never written frame is
+ * recognized after a crash.
+ */
+typedef struct
+{
+	uint32_t seq; // 0 - never written
+	uint8_t bus;
+	uint8_t stack;
+	int16_t ret;
+	int64_t tMs; // wall clock, ms since the epoch
+	int16_t raw[SMTC_CH_NR];
+	uint32_t check; // FNV-1a of the bytes above
+	uint32_t reserved;
+} FrameType;
+
+void frameFill(FrameType *f, const AcqSampleType *s, uint32_t seq);
+int frameValid(const FrameType *f);
+
+#endif //FRAME_H_
@@ -0,0 +1,161 @@
+/*
+ * hist.c:
+ *	Log-linear histogram for latencies: every power of two is split in
+ *	HIST_SUB buckets, so any value is kept with about 6% precision from
+ *	1us to hours in a fixed 4KB table. Adding a value is a few integer
+ *	operations and never allocates, histograms of several threads are
+ *	merged by adding the buckets.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hist.h"
+
+void histInit(HistType *h)
+{
+	memset(h, 0, sizeof(HistType));
+	h->min = UINT64_MAX;
+}
+
+static int histIndex(uint64_t val)
+{
+	int mag;
+
+	if (val < HIST_SUB)
+	{
+		return (int)val;
+	}
+	mag = 63 - __builtin_clzll(val); // >= HIST_SUB_BITS
+	return (mag - HIST_SUB_BITS + 1) * HIST_SUB
+		+ (int) ( (val >> (mag - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/*
+ * histTop:
+ *	Highest value counted in a bucket
+ */
+static uint64_t histTop(int idx)
+{
+	int mag;
+
+	if (idx < HIST_SUB)
+	{
+		return (uint64_t)idx;
+	}
+	mag = idx / HIST_SUB + HIST_SUB_BITS - 1;
+	return ( ( (uint64_t) (HIST_SUB + idx % HIST_SUB) + 1) << (mag - HIST_SUB_BITS))
+		- 1;
+}
+
+void histAdd(HistType *h, uint64_t val)
+{
+	h->bucket[histIndex(val)]++;
+	h->count++;
+	h->sum += val;
+	if (val < h->min)
+	{
+		h->min = val;
+	}
+	if (val > h->max)
+	{
+		h->max = val;
+	}
+}
+
+void histMerge(HistType *dst, const HistType *src)
+{
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+	{
+		dst->bucket[i] += src->bucket[i];
+	}
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->min < dst->min)
+	{
+		dst->min = src->min;
+	}
+	if (src->max > dst->max)
+	{
+		dst->max = src->max;
+	}
+}
+
+/*
+ * histPercentile:
+ *	Smallest bucket top with at least pct percent of the values at or
+ *	below it, never above the largest value seen; 0 when empty
+ */
+uint64_t histPercentile(const HistType *h, double pct)
+{
+	uint64_t rank, seen = 0;
+	uint64_t top;
+	int i;
+
+	if (h->count == 0)
+	{
+		return 0;
+	}
+	rank = (uint64_t) (pct / 100.0 * (double)h->count + 0.5);
+	if (rank < 1)
+	{
+		rank = 1;
+	}
+	for (i = 0; i < HIST_BUCKETS; i++)
+	{
+		seen += h->bucket[i];
+		if (seen >= rank)
+		{
+			top = histTop(i);
+			return top < h->max ? top : h->max;
+		}
+	}
+	return h->max;
+}
+
+uint64_t histMean(const HistType *h)
+{
+	return h->count ? h->sum / h->count : 0;
+}
+
+/*
+ * histPrint:
+ *	Percentile distribution table in the HdrHistogram text layout: one line
+ *	per percentile, halving the distance to 100% at each step, then the
+ *	mean, the max and the count
+ */
+void histPrint(FILE *f, const char *title, const HistType *h)
+{
+	double pct, left;
+	uint64_t val, cnt;
+
+	fprintf(f, "# %s\n", title);
+	fprintf(f, "%12s %12s %12s %16s\n\n", "Value", "Percentile", "TotalCount",
+		"1/(1-Percentile)");
+	for (left = 100.0; h->count > 0; left /= 2)
+	{
+		pct = 100.0 - left;
+		val = pct > 0 ? histPercentile(h, pct) : h->min;
+		cnt = (uint64_t) (pct / 100.0 * (double)h->count + 0.5);
+		if (cnt >= h->count || left < 100.0 / (double)h->count)
+		{
+			break;
+		}
+		fprintf(f, "%12llu %12.6f %12llu %16.2f\n", (unsigned long long)val,
+			pct / 100.0, (unsigned long long)cnt, 100.0 / left);
+	}
+	fprintf(f, "%12llu %12.6f %12llu\n", (unsigned long long)h->max, 1.0,
+		(unsigned long long)h->count);
+	fprintf(f, "#[Mean = %llu, Max = %llu, Total count = %llu]\n\n",
+		(unsigned long long)histMean(h), (unsigned long long)h->max,
+		(unsigned long long)h->count);
+}
@@ -0,0 +1,27 @@
+#ifndef HIST_H_
+#define HIST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define HIST_SUB_BITS	4
+#define HIST_SUB		(1 << HIST_SUB_BITS)
+#define HIST_BUCKETS	((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct
+{
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+	uint32_t bucket[HIST_BUCKETS];
+} HistType;
+
+void histInit(HistType *h);
+void histAdd(HistType *h, uint64_t val);
+void histMerge(HistType *dst, const HistType *src);
+uint64_t histPercentile(const HistType *h, double pct);
+uint64_t histMean(const HistType *h);
+void histPrint(FILE *f, const char *title, const HistType *h);
+
+#endif //HIST_H_
@@ -0,0 +1,388 @@
+/*
+ * journal.c:
+ *	Durable sample log with group commit. The acquisition appends frames
+ *	to a ring in memory; a writer thread takes everything queued every
+ *	syncMs, or as soon as syncBytes are waiting, writes it with one writev
+ *	and makes it durable with one fdatasync. One sync per batch instead of
+ *	one per sample spares the SD card, and a frame is never waiting longer
+ *	than syncMs plus one commit, which the stats report as the loss window.
+ *	The log is a directory of numbered segment files of frames.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/fsuid.h>
+
+#include "smtc.h"
+#include "comm.h"
+#include "journal.h"
+
+#define JOURNAL_SEGMENT_FMT	"%s/seg-%06u.smtc"
+
+int journalSegmentName(char *name, int size, const char *dir, uint32_t segment)
+{
+	return snprintf(name, size, JOURNAL_SEGMENT_FMT, dir, segment) < size ? 0 : -1;
+}
+
+/*
+ * journalLastSegment:
+ *	Highest segment number in the directory, 0 if none
+ */
+static uint32_t journalLastSegment(const char *dir)
+{
+	DIR *d;
+	struct dirent *e;
+	unsigned int n;
+	uint32_t last = 0;
+
+	d = opendir(dir);
+	if (NULL == d)
+	{
+		return 0;
+	}
+	while ( (e = readdir(d)) != NULL)
+	{
+		if (1 == sscanf(e->d_name, "seg-%u.smtc", &n) && n > last)
+		{
+			last = n;
+		}
+	}
+	closedir(d);
+	return last;
+}
+
+/*
+ * journalSegmentOpen:
+ *	Next segment, never appending to one left by a previous run whose tail
+ *	may be torn. The directory is synced so the segment is still there
+ *	after a power cut, the header is made durable with the first batch.
+ */
+static int journalSegmentOpen(JournalType *j)
+{
+	JournalHeaderType h;
+	struct timespec ts;
+	char name[JOURNAL_NAME_MAX + 32];
+
+	j->segment++;
+	if (0 != journalSegmentName(name, sizeof(name), j->dir, j->segment))
+	{
+		return -1;
+	}
+	j->fd = open(name, O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+	if (j->fd < 0)
+	{
+		return -1;
+	}
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, JOURNAL_MAGIC, sizeof(h.magic));
+	h.version = JOURNAL_VERSION;
+	h.frameSize = sizeof(FrameType);
+	clock_gettime(CLOCK_REALTIME, &ts);
+	h.startMs = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	if (sizeof(h) != write(j->fd, &h, sizeof(h)) || 0 != fsync(j->dirFd))
+	{
+		close(j->fd);
+		j->fd = -1;
+		unlink(name);
+		return -1;
+	}
+	j->segmentBytes = sizeof(h);
+	j->stats.segments++;
+	return 0;
+}
+
+/*
+ * journalCommit:
+ *	Write frames tail..head of the ring, one or two iovecs when the batch
+ *	wraps, then one fdatasync. Called by the writer thread only, without
+ *	the mutex: the producers keep appending meanwhile. On a failed write or
+ *	sync the batch is cut from the segment, which is closed so the next
+ *	commit starts a new one on a frame boundary. Returns 0 or -1, the
+ *	frames stay queued.
+ */
+static int journalCommit(JournalType *j, uint32_t tail, uint32_t head)
+{
+	struct iovec iov[2];
+	uint32_t n = head - tail;
+	uint32_t first = tail % JOURNAL_RING_FRAMES;
+	uint64_t start, end, lossMs;
+	ssize_t size;
+	int cnt = 1;
+
+	if (j->fd >= 0 && j->segmentBytes + (uint64_t)n * sizeof(FrameType)
+		> JOURNAL_SEGMENT_BYTES)
+	{
+		if (0 != fdatasync(j->fd))
+		{
+			j->stats.errors++;
+		}
+		close(j->fd);
+		j->fd = -1;
+	}
+	if (j->fd < 0 && 0 != journalSegmentOpen(j))
+	{
+		j->stats.errors++;
+		return -1;
+	}
+	iov[0].iov_base = &j->ring[first];
+	if (first + n <= JOURNAL_RING_FRAMES)
+	{
+		iov[0].iov_len = n * sizeof(FrameType);
+	}
+	else
+	{
+		iov[0].iov_len = (JOURNAL_RING_FRAMES - first) * sizeof(FrameType);
+		iov[1].iov_base = &j->ring[0];
+		iov[1].iov_len = (first + n - JOURNAL_RING_FRAMES) * sizeof(FrameType);
+		cnt = 2;
+	}
+	start = commTimeUs();
+	size = writev(j->fd, iov, cnt);
+	if (size != (ssize_t) (n * sizeof(FrameType)) || 0 != fdatasync(j->fd))
+	{
+		j->stats.errors++;
+		if (0 != ftruncate(j->fd, (off_t)j->segmentBytes))
+		{
+			j->stats.errors++;
+		}
+		close(j->fd);
+		j->fd = -1;
+		return -1;
+	}
+	end = commTimeUs();
+	lossMs = (end - j->queuedUs[first]) / 1000;
+	j->segmentBytes += (uint64_t)size;
+	j->stats.frames += n;
+	j->stats.bytes += (uint64_t)size;
+	j->stats.commits++;
+	j->stats.commitUs += end - start;
+	if (end - start > j->stats.maxCommitUs)
+	{
+		j->stats.maxCommitUs = (uint32_t) (end - start);
+	}
+	if (lossMs > j->stats.maxLossMs)
+	{
+		j->stats.maxLossMs = (uint32_t)lossMs;
+	}
+	return 0;
+}
+
+static void* journalThread(void *arg)
+{
+	JournalType *j = (JournalType*)arg;
+	struct timespec ts;
+	uint32_t tail, head;
+	int stop = 0;
+	int failed = 0;
+
+	setfsuid(getuid()); // the next segments belong to the user too, this thread only
+
+	while (!stop)
+	{
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += j->syncMs / 1000;
+		ts.tv_nsec += (long) (j->syncMs % 1000) * 1000000L;
+		if (ts.tv_nsec >= 1000000000L)
+		{
+			ts.tv_nsec -= 1000000000L;
+			ts.tv_sec++;
+		}
+		pthread_mutex_lock(&j->mutex);
+		// after a failure the next attempt waits for the period
+		while (!j->stop
+			&& (failed || (j->head - j->tail) * sizeof(FrameType) < j->syncBytes)
+			&& ETIMEDOUT != pthread_cond_timedwait(&j->cond, &j->mutex, &ts))
+			;
+		stop = j->stop;
+		tail = j->tail;
+		head = j->head;
+		pthread_mutex_unlock(&j->mutex);
+		if (head == tail)
+		{
+			continue;
+		}
+		failed = 0 != journalCommit(j, tail, head);
+		pthread_mutex_lock(&j->mutex);
+		if (!failed)
+		{
+			j->tail = head; // the slots can be filled again
+		}
+		else if (stop)
+		{
+			j->stats.dropped += head - tail; // never made durable
+		}
+		pthread_mutex_unlock(&j->mutex);
+	}
+	return NULL;
+}
+
+/*
+ * journalSyncDir:
+ *	Make the entries of a directory durable
+ */
+static int journalSyncDir(const char *dir)
+{
+	int fd, ret;
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	ret = fsync(fd);
+	close(fd);
+	return ret;
+}
+
+/*
+ * journalCreate:
+ *	The directory, created if needed and synced in its parent, and its
+ *	first segment
+ */
+static int journalCreate(JournalType *j, const char *dir)
+{
+	char parent[JOURNAL_NAME_MAX];
+
+	if (0 == mkdir(dir, 0755))
+	{
+		strcpy(parent, dir);
+		if (0 != journalSyncDir(dirname(parent)))
+		{
+			return -1;
+		}
+	}
+	else if (errno != EEXIST)
+	{
+		return -1;
+	}
+	j->dirFd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (j->dirFd < 0)
+	{
+		return -1;
+	}
+	j->segment = journalLastSegment(dir);
+	return journalSegmentOpen(j);
+}
+
+static void journalFilesClose(JournalType *j)
+{
+	if (j->fd >= 0)
+	{
+		close(j->fd);
+		j->fd = -1;
+	}
+	if (j->dirFd >= 0)
+	{
+		close(j->dirFd);
+		j->dirFd = -1;
+	}
+}
+
+/*
+ * journalOpen:
+ *	Start logging to the directory (created if needed) with the rights of
+ *	the user running smtc: the first segment is opened now, the writer
+ *	thread commits every syncMs or syncBytes. Returns 0 or -1.
+ */
+int journalOpen(JournalType *j, const char *dir, int syncMs, uint32_t syncBytes)
+{
+	int ret;
+
+	memset(j, 0, sizeof(JournalType));
+	j->fd = -1;
+	j->dirFd = -1;
+	if (syncMs <= 0 || strlen(dir) >= JOURNAL_NAME_MAX)
+	{
+		return -1;
+	}
+	strcpy(j->dir, dir);
+	j->syncMs = syncMs;
+	j->syncBytes = syncBytes;
+	if (syncBytes > JOURNAL_RING_FRAMES / 2 * sizeof(FrameType))
+	{
+		j->syncBytes = JOURNAL_RING_FRAMES / 2 * sizeof(FrameType);
+	}
+	if (0 != doUserBegin())
+	{
+		return -1;
+	}
+	ret = journalCreate(j, dir);
+	if (0 != doUserEnd())
+	{
+		ret = -1;
+	}
+	if (ret != 0)
+	{
+		journalFilesClose(j);
+		return -1;
+	}
+	pthread_mutex_init(&j->mutex, NULL);
+	pthread_cond_init(&j->cond, NULL);
+	if (0 != pthread_create(&j->thread, NULL, &journalThread, j))
+	{
+		journalFilesClose(j);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * journalAppend:
+ *	Queue the frame of a sample, no system call; the writer is woken only
+ *	when the byte budget is reached
+ */
+void journalAppend(JournalType *j, const AcqSampleType *s)
+{
+	uint32_t slot;
+
+	pthread_mutex_lock(&j->mutex);
+	if (j->head - j->tail >= JOURNAL_RING_FRAMES)
+	{
+		j->stats.dropped++;
+		pthread_mutex_unlock(&j->mutex);
+		return;
+	}
+	slot = j->head % JOURNAL_RING_FRAMES;
+	frameFill(&j->ring[slot], s, ++j->seq);
+	j->queuedUs[slot] = commTimeUs();
+	j->head++;
+	if ( (j->head - j->tail) * sizeof(FrameType) >= j->syncBytes)
+	{
+		pthread_cond_signal(&j->cond);
+	}
+	pthread_mutex_unlock(&j->mutex);
+}
+
+/*
+ * journalClose:
+ *	Commit what is queued, stop the writer and return the stats
+ */
+void journalClose(JournalType *j, JournalStatsType *stats)
+{
+	pthread_mutex_lock(&j->mutex);
+	j->stop = 1;
+	pthread_cond_signal(&j->cond);
+	pthread_mutex_unlock(&j->mutex);
+	pthread_join(j->thread, NULL);
+	journalFilesClose(j);
+	if (NULL != stats)
+	{
+		*stats = j->stats;
+	}
+}
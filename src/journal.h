@@ -0,0 +1,63 @@
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include "frame.h"
+
+#define JOURNAL_MAGIC			"SMTCSEG1"
+#define JOURNAL_VERSION			1
+#define JOURNAL_RING_FRAMES		8192 // power of two
+#define JOURNAL_SEGMENT_BYTES	(64 * 1024 * 1024)
+#define JOURNAL_DEFAULT_SYNC_MS	1000
+#define JOURNAL_DEFAULT_SYNC_KB	64
+#define JOURNAL_NAME_MAX		256
+
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t frameSize;
+	int64_t startMs; // wall clock when the segment was opened
+} JournalHeaderType;
+
+typedef struct
+{
+	uint64_t frames; // durable
+	uint64_t bytes;
+	uint32_t commits;
+	uint32_t segments;
+	uint32_t dropped; // ring full, or still queued at the close after a failure
+	uint32_t errors; // failed writes or syncs
+	uint64_t commitUs; // total time in writev + fdatasync
+	uint32_t maxCommitUs;
+	uint32_t maxLossMs; // oldest frame age when it became durable
+} JournalStatsType;
+
+typedef struct
+{
+	char dir[JOURNAL_NAME_MAX];
+	int syncMs;
+	uint32_t syncBytes;
+	int dirFd; // synced when a segment is created
+	int fd;
+	uint32_t segment;
+	uint64_t segmentBytes;
+	uint32_t seq;
+	FrameType ring[JOURNAL_RING_FRAMES];
+	uint64_t queuedUs[JOURNAL_RING_FRAMES];
+	uint32_t head; // next frame to fill
+	uint32_t tail; // next frame to write
+	int stop;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	JournalStatsType stats;
+} JournalType;
+
+int journalOpen(JournalType *j, const char *dir, int syncMs, uint32_t syncBytes);
+void journalAppend(JournalType *j, const AcqSampleType *s);
+void journalClose(JournalType *j, JournalStatsType *stats);
+int journalSegmentName(char *name, int size, const char *dir, uint32_t segment);
+
+#endif //JOURNAL_H_
@@ -4,11 +4,8 @@
 #include <string.h>
 
 #include "led.h"
-#include "comm.h"
-
-
-#define LED_THRESHOLD_MIN -200
-#define LED_THRESHOLD_MAX 300
+#include "libsmtc.h"
+#include "out.h"
 
 const CliCmdType CMD_READ_LED_MODE =
 	{
@@ -50,100 +47,18 @@ const CliCmdType CMD_WRITE_LED_TH =
 		"",
 		"\tExample:    smtc 0 ledthwr 2 10; Write the led threshold on channel #2 on Board #0 to 10 deg C\n"};
 
-int ledGetMode(int dev, int ch, int* val)
-{
-	u8 buff[2];
-	u16 readVal = 0;
-
-	if (NULL == val)
-	{
-		return ERROR;
-	}
-
-	if (FAIL == i2cMem8Read(dev, TCP_LEDS_FUNC, buff, 2))
-	{
-		return ERROR;
-	}
-	memcpy(&readVal, buff, 2);
-	*val = 0x03 & (readVal >> (2 * (ch - 1)));
-	return OK;
-}
-
-int ledSetMode(int dev, int ch, int val)
-{
-	u8 buff[2];
-	u16 readVal = 0;
-
-	if ( (val > 2) || (val < 0))
-	{
-		return ERROR;
-	}
-	if (FAIL == i2cMem8Read(dev, TCP_LEDS_FUNC, buff, 2))
-	{
-		return ERROR;
-	}
-	memcpy(&readVal, buff, 2);
-
-	readVal &= ~ ((u16)0x03 << (2 * (ch - 1)));
-	readVal += val << (2 * (ch - 1));
-	memcpy(buff, &readVal, 2);
-	if (FAIL == i2cMem8Write(dev, TCP_LEDS_FUNC, buff, 2))
-	{
-		return ERROR;
-	}
-	return OK;
-}
-
-int ledGetThreshold(int dev, int ch, int* val)
-{
-	u8 buff[2];
-	s16 readVal = 0;
-
-	if (NULL == val)
-	{
-		return ERROR;
-	}
-
-	if (FAIL == i2cMem8Read(dev, TCP_LED_THRESHOLD1 + 2 * (ch - 1), buff, 2))
-	{
-		return ERROR;
-	}
-	memcpy(&readVal, buff, 2);
-	*val = readVal;
-	return OK;
-}
-
-int ledSetThreshold(int dev, int ch, int val)
-{
-	u8 buff[2];
-	s16 readVal = 0;
-
-	if ( (val < LED_THRESHOLD_MIN) || (val > LED_THRESHOLD_MAX))
-	{
-		printf("Threshold out of range!");
-		return ERROR;
-	}
-	readVal = (s16)val;
-	memcpy(buff, &readVal, 2);
-	if (FAIL == i2cMem8Write(dev, TCP_LED_THRESHOLD1 + 2 * (ch - 1), buff, 2))
-	{
-		return ERROR;
-	}
-	return OK;
-}
-
 //******************************************
 
 int doLedModeRead(int argc, char *argv[])
 {
 	int ch = 0;
 	int val = 0;
-	int dev = 0;
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 4)
@@ -152,20 +67,22 @@ int doLedModeRead(int argc, char *argv[])
 		if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
 		{
 			printf("RTD channel number value out of range!\n");
-			exit(1);
+			return ERROR;
 		}
 
-		if (OK != ledGetMode(dev, ch, &val))
+		if (SMTC_OK != smtcLedModeGet(board, ch, &val))
 		{
 			printf("Fail to read!\n");
-			exit(1);
+			return ERROR;
 		}
-		printf("%d\n", val);
+		doOutChannel(board, ch);
+		outInt("mode", val);
+		outEnd();
 	}
 	else
 	{
 		printf("Invalid arguments number for %s cmd\n", argv[0]);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -174,12 +91,12 @@ int doLedModeWrite(int argc, char *argv[])
 {
 	int ch = 0;
 	int val = 0;
-	int dev = 0;
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 5)
@@ -188,21 +105,21 @@ int doLedModeWrite(int argc, char *argv[])
 		if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
 		{
 			printf("RTD channel number value out of range!\n");
-			exit(1);
+			return ERROR;
 		}
 
 		val = atoi(argv[4]);
 
-		if (OK != ledSetMode(dev, ch, val))
+		if (SMTC_OK != smtcLedModeSet(board, ch, val))
 		{
 			printf("Fail to write!\n");
-			exit(1);
+			return ERROR;
 		}
 	}
 	else
 	{
 		printf("Invalid arguments number for %s cmd\n", argv[0]);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -211,12 +128,12 @@ int doLedThresholdRead(int argc, char *argv[])
 {
 	int ch = 0;
 	int val = 0;
-	int dev = 0;
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 4)
@@ -225,20 +142,22 @@ int doLedThresholdRead(int argc, char *argv[])
 		if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
 		{
 			printf("RTD channel number value out of range!\n");
-			exit(1);
+			return ERROR;
 		}
 
-		if (OK != ledGetThreshold(dev, ch, &val))
+		if (SMTC_OK != smtcLedThresholdGet(board, ch, &val))
 		{
 			printf("Fail to read!\n");
-			exit(1);
+			return ERROR;
 		}
-		printf("%d\n", val);
+		doOutChannel(board, ch);
+		outInt("threshold", val);
+		outEnd();
 	}
 	else
 	{
 		printf("Invalid arguments number for %s cmd\n", argv[0]);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -247,12 +166,12 @@ int doLedThresholdWrite(int argc, char *argv[])
 {
 	int ch = 0;
 		int val = 0;
-		int dev = 0;
+		SmtcBoardType *board;
 
-		dev = doBoardInit(atoi(argv[1]));
-		if (dev <= 0)
+		board = doBoardOpen(argv[1]);
+		if (NULL == board)
 		{
-			exit(1);
+			return ERROR;
 		}
 
 		if (argc == 5)
@@ -261,21 +180,25 @@ int doLedThresholdWrite(int argc, char *argv[])
 			if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
 			{
 				printf("RTD channel number value out of range!\n");
-				exit(1);
+				return ERROR;
 			}
 
 			val = atoi(argv[4]);
+			if ( (val < LED_THRESHOLD_MIN) || (val > LED_THRESHOLD_MAX))
+			{
+				printf("Threshold out of range!");
+			}
 
-			if (OK != ledSetThreshold(dev, ch, val))
+			if (SMTC_OK != smtcLedThresholdSet(board, ch, val))
 			{
 				printf("Fail to write!\n");
-				exit(1);
+				return ERROR;
 			}
 		}
 		else
 		{
 			printf("Invalid arguments number for %s cmd\n", argv[0]);
-			exit(1);
+			return ERROR;
 		}
 		return OK;
 }
@@ -3,6 +3,9 @@
 
 #include "smtc.h"
 
+#define LED_THRESHOLD_MIN -200
+#define LED_THRESHOLD_MAX 300
+
 int doLedModeRead(int argc, char *argv[]);
 int doLedModeWrite(int argc, char *argv[]);
 int doLedThresholdRead(int argc, char *argv[]);
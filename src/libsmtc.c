@@ -0,0 +1,981 @@
+/*
+ * libsmtc.c:
+ *	Register level access to the Thermocouple card, shared by the smtc
+ *	command and the libsmtc library
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "smtc.h"
+#include "comm.h"
+#include "rs485.h"
+#include "led.h"
+#include "libsmtc.h"
+#include "cache.h"
+
+#define FILT_SIZE_MIN		1
+#define FILT_SIZE_MAX		40
+
+const char* smtcStrError(int err)
+{
+	switch (err)
+	{
+	case SMTC_OK:
+		return "OK";
+	case SMTC_ERR_BUS:
+		return "bus transaction failed";
+	case SMTC_ERR_ARG:
+		return "invalid argument";
+	case SMTC_ERR_NO_BOARD:
+		return "card not detected";
+	case SMTC_ERR_OPEN:
+		return "fail to open the bus";
+	default:
+		return "unknown error";
+	}
+}
+
+static int smtcChValid(int ch, int max)
+{
+	return (ch >= CHANNEL_NR_MIN) && (ch <= max);
+}
+
+static int smtcDev(SmtcBoardType *board)
+{
+	if (NULL == board || !board->valid)
+	{
+		return SMTC_ERR_ARG;
+	}
+	if (board->dev <= 0)
+	{
+		board->dev = commOpen(board->bus, SLAVE_OWN_ADDRESS_BASE + board->stack);
+		if (board->dev <= 0)
+		{
+			board->dev = 0;
+			return SMTC_ERR_OPEN;
+		}
+	}
+	return SMTC_OK;
+}
+
+static int smtcRead(SmtcBoardType *board, int add, u8 *buff, int size)
+{
+	int ret = smtcDev(board);
+
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	if (OK != i2cMem8Read(board->dev, add, buff, size))
+	{
+		cacheInvalidate(board->bus, board->stack);
+		return SMTC_ERR_BUS;
+	}
+	return SMTC_OK;
+}
+
+static int smtcWrite(SmtcBoardType *board, int add, u8 *buff, int size)
+{
+	int ret = smtcDev(board);
+
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	if (OK != i2cMem8Write(board->dev, add, buff, size))
+	{
+		cacheInvalidate(board->bus, board->stack);
+		return SMTC_ERR_BUS;
+	}
+	return SMTC_OK;
+}
+
+static int smtcRead16(SmtcBoardType *board, int add, int *val, int isSigned)
+{
+	u8 buff[2];
+	u16 u = 0;
+	int ret;
+
+	if (NULL == val)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcRead(board, add, buff, 2);
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	memcpy(&u, buff, 2);
+	*val = isSigned ? (int)(s16)u : (int)u;
+	return SMTC_OK;
+}
+
+static int smtcWrite16(SmtcBoardType *board, int add, int val)
+{
+	u8 buff[2];
+	u16 u = (u16)val;
+
+	memcpy(buff, &u, 2);
+	return smtcWrite(board, add, buff, 2);
+}
+
+//************************ Handle ****************************
+
+/*
+ * smtcOpen:
+ *	Open the card at stack level "stack" on i2c bus "bus". The card
+ *	revision comes from the topology cache when it is fresh, otherwise it is
+ *	read from the card, the read doubling as the presence check. With a
+ *	cache hit the bus is opened only on the first access to the card.
+ */
+int smtcOpen(SmtcBoardType *board, int bus, int stack)
+{
+	u8 buff[4];
+	int ret;
+
+	if (NULL == board || stack < 0 || stack >= SMTC_STACK_MAX)
+	{
+		return SMTC_ERR_ARG;
+	}
+	memset(board, 0, sizeof(SmtcBoardType));
+	board->bus = bus;
+	board->stack = stack;
+	board->cardType = -1;
+	ret = cacheLookup(bus, stack, board);
+	if (ret == CACHE_ABSENT)
+	{
+		return SMTC_ERR_NO_BOARD;
+	}
+	board->valid = 1;
+	if (ret == CACHE_PRESENT)
+	{
+		return SMTC_OK;
+	}
+	ret = smtcDev(board);
+	if (ret != SMTC_OK)
+	{
+		board->valid = 0;
+		return ret;
+	}
+	if (OK != i2cMem8Probe(board->dev, REVISION_HW_MAJOR_MEM_ADD, buff, 4))
+	{
+		cacheStoreAbsent(bus, stack);
+		smtcClose(board);
+		return SMTC_ERR_NO_BOARD;
+	}
+	board->hwMajor = buff[0];
+	board->hwMinor = buff[1];
+	board->fwMajor = buff[2];
+	board->fwMinor = buff[3];
+	cacheStore(board, 1);
+	return SMTC_OK;
+}
+
+int smtcClose(SmtcBoardType *board)
+{
+	if (NULL == board || !board->valid)
+	{
+		return SMTC_ERR_ARG;
+	}
+	if (board->dev > 0)
+	{
+		commClose(board->dev);
+	}
+	board->dev = 0;
+	board->valid = 0;
+	return SMTC_OK;
+}
+
+int smtcCardTypeGet(SmtcBoardType *board, int *type)
+{
+	u8 buff;
+	int ret;
+
+	if (NULL == type)
+	{
+		return SMTC_ERR_ARG;
+	}
+	if (board->cardType < 0)
+	{
+		ret = smtcRead(board, TCP_CARD_TYPE, &buff, 1);
+		if (ret != SMTC_OK)
+		{
+			return ret;
+		}
+		board->cardType = buff;
+		cacheStore(board, 0);
+	}
+	*type = board->cardType;
+	return SMTC_OK;
+}
+
+//************************ Discovery ****************************
+
+typedef struct
+{
+	int bus;
+	int count;
+	SmtcTopoType topo[SMTC_STACK_MAX];
+} SmtcScanJobType;
+
+/*
+ * smtcScanBus:
+ *	Probe every stack level on one bus with a single attempt each and
+ *	refresh the topology cache with the result. All the probes go through
+ *	the same bus handle. Fills up to "max" entries in stack order and
+ *	returns the number of cards found or a negative error code.
+ */
+int smtcScanBus(int bus, SmtcTopoType *topo, int max)
+{
+	SmtcBoardType board[SMTC_STACK_MAX];
+	u8 buff[4];
+	int stack;
+	int n = 0;
+	int ret = SMTC_OK;
+
+	if (NULL == topo && max > 0)
+	{
+		return SMTC_ERR_ARG;
+	}
+	for (stack = 0; stack < SMTC_STACK_MAX; stack++)
+	{
+		memset(&board[stack], 0, sizeof(SmtcBoardType));
+		board[stack].valid = 1;
+		board[stack].bus = bus;
+		board[stack].stack = stack;
+		board[stack].cardType = -1;
+		ret = smtcDev(&board[stack]);
+		if (ret != SMTC_OK)
+		{
+			board[stack].valid = 0;
+			break;
+		}
+		if (OK != i2cMem8Probe(board[stack].dev, REVISION_HW_MAJOR_MEM_ADD,
+			buff, 4))
+		{
+			cacheStoreAbsent(bus, stack);
+			continue;
+		}
+		board[stack].hwMajor = buff[0];
+		board[stack].hwMinor = buff[1];
+		board[stack].fwMajor = buff[2];
+		board[stack].fwMinor = buff[3];
+		if (OK == i2cMem8Probe(board[stack].dev, TCP_CARD_TYPE, buff, 1))
+		{
+			board[stack].cardType = buff[0];
+		}
+		cacheStore(&board[stack], 1);
+		if (n < max)
+		{
+			topo[n].bus = bus;
+			topo[n].stack = stack;
+			topo[n].hwMajor = board[stack].hwMajor;
+			topo[n].hwMinor = board[stack].hwMinor;
+			topo[n].fwMajor = board[stack].fwMajor;
+			topo[n].fwMinor = board[stack].fwMinor;
+			topo[n].cardType = board[stack].cardType;
+		}
+		n++;
+	}
+	// closing at the end keeps the bus handle open for the whole scan
+	while (--stack >= 0)
+	{
+		if (board[stack].valid)
+		{
+			smtcClose(&board[stack]);
+		}
+	}
+	return ret == SMTC_OK ? n : ret;
+}
+
+static void* smtcScanThread(void *arg)
+{
+	SmtcScanJobType *job = (SmtcScanJobType*)arg;
+
+	job->count = smtcScanBus(job->bus, job->topo, SMTC_STACK_MAX);
+	return NULL;
+}
+
+/*
+ * smtcScanBuses:
+ *	Scan a list of buses, one thread per bus so the total time is the one
+ *	of the slowest bus. Buses that can not be opened are skipped. Fills up
+ *	to "max" entries ordered as the bus list and by stack level and returns
+ *	the number of cards found.
+ */
+int smtcScanBuses(const int *list, int buses, SmtcTopoType *topo, int max)
+{
+	SmtcScanJobType job[COMM_BUS_MAX];
+	pthread_t thread[COMM_BUS_MAX];
+	int started[COMM_BUS_MAX];
+	int i, j;
+	int n = 0;
+
+	if ( (NULL == topo && max > 0) || (NULL == list && buses > 0)
+		|| buses > COMM_BUS_MAX)
+	{
+		return SMTC_ERR_ARG;
+	}
+	for (i = 0; i < buses; i++)
+	{
+		job[i].bus = list[i];
+		job[i].count = 0;
+		started[i] = 0 == pthread_create(&thread[i], NULL, &smtcScanThread,
+			&job[i]);
+		if (!started[i])
+		{
+			smtcScanThread(&job[i]);
+		}
+	}
+	for (i = 0; i < buses; i++)
+	{
+		if (started[i])
+		{
+			pthread_join(thread[i], NULL);
+		}
+		for (j = 0; j < job[i].count; j++)
+		{
+			if (n < max)
+			{
+				topo[n] = job[i].topo[j];
+			}
+			n++;
+		}
+	}
+	return n;
+}
+
+/*
+ * smtcScanAll:
+ *	Scan every bus the transport can reach
+ */
+int smtcScanAll(SmtcTopoType *topo, int max)
+{
+	int list[COMM_BUS_MAX];
+
+	return smtcScanBuses(list, commBusList(list, COMM_BUS_MAX), topo, max);
+}
+
+//************************ Measurements ****************************
+
+int smtcReadRawAll(SmtcBoardType *board, int16_t raw[SMTC_CH_NR])
+{
+	if (NULL == raw)
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcRead(board, TCP_VAL1_ADD, (u8*)raw, TEMP_DATA_SIZE * SMTC_CH_NR);
+}
+
+int smtcReadRawRange(SmtcBoardType *board, int first, int count, int16_t *raw)
+{
+	if ( (NULL == raw) || !smtcChValid(first, TCP_CH_NR_MAX) || (count < 1)
+		|| (first + count - 1 > TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcRead(board, TCP_VAL1_ADD + TEMP_DATA_SIZE * (first - 1), (u8*)raw,
+		TEMP_DATA_SIZE * count);
+}
+
+int smtcReadAll(SmtcBoardType *board, float temp[SMTC_CH_NR])
+{
+	int16_t raw[SMTC_CH_NR];
+	int ret, i;
+
+	if (NULL == temp)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcReadRawAll(board, raw);
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	for (i = 0; i < SMTC_CH_NR; i++)
+	{
+		temp[i] = (float)raw[i] / TEMP_SCALE_FACTOR;
+	}
+	return SMTC_OK;
+}
+
+static int smtcReadRaw16(SmtcBoardType *board, int add, int16_t *raw)
+{
+	int val, ret;
+
+	if (NULL == raw)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcRead16(board, add, &val, 1);
+	if (ret == SMTC_OK)
+	{
+		*raw = (int16_t)val;
+	}
+	return ret;
+}
+
+int smtcReadRaw(SmtcBoardType *board, int ch, int16_t *raw)
+{
+	if (!smtcChValid(ch, TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcReadRaw16(board, TCP_VAL1_ADD + TEMP_DATA_SIZE * (ch - 1), raw);
+}
+
+int smtcReadTemp(SmtcBoardType *board, int ch, float *temp)
+{
+	int16_t raw;
+	int ret;
+
+	if (NULL == temp)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcReadRaw(board, ch, &raw);
+	if (ret == SMTC_OK)
+	{
+		*temp = (float)raw / TEMP_SCALE_FACTOR;
+	}
+	return ret;
+}
+
+int smtcReadMvRawAll(SmtcBoardType *board, int16_t raw[SMTC_CH_NR])
+{
+	if (NULL == raw)
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcRead(board, TCP_MV1_ADD, (u8*)raw, MV_DATA_SIZE * SMTC_CH_NR);
+}
+
+int smtcReadMvRawRange(SmtcBoardType *board, int first, int count, int16_t *raw)
+{
+	if ( (NULL == raw) || !smtcChValid(first, TCP_CH_NR_MAX) || (count < 1)
+		|| (first + count - 1 > TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcRead(board, TCP_MV1_ADD + MV_DATA_SIZE * (first - 1), (u8*)raw,
+		MV_DATA_SIZE * count);
+}
+
+int smtcReadMvAll(SmtcBoardType *board, float mv[SMTC_CH_NR])
+{
+	int16_t raw[SMTC_CH_NR];
+	int ret, i;
+
+	if (NULL == mv)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcReadMvRawAll(board, raw);
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	for (i = 0; i < SMTC_CH_NR; i++)
+	{
+		mv[i] = (float)raw[i] / MV_SCALE_FACTOR;
+	}
+	return SMTC_OK;
+}
+
+int smtcReadMvRaw(SmtcBoardType *board, int ch, int16_t *raw)
+{
+	if (!smtcChValid(ch, TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcReadRaw16(board, TCP_MV1_ADD + MV_DATA_SIZE * (ch - 1), raw);
+}
+
+int smtcReadMv(SmtcBoardType *board, int ch, float *mv)
+{
+	int16_t raw;
+	int ret;
+
+	if (NULL == mv)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcReadMvRaw(board, ch, &raw);
+	if (ret == SMTC_OK)
+	{
+		*mv = (float)raw / MV_SCALE_FACTOR;
+	}
+	return ret;
+}
+
+int smtcReadConnRaw(SmtcBoardType *board, int ch, int16_t *raw)
+{
+	if (!smtcChValid(ch, TCP_THERMISTORS_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcReadRaw16(board, I2C_THERMISTOR1_ADD + 2 * (ch - 1), raw);
+}
+
+int smtcReadConnTemp(SmtcBoardType *board, int ch, float *temp)
+{
+	int16_t raw;
+	int ret;
+
+	if (NULL == temp)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcReadConnRaw(board, ch, &raw);
+	if (ret == SMTC_OK)
+	{
+		*temp = (float)raw / SMTC_TEMP_SCALE;
+	}
+	return ret;
+}
+
+//************************ Sensor type and filter ****************************
+
+int smtcTypesGet(SmtcBoardType *board, uint8_t types[SMTC_CH_NR])
+{
+	int ret;
+
+	if (NULL == board || NULL == types)
+	{
+		return SMTC_ERR_ARG;
+	}
+	if (!board->typesValid)
+	{
+		ret = smtcRead(board, TCP_TYPE1, board->types, SMTC_CH_NR);
+		if (ret != SMTC_OK)
+		{
+			return ret;
+		}
+		board->typesValid = 1;
+		cacheStore(board, 0);
+	}
+	memcpy(types, board->types, SMTC_CH_NR);
+	return SMTC_OK;
+}
+
+int smtcTypesSet(SmtcBoardType *board, const uint8_t types[SMTC_CH_NR])
+{
+	u8 buff[SMTC_CH_NR];
+	int ret, i;
+
+	if (NULL == board || NULL == types)
+	{
+		return SMTC_ERR_ARG;
+	}
+	for (i = 0; i < SMTC_CH_NR; i++)
+	{
+		if (types[i] > TC_TYPE_T)
+		{
+			return SMTC_ERR_ARG;
+		}
+	}
+	memcpy(buff, types, SMTC_CH_NR);
+	ret = smtcWrite(board, TCP_TYPE1, buff, SMTC_CH_NR);
+	if (ret == SMTC_OK)
+	{
+		memcpy(board->types, types, SMTC_CH_NR);
+		board->typesValid = 1;
+		cacheStore(board, 0);
+	}
+	return ret;
+}
+
+int smtcTypeGet(SmtcBoardType *board, int ch, int *type)
+{
+	u8 types[SMTC_CH_NR];
+	int ret;
+
+	if (NULL == type || !smtcChValid(ch, TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcTypesGet(board, types);
+	if (ret == SMTC_OK)
+	{
+		*type = types[ch - 1];
+	}
+	return ret;
+}
+
+int smtcTypeSet(SmtcBoardType *board, int ch, int type)
+{
+	u8 buff;
+	int ret;
+
+	if (NULL == board || type < TC_TYPE_B || type > TC_TYPE_T
+		|| !smtcChValid(ch, TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	buff = (u8)type;
+	ret = smtcWrite(board, TCP_TYPE1 + ch - 1, &buff, 1);
+	if (ret == SMTC_OK)
+	{
+		board->types[ch - 1] = buff;
+		cacheStore(board, 0);
+	}
+	return ret;
+}
+
+int smtcFilterSizeGet(SmtcBoardType *board, int *size)
+{
+	u8 buff;
+	int ret;
+
+	if (NULL == size)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcRead(board, I2C_MAV_FILT_SIZE, &buff, 1);
+	if (ret == SMTC_OK)
+	{
+		*size = buff;
+	}
+	return ret;
+}
+
+int smtcFilterSizeSet(SmtcBoardType *board, int size)
+{
+	u8 buff;
+
+	if (size < FILT_SIZE_MIN || size > FILT_SIZE_MAX)
+	{
+		return SMTC_ERR_ARG;
+	}
+	buff = 0xff & size;
+	return smtcWrite(board, I2C_MAV_FILT_SIZE, &buff, 1);
+}
+
+//************************ LED's ****************************
+
+int smtcLedModeGet(SmtcBoardType *board, int ch, int *mode)
+{
+	int val, ret;
+
+	if (NULL == mode || !smtcChValid(ch, TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcRead16(board, TCP_LEDS_FUNC, &val, 0);
+	if (ret == SMTC_OK)
+	{
+		*mode = 0x03 & (val >> (2 * (ch - 1)));
+	}
+	return ret;
+}
+
+/*
+ * smtcLedModeSet:
+ *	The modes of all the channels share one register, the read and the
+ *	write hold the bus so a concurrent change of another channel is not
+ *	lost
+ */
+int smtcLedModeSet(SmtcBoardType *board, int ch, int mode)
+{
+	int val, ret;
+
+	if (NULL == board || (mode > SMTC_LED_BELOW) || (mode < SMTC_LED_OFF)
+		|| !smtcChValid(ch, TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcDev(board);
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	commLockAtomic(board->bus);
+	ret = smtcRead16(board, TCP_LEDS_FUNC, &val, 0);
+	if (ret == SMTC_OK)
+	{
+		val &= ~ ((u16)0x03 << (2 * (ch - 1)));
+		val += mode << (2 * (ch - 1));
+		ret = smtcWrite16(board, TCP_LEDS_FUNC, val);
+	}
+	commUnlockAtomic(board->bus);
+	return ret;
+}
+
+int smtcLedThresholdGet(SmtcBoardType *board, int ch, int *threshold)
+{
+	if (NULL == threshold || !smtcChValid(ch, TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcRead16(board, TCP_LED_THRESHOLD1 + 2 * (ch - 1), threshold, 1);
+}
+
+int smtcLedThresholdSet(SmtcBoardType *board, int ch, int threshold)
+{
+	if ( (threshold < LED_THRESHOLD_MIN) || (threshold > LED_THRESHOLD_MAX)
+		|| !smtcChValid(ch, TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcWrite16(board, TCP_LED_THRESHOLD1 + 2 * (ch - 1), threshold);
+}
+
+//************************ Watchdog ****************************
+
+int smtcWdtReload(SmtcBoardType *board)
+{
+	u8 buff = WDT_RESET_SIGNATURE;
+
+	return smtcWrite(board, I2C_MEM_WDT_RESET_ADD, &buff, 1);
+}
+
+int smtcWdtPeriodGet(SmtcBoardType *board, int *sec)
+{
+	return smtcRead16(board, I2C_MEM_WDT_INTERVAL_GET_ADD, sec, 0);
+}
+
+int smtcWdtPeriodSet(SmtcBoardType *board, int sec)
+{
+	if (sec <= 0 || sec > 0xffff)
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcWrite16(board, I2C_MEM_WDT_INTERVAL_SET_ADD, sec);
+}
+
+int smtcWdtInitPeriodGet(SmtcBoardType *board, int *sec)
+{
+	return smtcRead16(board, I2C_MEM_WDT_INIT_INTERVAL_GET_ADD, sec, 0);
+}
+
+int smtcWdtInitPeriodSet(SmtcBoardType *board, int sec)
+{
+	if (sec <= 0 || sec > 0xffff)
+	{
+		return SMTC_ERR_ARG;
+	}
+	return smtcWrite16(board, I2C_MEM_WDT_INIT_INTERVAL_SET_ADD, sec);
+}
+
+int smtcWdtOffPeriodGet(SmtcBoardType *board, int *sec)
+{
+	u8 buff[4];
+	u32 period;
+	int ret;
+
+	if (NULL == sec)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcRead(board, I2C_MEM_WDT_POWER_OFF_INTERVAL_GET_ADD, buff, 4);
+	if (ret == SMTC_OK)
+	{
+		memcpy(&period, buff, 4);
+		*sec = (int)period;
+	}
+	return ret;
+}
+
+int smtcWdtOffPeriodSet(SmtcBoardType *board, int sec)
+{
+	u8 buff[4];
+	u32 period = (u32)sec;
+
+	if (sec <= 0 || period > WDT_MAX_OFF_INTERVAL_S)
+	{
+		return SMTC_ERR_ARG;
+	}
+	memcpy(buff, &period, 4);
+	return smtcWrite(board, I2C_MEM_WDT_POWER_OFF_INTERVAL_SET_ADD, buff, 4);
+}
+
+int smtcWdtResetCountGet(SmtcBoardType *board, int *count)
+{
+	return smtcRead16(board, I2C_MEM_WDT_RESET_COUNT_ADD, count, 0);
+}
+
+int smtcWdtResetCountClear(SmtcBoardType *board)
+{
+	u8 buff = WDT_RESET_COUNT_SIGNATURE;
+
+	return smtcWrite(board, I2C_MEM_WDT_CLEAR_RESET_COUNT_ADD, &buff, 1);
+}
+
+//************************ RS485 ****************************
+
+int smtcRs485Get(SmtcBoardType *board, SmtcRs485Type *cfg)
+{
+	ModbusSetingsType settings;
+	u8 buff[sizeof(ModbusSetingsType)];
+	int ret;
+
+	if (NULL == cfg)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcRead(board, I2C_MODBUS_SETINGS_ADD, buff, sizeof(buff));
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	memcpy(&settings, buff, sizeof(ModbusSetingsType));
+	cfg->mode = settings.mbType;
+	cfg->baud = settings.mbBaud;
+	cfg->stopBits = settings.mbStopB;
+	cfg->parity = settings.mbParity;
+	cfg->address = settings.add;
+	return SMTC_OK;
+}
+
+int smtcRs485Set(SmtcBoardType *board, const SmtcRs485Type *cfg)
+{
+	ModbusSetingsType settings;
+
+	if (NULL == cfg || cfg->mode < 0 || cfg->mode > 1 || cfg->baud < 1200
+		|| cfg->baud > 921600 || cfg->stopBits < 1 || cfg->stopBits > 2
+		|| cfg->parity < 0 || cfg->parity > 2 || cfg->address < 1
+		|| cfg->address > 254)
+	{
+		return SMTC_ERR_ARG;
+	}
+	memset(&settings, 0, sizeof(settings));
+	settings.mbType = cfg->mode;
+	settings.mbBaud = cfg->baud;
+	settings.mbStopB = cfg->stopBits;
+	settings.mbParity = cfg->parity;
+	settings.add = cfg->address;
+	return smtcWrite(board, I2C_MODBUS_SETINGS_ADD, (u8*)&settings,
+		sizeof(ModbusSetingsType));
+}
+
+//************************ Diagnostics and calibration ****************************
+
+int smtcDiagGet(SmtcBoardType *board, SmtcDiagType *diag)
+{
+	u8 buff[3];
+	s8 temp;
+	u16 mv;
+	int ret;
+
+	if (NULL == diag)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcRead(board, DIAG_TEMPERATURE_MEM_ADD, buff, 3);
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	memcpy(&temp, buff, 1);
+	memcpy(&mv, &buff[1], 2);
+	diag->cpuTemp = temp;
+	diag->supply5V = (float)mv / 1000;
+	return SMTC_OK;
+}
+
+/*
+ * smtcAdcGet:
+ *	ADC reinit counter and sample rates, one block read
+ */
+int smtcAdcGet(SmtcBoardType *board, SmtcAdcType *adc)
+{
+	u8 buff[8];
+	u32 reinit;
+	u16 sps[2];
+	int ret;
+
+	if (NULL == adc)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcRead(board, TCP_REINIT_COUNT, buff, 8);
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	memcpy(&reinit, buff, 4);
+	memcpy(sps, &buff[4], 4);
+	adc->reinit = reinit;
+	adc->sps[0] = sps[0];
+	adc->sps[1] = sps[1];
+	return SMTC_OK;
+}
+
+/*
+ * smtcDiagRawGet:
+ *	All the health registers in two block reads: CPU temperature and 5V
+ *	rail, then ADC reinit counter, sample rates, card type and Raspberry
+ *	supply
+ */
+int smtcDiagRawGet(SmtcBoardType *board, SmtcDiagRawType *diag)
+{
+	u8 buff[TCP_RASP_VOLT + 2 - TCP_REINIT_COUNT];
+	s8 temp;
+	u16 mv;
+	u32 reinit;
+	int ret;
+
+	if (NULL == diag)
+	{
+		return SMTC_ERR_ARG;
+	}
+	ret = smtcRead(board, DIAG_TEMPERATURE_MEM_ADD, buff, 3);
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	memcpy(&temp, buff, 1);
+	memcpy(&mv, &buff[1], 2);
+	diag->cpuTemp = temp;
+	diag->supply5vMv = mv;
+	ret = smtcRead(board, TCP_REINIT_COUNT, buff, sizeof(buff));
+	if (ret != SMTC_OK)
+	{
+		return ret;
+	}
+	memcpy(&reinit, buff, 4);
+	diag->adc.reinit = reinit;
+	memcpy(&mv, &buff[TCP_SPS1_ADD - TCP_REINIT_COUNT], 2);
+	diag->adc.sps[0] = mv;
+	memcpy(&mv, &buff[TCP_SPS2_ADD - TCP_REINIT_COUNT], 2);
+	diag->adc.sps[1] = mv;
+	memcpy(&mv, &buff[TCP_RASP_VOLT - TCP_REINIT_COUNT], 2);
+	diag->raspMv = mv;
+	return SMTC_OK;
+}
+
+int smtcCalibSet(SmtcBoardType *board, int ch, float value)
+{
+	u8 buff[sizeof(float) + 1];
+
+	if ( (value < 0) || (value > 4000) || !smtcChValid(ch, TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	memcpy(buff, &value, sizeof(float));
+	buff[sizeof(float)] = ch;
+	return smtcWrite(board, I2C_CALIB_RES, buff, sizeof(float) + 1);
+}
+
+int smtcCalibReset(SmtcBoardType *board, int ch)
+{
+	u8 buff[sizeof(float) + 1];
+	float value = -1;
+
+	if (!smtcChValid(ch, TCP_CH_NR_MAX))
+	{
+		return SMTC_ERR_ARG;
+	}
+	memcpy(buff, &value, sizeof(float));
+	buff[sizeof(float)] = ch;
+	return smtcWrite(board, I2C_CALIB_RES, buff, sizeof(float) + 1);
+}
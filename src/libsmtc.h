@@ -0,0 +1,155 @@
+/*
+ * libsmtc.h:
+ *	Library interface to the Sequent Microsystems Eight Thermocouples
+ *	DAQ card. All the functions take a board handle opened with
+ *	smtcOpen() and return SMTC_OK or a negative SMTC_ERR_xxx code; none of
+ *	them prints or exits. Different handles may be used from different
+ *	threads, one handle must not be used by two threads at the same time.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#ifndef LIBSMTC_H_
+#define LIBSMTC_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SMTC_CH_NR			8
+#define SMTC_THERMISTOR_NR	10
+#define SMTC_STACK_MAX		8
+#define SMTC_TEMP_SCALE		10 // raw temperatures are in 0.1 deg C
+#define SMTC_MV_SCALE		100 // raw voltages are in 0.01 mV
+#define SMTC_ADC_CH_NR		4 // channels converted in turn by each of the two ADCs
+
+#define SMTC_OK				0
+#define SMTC_ERR_BUS		-1
+#define SMTC_ERR_ARG		-2
+#define SMTC_ERR_NO_BOARD	-4
+#define SMTC_ERR_OPEN		-5
+
+#define SMTC_LED_OFF		0
+#define SMTC_LED_ABOVE		1
+#define SMTC_LED_BELOW		2
+
+typedef struct
+{
+	int valid; // set by smtcOpen, the bus itself is opened on first access
+	int dev;
+	int bus;
+	int stack;
+	uint8_t hwMajor;
+	uint8_t hwMinor;
+	uint8_t fwMajor;
+	uint8_t fwMinor;
+	int cardType; // -1 until read
+	int typesValid;
+	uint8_t types[SMTC_CH_NR];
+} SmtcBoardType;
+
+typedef struct
+{
+	int bus;
+	int stack;
+	uint8_t hwMajor;
+	uint8_t hwMinor;
+	uint8_t fwMajor;
+	uint8_t fwMinor;
+	int cardType; // -1 if the read failed
+} SmtcTopoType;
+
+typedef struct
+{
+	int cpuTemp; // deg C
+	float supply5V; // V
+} SmtcDiagType;
+
+typedef struct
+{
+	uint32_t reinit; // ADC reinitializations since power up
+	int sps[2]; // samples per second of the two ADCs
+} SmtcAdcType;
+
+typedef struct
+{
+	int cpuTemp; // deg C
+	int supply5vMv; // 5V rail, mV
+	int raspMv; // Raspberry supply, mV
+	SmtcAdcType adc;
+} SmtcDiagRawType;
+
+typedef struct
+{
+	int mode; // 0 - RS485 free for the Raspberry, 1 - Modbus RTU
+	int baud;
+	int stopBits;
+	int parity;
+	int address;
+} SmtcRs485Type;
+
+const char* smtcStrError(int err);
+
+int smtcOpen(SmtcBoardType *board, int bus, int stack);
+int smtcClose(SmtcBoardType *board);
+int smtcCardTypeGet(SmtcBoardType *board, int *type);
+
+int smtcScanBus(int bus, SmtcTopoType *topo, int max);
+int smtcScanBuses(const int *list, int buses, SmtcTopoType *topo, int max);
+int smtcScanAll(SmtcTopoType *topo, int max);
+
+int smtcReadTemp(SmtcBoardType *board, int ch, float *temp);
+int smtcReadAll(SmtcBoardType *board, float temp[SMTC_CH_NR]);
+int smtcReadRawAll(SmtcBoardType *board, int16_t raw[SMTC_CH_NR]);
+int smtcReadRawRange(SmtcBoardType *board, int first, int count, int16_t *raw);
+int smtcReadMv(SmtcBoardType *board, int ch, float *mv);
+int smtcReadMvAll(SmtcBoardType *board, float mv[SMTC_CH_NR]);
+int smtcReadMvRawAll(SmtcBoardType *board, int16_t raw[SMTC_CH_NR]);
+int smtcReadMvRawRange(SmtcBoardType *board, int first, int count, int16_t *raw);
+int smtcReadConnTemp(SmtcBoardType *board, int ch, float *temp);
+int smtcReadRaw(SmtcBoardType *board, int ch, int16_t *raw);
+int smtcReadMvRaw(SmtcBoardType *board, int ch, int16_t *raw);
+int smtcReadConnRaw(SmtcBoardType *board, int ch, int16_t *raw);
+
+int smtcTypeGet(SmtcBoardType *board, int ch, int *type);
+int smtcTypeSet(SmtcBoardType *board, int ch, int type);
+int smtcTypesGet(SmtcBoardType *board, uint8_t types[SMTC_CH_NR]);
+int smtcTypesSet(SmtcBoardType *board, const uint8_t types[SMTC_CH_NR]);
+
+int smtcFilterSizeGet(SmtcBoardType *board, int *size);
+int smtcFilterSizeSet(SmtcBoardType *board, int size);
+
+int smtcLedModeGet(SmtcBoardType *board, int ch, int *mode);
+int smtcLedModeSet(SmtcBoardType *board, int ch, int mode);
+int smtcLedThresholdGet(SmtcBoardType *board, int ch, int *threshold);
+int smtcLedThresholdSet(SmtcBoardType *board, int ch, int threshold);
+
+int smtcWdtReload(SmtcBoardType *board);
+int smtcWdtPeriodGet(SmtcBoardType *board, int *sec);
+int smtcWdtPeriodSet(SmtcBoardType *board, int sec);
+int smtcWdtInitPeriodGet(SmtcBoardType *board, int *sec);
+int smtcWdtInitPeriodSet(SmtcBoardType *board, int sec);
+int smtcWdtOffPeriodGet(SmtcBoardType *board, int *sec);
+int smtcWdtOffPeriodSet(SmtcBoardType *board, int sec);
+int smtcWdtResetCountGet(SmtcBoardType *board, int *count);
+int smtcWdtResetCountClear(SmtcBoardType *board);
+
+int smtcRs485Get(SmtcBoardType *board, SmtcRs485Type *cfg);
+int smtcRs485Set(SmtcBoardType *board, const SmtcRs485Type *cfg);
+
+int smtcDiagGet(SmtcBoardType *board, SmtcDiagType *diag);
+int smtcAdcGet(SmtcBoardType *board, SmtcAdcType *adc);
+int smtcDiagRawGet(SmtcBoardType *board, SmtcDiagRawType *diag);
+int smtcCalibSet(SmtcBoardType *board, int ch, float value);
+int smtcCalibReset(SmtcBoardType *board, int ch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBSMTC_H_
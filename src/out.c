@@ -0,0 +1,207 @@
+/*
+ * out.c:
+ *	Command output in the format selected with --format: text (the values
+ *	only, space separated), one JSON object or one CSV line per record, or
+ *	packed binary. Numbers are formatted from integers, the values read as
+ *	fixed point from the card are never converted to float and back.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "out.h"
+
+#define OUT_BUFF_SIZE	1024
+#define OUT_FIELDS_MAX	64
+
+static int gOutFormat = OUT_TEXT;
+static char gOutBuff[OUT_BUFF_SIZE];
+static int gOutLen = 0;
+static int gOutFields = 0;
+static int32_t gOutBin[OUT_FIELDS_MAX];
+
+static const char *gOutNames[] = {"text", "json", "csv", "bin"};
+
+/*
+ * outFormatSet:
+ *	Select the output format by name, returns 0 or -1 for an unknown name
+ */
+int outFormatSet(const char *name)
+{
+	int i;
+
+	for (i = 0; i <= OUT_BIN; i++)
+	{
+		if (0 == strcmp(name, gOutNames[i]))
+		{
+			gOutFormat = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int outFormat(void)
+{
+	return gOutFormat;
+}
+
+static void outPut(const char *s, int len)
+{
+	if (gOutLen + len < OUT_BUFF_SIZE)
+	{
+		memcpy(gOutBuff + gOutLen, s, len);
+		gOutLen += len;
+	}
+}
+
+/*
+ * outNum:
+ *	Decimal formatting of val / 10^decimals, "-12.5" for (-125, 1)
+ */
+static void outNum(int64_t val, int decimals)
+{
+	char buff[24];
+	char *p = buff + sizeof(buff);
+	uint64_t u = val < 0 ? 0u - (uint64_t)val : (uint64_t)val;
+	int digits = 0;
+
+	do
+	{
+		*--p = (char)('0' + u % 10);
+		u /= 10;
+		if (++digits == decimals)
+		{
+			*--p = '.';
+		}
+	}
+	while (u != 0 || digits <= decimals);
+	if (val < 0)
+	{
+		*--p = '-';
+	}
+	outPut(p, (int)(buff + sizeof(buff) - p));
+}
+
+static void outKey(const char *key)
+{
+	if (gOutFields > 0)
+	{
+		outPut(gOutFormat == OUT_TEXT ? " " : ",", 1);
+	}
+	if (gOutFormat == OUT_JSON)
+	{
+		outPut("\"", 1);
+		outPut(key, (int)strlen(key));
+		outPut("\":", 2);
+	}
+}
+
+static void outField(const char *key, int val, int decimals)
+{
+	if (gOutFormat == OUT_BIN)
+	{
+		if (gOutFields < OUT_FIELDS_MAX)
+		{
+			gOutBin[gOutFields++] = (int32_t)val;
+		}
+		return;
+	}
+	outKey(key);
+	outNum(val, decimals);
+	gOutFields++;
+}
+
+void outBegin(void)
+{
+	gOutLen = 0;
+	gOutFields = 0;
+	if (gOutFormat == OUT_JSON)
+	{
+		outPut("{", 1);
+	}
+}
+
+/*
+ * outTag:
+ *	Field identifying the record (bus, card, channel), left out of the
+ *	text format where the caller knows what it asked for
+ */
+void outTag(const char *key, int val)
+{
+	if (gOutFormat != OUT_TEXT)
+	{
+		outField(key, val, 0);
+	}
+}
+
+void outInt(const char *key, int val)
+{
+	outField(key, val, 0);
+}
+
+/*
+ * outLong:
+ *	64 bit integer, two fields (low and high 32 bits) in the binary format
+ */
+void outLong(const char *key, int64_t val)
+{
+	if (gOutFormat == OUT_BIN)
+	{
+		outField(key, (int32_t) (uint32_t)val, 0);
+		outField(key, (int32_t) (val >> 32), 0);
+		return;
+	}
+	outKey(key);
+	outNum(val, 0);
+	gOutFields++;
+}
+
+/*
+ * outFixed:
+ *	Fixed point value val / 10^decimals. The binary format keeps the
+ *	integer, the scale is part of the record definition.
+ */
+void outFixed(const char *key, int val, int decimals)
+{
+	outField(key, val, decimals);
+}
+
+/*
+ * outEnd:
+ *	Write the record. A binary record is a one byte field count followed by
+ *	the fields as little endian 32 bit integers.
+ */
+void outEnd(void)
+{
+	uint8_t b[4];
+	int i;
+
+	if (gOutFormat == OUT_BIN)
+	{
+		b[0] = (uint8_t)gOutFields;
+		fwrite(b, 1, 1, stdout);
+		for (i = 0; i < gOutFields; i++)
+		{
+			b[0] = (uint8_t)gOutBin[i];
+			b[1] = (uint8_t) (gOutBin[i] >> 8);
+			b[2] = (uint8_t) (gOutBin[i] >> 16);
+			b[3] = (uint8_t) (gOutBin[i] >> 24);
+			fwrite(b, 1, 4, stdout);
+		}
+		return;
+	}
+	if (gOutFormat == OUT_JSON)
+	{
+		outPut("}", 1);
+	}
+	outPut("\n", 1);
+	fwrite(gOutBuff, 1, gOutLen, stdout);
+}
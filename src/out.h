@@ -0,0 +1,24 @@
+#ifndef OUT_H_
+#define OUT_H_
+
+#include <stdint.h>
+
+enum
+{
+	OUT_TEXT = 0,
+	OUT_JSON,
+	OUT_CSV,
+	OUT_BIN
+};
+
+int outFormatSet(const char *name);
+int outFormat(void);
+
+void outBegin(void);
+void outTag(const char *key, int val);
+void outInt(const char *key, int val);
+void outLong(const char *key, int64_t val);
+void outFixed(const char *key, int val, int decimals);
+void outEnd(void);
+
+#endif //OUT_H_
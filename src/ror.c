@@ -0,0 +1,218 @@
+/*
+ * ror.c:
+ *	Rate of rise detector for thermal runaway: the rate of a channel is the
+ *	least squares slope of its reads over a sliding window, kept as running
+ *	sums updated when a read enters or leaves the window, so each read costs
+ *	the same whatever the window. Reads closer than the window over
+ *	ROR_SAMPLES_MAX are averaged into one point, so the window is always
+ *	covered at any period. The alarm is raised when the rate stays
+ *	above the limit for a minimum time and cleared below the limit minus the
+ *	hysteresis.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "libsmtc.h"
+#include "ror.h"
+
+#define ROR_REBASE_MS	(1 << 24) // keeps the sums of squares far from overflow
+
+void rorInit(RorCfgType *cfg)
+{
+	memset(cfg, 0, sizeof(RorCfgType));
+}
+
+int rorActive(const RorCfgType *cfg)
+{
+	return cfg->rate > 0;
+}
+
+void rorStateInit(RorStateType *st)
+{
+	memset(st, 0, sizeof(RorStateType));
+	st->aboveMs = -1;
+}
+
+static void rorSums(RorStateType *st, int32_t t, int16_t v, int sign)
+{
+	st->st += sign * (int64_t)t;
+	st->sv += sign * (int64_t)v;
+	st->stt += sign * (int64_t)t * t;
+	st->stv += sign * (int64_t)t * v;
+}
+
+/*
+ * rorRebase:
+ *	Move the time origin to the oldest read of the window, a few hours
+ *	apart, the only step that walks the window
+ */
+static void rorRebase(RorStateType *st, int64_t ms)
+{
+	int32_t delta;
+	uint32_t i;
+
+	delta = st->head != st->tail ? st->t[st->tail % ROR_SAMPLES_MAX]
+		: (int32_t) (ms - st->baseMs);
+	st->baseMs += delta;
+	st->st = st->sv = st->stt = st->stv = 0;
+	for (i = st->tail; i != st->head; i++)
+	{
+		st->t[i % ROR_SAMPLES_MAX] -= delta;
+		rorSums(st, st->t[i % ROR_SAMPLES_MAX], st->v[i % ROR_SAMPLES_MAX], 1);
+	}
+}
+
+/*
+ * rorStep:
+ *	Shortest time between two points of the window, ROR_SAMPLES_MAX - 1
+ *	of them cover it
+ */
+static int64_t rorStep(const RorCfgType *cfg)
+{
+	return ( (int64_t)cfg->windowMs + ROR_SAMPLES_MAX - 3) / (ROR_SAMPLES_MAX - 2);
+}
+
+/*
+ * rorUpdate:
+ *	Account a read taken at tUs (monotonic), "rate" gets the rate over the
+ *	window in deg C per minute. Returns ROR_ON or ROR_OFF when the alarm
+ *	changes, ROR_NONE otherwise.
+ */
+int rorUpdate(const RorCfgType *cfg, RorStateType *st, int16_t val,
+	uint64_t tUs, float *rate)
+{
+	int64_t ms = (int64_t) (tUs / 1000);
+	int32_t t, oldest;
+	uint32_t n, slot;
+	double den;
+
+	st->binMs += ms;
+	st->binV += val;
+	st->binN++;
+	if (st->head != st->tail && ms - st->pushMs < rorStep(cfg))
+	{
+		*rate = st->rate;
+		return ROR_NONE; // averaged into the next point
+	}
+	st->pushMs = ms;
+	val = (int16_t)lrint( (double)st->binV / st->binN);
+	ms = st->binMs / st->binN;
+	st->binMs = st->binV = 0;
+	st->binN = 0;
+
+	if (st->head == st->tail && st->baseMs == 0)
+	{
+		st->baseMs = ms;
+	}
+	if (ms - st->baseMs >= ROR_REBASE_MS)
+	{
+		rorRebase(st, ms);
+	}
+	t = (int32_t) (ms - st->baseMs);
+	while (st->head != st->tail
+		&& (st->head - st->tail == ROR_SAMPLES_MAX
+			|| t - st->t[st->tail % ROR_SAMPLES_MAX] > (int32_t)cfg->windowMs))
+	{
+		slot = st->tail % ROR_SAMPLES_MAX;
+		rorSums(st, st->t[slot], st->v[slot], -1);
+		st->tail++;
+	}
+	slot = st->head % ROR_SAMPLES_MAX;
+	st->t[slot] = t;
+	st->v[slot] = val;
+	st->head++;
+	rorSums(st, t, val, 1);
+
+	*rate = st->rate = 0;
+	n = st->head - st->tail;
+	oldest = st->t[st->tail % ROR_SAMPLES_MAX];
+	if (n < 3 || (uint32_t) (t - oldest) < cfg->windowMs / 2)
+	{
+		return ROR_NONE; // not enough of the window yet
+	}
+	den = (double)n * st->stt - (double)st->st * st->st;
+	if (den <= 0)
+	{
+		return ROR_NONE;
+	}
+	// raw units per ms to deg C per minute
+	*rate = (float) ( ( (double)n * st->stv - (double)st->st * st->sv) / den
+		* 60000 / SMTC_TEMP_SCALE);
+	st->rate = *rate;
+
+	if (*rate >= cfg->rate)
+	{
+		if (st->aboveMs < 0)
+		{
+			st->aboveMs = ms;
+		}
+		if (!st->active && ms - st->aboveMs >= cfg->minMs)
+		{
+			st->active = 1;
+			return ROR_ON;
+		}
+		return ROR_NONE;
+	}
+	st->aboveMs = -1;
+	if (st->active && *rate < cfg->rate - cfg->hyst)
+	{
+		st->active = 0;
+		return ROR_OFF;
+	}
+	return ROR_NONE;
+}
+
+/*
+ * rorParse:
+ *	"[<ch>[-<ch>]=]<deg/min>[:<window s>[:<min s>[:<hyst deg/min>]]]" on
+ *	every channel or on some channels (1 based). The hysteresis defaults to
+ *	a quarter of the rate. Returns 0 or -1 for a bad spec.
+ */
+int rorParse(const char *spec, RorCfgType *cfg, int channels)
+{
+	const char *p;
+	float rate, window = ROR_DEFAULT_WINDOW_S, min = ROR_DEFAULT_MIN_S;
+	float hyst = -1;
+	int first = 1, last = channels;
+	int ch;
+
+	p = strchr(spec, '=');
+	if (NULL != p)
+	{
+		if (2 != sscanf(spec, "%d-%d=", &first, &last))
+		{
+			first = last = atoi(spec);
+		}
+		if (first < 1 || last > channels || first > last)
+		{
+			return -1;
+		}
+		spec = p + 1;
+	}
+	if (sscanf(spec, "%f:%f:%f:%f", &rate, &window, &min, &hyst) < 1
+		|| rate <= 0 || window <= 0 || min < 0)
+	{
+		return -1;
+	}
+	if (hyst < 0)
+	{
+		hyst = rate / 4;
+	}
+	for (ch = first; ch <= last; ch++)
+	{
+		cfg[ch - 1].rate = rate;
+		cfg[ch - 1].hyst = hyst;
+		cfg[ch - 1].windowMs = (uint32_t) (window * 1000);
+		cfg[ch - 1].minMs = (uint32_t) (min * 1000);
+	}
+	return 0;
+}
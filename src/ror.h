@@ -0,0 +1,52 @@
+#ifndef ROR_H_
+#define ROR_H_
+
+#include <stdint.h>
+
+#define ROR_SAMPLES_MAX			1024 // points kept per channel, faster reads are averaged
+#define ROR_DEFAULT_WINDOW_S	60
+#define ROR_DEFAULT_MIN_S		10
+
+enum
+{
+	ROR_NONE = 0,
+	ROR_ON,
+	ROR_OFF
+};
+
+typedef struct
+{
+	float rate; // deg C per minute that raises the alarm, 0 - off
+	float hyst; // the alarm clears below rate - hyst
+	uint32_t windowMs; // the rate is the slope over this window
+	uint32_t minMs; // the rate must stay above this long
+} RorCfgType;
+
+typedef struct
+{
+	int32_t t[ROR_SAMPLES_MAX]; // ms after baseMs
+	int16_t v[ROR_SAMPLES_MAX];
+	int64_t binMs; // sum of the times of the reads not in the window yet
+	int64_t binV;
+	uint32_t binN;
+	int64_t pushMs; // a point was added to the window at
+	float rate; // of the last point
+	uint32_t head;
+	uint32_t tail;
+	int64_t baseMs;
+	int64_t st; // running sums of the window
+	int64_t sv;
+	int64_t stt;
+	int64_t stv;
+	int active;
+	int64_t aboveMs; // the rate went above at, -1 - it is below
+} RorStateType;
+
+void rorInit(RorCfgType *cfg);
+int rorActive(const RorCfgType *cfg);
+void rorStateInit(RorStateType *st);
+int rorUpdate(const RorCfgType *cfg, RorStateType *st, int16_t val,
+	uint64_t tUs, float *rate);
+int rorParse(const char *spec, RorCfgType *cfg, int channels);
+
+#endif //ROR_H_
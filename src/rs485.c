@@ -4,23 +4,32 @@
 #include <string.h>
 
 #include "rs485.h"
-#include "comm.h"
+#include "libsmtc.h"
+#include "out.h"
 
 
-int cfg485Get(int dev)
+int cfg485Get(SmtcBoardType *board)
 {
-	ModbusSetingsType settings;
-	u8 buff[5];
+	SmtcRs485Type cfg;
 
-	if (OK != i2cMem8Read(dev, I2C_MODBUS_SETINGS_ADD, buff, 5))
+	if (SMTC_OK != smtcRs485Get(board, &cfg))
 	{
 		printf("Fail to read RS485 settings!\n");
 		return ERROR;
 	}
-	memcpy(&settings, buff, sizeof(ModbusSetingsType));
+	if (outFormat() != OUT_TEXT)
+	{
+		doOutBoard(board);
+		outInt("mode", cfg.mode);
+		outInt("baud", cfg.baud);
+		outInt("stop_bits", cfg.stopBits);
+		outInt("parity", cfg.parity);
+		outInt("address", cfg.address);
+		outEnd();
+		return OK;
+	}
 	printf("<mode> <baudrate> <stopbits> <parity> <add> %d %d %d %d %d\n",
-		(int)settings.mbType, (int)settings.mbBaud, (int)settings.mbStopB,
-		(int)settings.mbParity, (int)settings.add);
+		cfg.mode, cfg.baud, cfg.stopBits, cfg.parity, cfg.address);
 	return OK;
 }
 
@@ -37,17 +46,17 @@ const CliCmdType CMD_RS485_READ =
 
 int doRs485Read(int argc, char *argv[])
 {
-	int dev = 0;
+	SmtcBoardType *board;
 	
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
 		return ERROR;
 	}
 	
 	if (argc == 3)
 	{
-		if (OK != cfg485Get(dev))
+		if (OK != cfg485Get(board))
 		{
 			return ERROR;
 		}
@@ -79,15 +88,15 @@ int doRs485Write(int argc, char *argv[])
 		return ARG_CNT_ERR;
 	}
 
-	ModbusSetingsType settings;
+	SmtcRs485Type settings;
 	int aux = atoi(argv[3]); // Mode
 	if (aux == 0) // Disable modbus and free the RS485 for Raspberry usage
 	{
-		settings.mbType = 0;
-		settings.mbBaud = 38400;
-		settings.mbStopB = 1;
-		settings.mbParity = 0;
-		settings.add = 1;
+		settings.mode = 0;
+		settings.baud = 38400;
+		settings.stopBits = 1;
+		settings.parity = 0;
+		settings.address = 1;
 	}
 	else //  enable the modbus and we need all the parameters
 	{
@@ -100,42 +109,42 @@ int doRs485Write(int argc, char *argv[])
 			printf("Mode must be [0/1]\n");
 			return ERROR;
 		}
-		settings.mbType = 1;
+		settings.mode = 1;
 		aux = atoi(argv[4]); // Baudrate
 		if (aux < 1200 || aux > 921600)
 		{
 			printf("Baudrate must be [1200..921600]\n");
 			return ERROR;
 		}
-		settings.mbBaud = aux;
+		settings.baud = aux;
 		aux = atoi(argv[5]); // Stop bits
 		if (aux < 1 || aux > 2)
 		{
 			printf("Stop bits must be [1/2]\n");
 			return ERROR;
 		}
-		settings.mbStopB = aux;
+		settings.stopBits = aux;
 		aux = atoi(argv[6]); // Parity
 		if (aux < 0 || aux > 2)
 		{
 			printf("Parity must be [0/1/2]\n");
 			return ERROR;
 		}
-		settings.mbParity = aux;
+		settings.parity = aux;
 		aux = atoi(argv[7]); // Modbus ID
 		if (aux < 1 || aux > 254)
 		{
 			printf("Modbus ID must be [1..254]\n");
 			return ERROR;
 		}
-		settings.add = aux;
+		settings.address = aux;
 	}
-	int dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	SmtcBoardType *board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
 		return ERROR;
 	}
-	if (OK != i2cMem8Write(dev, I2C_MODBUS_SETINGS_ADD, (uint8_t*)&settings, sizeof(ModbusSetingsType)))
+	if (SMTC_OK != smtcRs485Set(board, &settings))
 	{
 		printf("Fail to write RS485 settings!\n");
 		return ERROR;
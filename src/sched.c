@@ -0,0 +1,358 @@
+/*
+ * sched.c:
+ *	Per channel sampling schedules: every channel of every card is read at
+ *	its own period, driven by a timer wheel on one thread. The channels of
+ *	one card due on the same tick are merged into block reads of the
+ *	contiguous TCP_VAL / TCP_MV ranges, so the bus carries only the values
+ *	somebody asked for and each card is addressed as few times as possible.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+
+#include "smtc.h"
+#include "comm.h"
+#include "out.h"
+#include "wheel.h"
+
+#define SCHED_TICK_US		1000
+#define SCHED_TIMERS_MAX	256
+#define SCHED_GROUPS_MAX	(SCHED_TIMERS_MAX)
+
+enum
+{
+	SCHED_TEMP = 0,
+	SCHED_MV
+};
+
+typedef struct
+{
+	WheelTimerType timer; // first, the wheel hands back this pointer
+	SmtcBoardType *board;
+	int ch;
+	int kind;
+} SchedChType;
+
+typedef struct
+{
+	SmtcBoardType *board;
+	int kind;
+	int mask; // bit ch - 1
+	int ret;
+	int16_t raw[SMTC_CH_NR];
+} SchedGroupType;
+
+static volatile sig_atomic_t gSchedStop = 0;
+static SchedChType gSchedCh[SCHED_TIMERS_MAX];
+static int gSchedChCount = 0;
+static WheelType gSchedWheel;
+static WheelTimerType *gSchedDue[SCHED_TIMERS_MAX];
+static SchedGroupType gSchedGroup[SCHED_GROUPS_MAX];
+
+static void schedSignal(int sig)
+{
+	(void)sig;
+	gSchedStop = 1;
+}
+
+static uint64_t schedTick(uint64_t startUs)
+{
+	return (commTimeUs() - startUs) / SCHED_TICK_US;
+}
+
+static void schedSleepUntilUs(uint64_t us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = (time_t) (us / 1000000ULL);
+	ts.tv_nsec = (long) (us % 1000000ULL) * 1000L;
+	while (!gSchedStop
+		&& EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+		;
+}
+
+/*
+ * schedParse:
+ *	<id>/<ch>[-<ch>]@<ms>[mv], one timer per channel. The first read is
+ *	offset by card, so channels of one card with the same period stay
+ *	aligned (one block read) while different cards are spread out.
+ */
+static int schedParse(const char *spec)
+{
+	char id[16];
+	char kind[4];
+	SmtcBoardType *board;
+	SchedChType *c;
+	int first, last, period;
+	int n, ch;
+
+	kind[0] = 0;
+	n = sscanf(spec, "%15[^/]/%d-%d@%d%3s", id, &first, &last, &period, kind);
+	if (n < 4)
+	{
+		kind[0] = 0;
+		n = sscanf(spec, "%15[^/]/%d@%d%3s", id, &first, &period, kind);
+		if (n < 3)
+		{
+			printf("Invalid schedule %s!\n", spec);
+			return ARG_ERR;
+		}
+		last = first;
+	}
+	if (first < CHANNEL_NR_MIN || last > SMTC_CH_NR || first > last
+		|| period <= 0 || (kind[0] != 0 && 0 != strcmp(kind, "mv")))
+	{
+		printf("Invalid schedule %s!\n", spec);
+		return ARG_ERR;
+	}
+	board = doBoardOpen(id);
+	if (NULL == board)
+	{
+		return ERROR;
+	}
+	for (ch = first; ch <= last; ch++)
+	{
+		if (gSchedChCount >= SCHED_TIMERS_MAX)
+		{
+			printf("Too many scheduled channels!\n");
+			return ARG_ERR;
+		}
+		c = &gSchedCh[gSchedChCount];
+		c->board = board;
+		c->ch = ch;
+		c->kind = kind[0] != 0 ? SCHED_MV : SCHED_TEMP;
+		c->timer.period = (uint32_t)period;
+		c->timer.expires = (uint64_t) ( (board->bus * SMTC_STACK_MAX
+			+ board->stack) % period);
+		c->timer.arg = c;
+		gSchedChCount++;
+	}
+	return OK;
+}
+
+/*
+ * schedGroup:
+ *	Collect the due channels into one channel mask per card and kind
+ */
+static int schedGroup(int due)
+{
+	SchedChType *c;
+	int groups = 0;
+	int i, g;
+
+	for (i = 0; i < due; i++)
+	{
+		c = (SchedChType*)gSchedDue[i]->arg;
+		for (g = 0; g < groups; g++)
+		{
+			if (gSchedGroup[g].board == c->board && gSchedGroup[g].kind == c->kind)
+			{
+				break;
+			}
+		}
+		if (g == groups)
+		{
+			gSchedGroup[g].board = c->board;
+			gSchedGroup[g].kind = c->kind;
+			gSchedGroup[g].mask = 0;
+			groups++;
+		}
+		gSchedGroup[g].mask |= 1 << (c->ch - 1);
+	}
+	return groups;
+}
+
+/*
+ * schedRead:
+ *	One block read per run of due channels. A single channel gap is read
+ *	through, two extra bytes are cheaper than addressing the card again.
+ */
+static void schedRead(SchedGroupType *g)
+{
+	int first, last, ret;
+
+	g->ret = SMTC_OK;
+	first = 0;
+	while (first < SMTC_CH_NR)
+	{
+		if ( (g->mask & (1 << first)) == 0)
+		{
+			first++;
+			continue;
+		}
+		last = first;
+		while (last + 1 < SMTC_CH_NR && ( (g->mask & (1 << (last + 1)))
+			|| (last + 2 < SMTC_CH_NR && (g->mask & (1 << (last + 2))))))
+		{
+			last++;
+		}
+		if (g->kind == SCHED_MV)
+		{
+			ret = smtcReadMvRawRange(g->board, first + 1, last - first + 1,
+				&g->raw[first]);
+		}
+		else
+		{
+			ret = smtcReadRawRange(g->board, first + 1, last - first + 1,
+				&g->raw[first]);
+		}
+		if (ret != SMTC_OK)
+		{
+			g->ret = ret;
+		}
+		first = last + 1;
+	}
+}
+
+static void schedReport(const SchedGroupType *g)
+{
+	struct timespec ts;
+	int64_t ms;
+	int ch;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	for (ch = 1; ch <= SMTC_CH_NR; ch++)
+	{
+		if ( (g->mask & (1 << (ch - 1))) == 0)
+		{
+			continue;
+		}
+		if (outFormat() == OUT_TEXT)
+		{
+			printf("%d:%d:%d ", g->board->bus, g->board->stack, ch);
+			if (g->ret != SMTC_OK)
+			{
+				printf("%s\n", smtcStrError(g->ret));
+				continue;
+			}
+		}
+		doOutChannel(g->board, ch);
+		if (outFormat() != OUT_TEXT)
+		{
+			outLong("ts", ms);
+		}
+		if (g->ret != SMTC_OK)
+		{
+			outInt("error", g->ret);
+		}
+		else if (g->kind == SCHED_MV)
+		{
+			outFixed("mv", g->raw[ch - 1], 2);
+		}
+		else
+		{
+			outFixed("t", g->raw[ch - 1], 1);
+		}
+		outEnd();
+	}
+}
+
+/*
+ * schedTickRun:
+ *	Read everything due on this tick. Each bus is locked once for all its
+ *	reads of the tick, the output is written after the bus is released.
+ */
+static void schedTickRun(int due)
+{
+	int groups, bus, locked;
+	int g;
+
+	groups = schedGroup(due);
+	for (bus = 0; bus < COMM_BUS_MAX; bus++)
+	{
+		locked = 0;
+		for (g = 0; g < groups; g++)
+		{
+			if (gSchedGroup[g].board->bus != bus)
+			{
+				continue;
+			}
+			if (!locked)
+			{
+				commLock(bus);
+				locked = 1;
+			}
+			schedRead(&gSchedGroup[g]);
+		}
+		if (locked)
+		{
+			commUnlock(bus);
+		}
+	}
+	for (g = 0; g < groups; g++)
+	{
+		schedReport(&gSchedGroup[g]);
+	}
+	fflush(stdout);
+}
+
+int doSched(int argc, char *argv[]);
+const CliCmdType CMD_SCHED =
+	{
+		"-sched",
+		1,
+		&doSched,
+		"\t-sched:     Read each channel at its own period until stopped, channels due together are read in one block\n",
+		"\tUsage:      smtc -sched <id>/<ch>[-<ch>]@<period ms>[mv]... [--jsonl]\n",
+		"",
+		"\tExample:    smtc -sched 0/1-2@100 0/3-8@60000 1:2/1@1000mv; Channels 1 and 2 of card 0 every 100ms, the rest every minute, channel 1 of card 2 on bus 1 in mV every second\n"};
+
+int doSched(int argc, char *argv[])
+{
+	uint64_t startUs, now;
+	int i, n, ret;
+
+	gSchedChCount = 0;
+	for (i = 2; i < argc; i++)
+	{
+		if (0 == strcmp(argv[i], "--jsonl"))
+		{
+			outFormatSet("json");
+			continue;
+		}
+		ret = schedParse(argv[i]);
+		if (ret != OK)
+		{
+			return ret;
+		}
+	}
+	if (gSchedChCount == 0)
+	{
+		return ARG_CNT_ERR;
+	}
+	startUs = commTimeUs();
+	wheelInit(&gSchedWheel, 0);
+	for (i = 0; i < gSchedChCount; i++)
+	{
+		wheelAdd(&gSchedWheel, &gSchedCh[i].timer);
+	}
+	gSchedStop = 0;
+	signal(SIGINT, &schedSignal);
+	signal(SIGTERM, &schedSignal);
+	signal(SIGPIPE, &schedSignal);
+	while (!gSchedStop)
+	{
+		now = schedTick(startUs);
+		n = wheelAdvance(&gSchedWheel, now, gSchedDue, SCHED_TIMERS_MAX);
+		if (n > 0)
+		{
+			schedTickRun(n);
+		}
+		if (n < SCHED_TIMERS_MAX)
+		{
+			schedSleepUntilUs(startUs + wheelNext(&gSchedWheel) * SCHED_TICK_US);
+		}
+	}
+	return OK;
+}
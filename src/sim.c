@@ -0,0 +1,392 @@
+/*
+ * sim.c:
+ *	Simulated thermocouple cards, a transport backend that answers register
+ *	accesses from an in-memory model of the card register map
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "smtc.h"
+#include "comm.h"
+#include "rs485.h"
+
+#define SIM_STACK_MAX		8
+#define SIM_DEFAULT_BOARDS	"1:0-7"
+#define SIM_FW_MAJOR		1
+#define SIM_FW_MINOR		5
+#define SIM_HW_MAJOR		1
+#define SIM_HW_MINOR		0
+#define SIM_SPS				20
+#define SIM_PI				3.14159265358979
+
+typedef struct
+{
+	int present;
+	u8 mem[SLAVE_BUFF_SIZE + 1];
+	uint64_t wdtReloadUs;
+	int wdtActive;
+	uint64_t cycle; // ADC conversion cycle the registers hold, 0 - none
+	unsigned int seed;
+} SimBoardType;
+
+typedef struct
+{
+	pthread_mutex_t mutex;
+	int boards;
+	SimBoardType board[SIM_STACK_MAX];
+} SimBusType;
+
+static SimBusType gSimBus[COMM_BUS_MAX];
+static int gSimLatencyUs = 0;
+static int gSimByteUs = 0;
+static uint64_t gSimStartUs = 0;
+static pthread_once_t gSimOnce = PTHREAD_ONCE_INIT;
+
+// Seebeck coefficients in uV/degC for B, E, J, K, N, R, S, T
+static const float gSeebeck[TC_TYPE_T + 1] = {6, 68, 52, 41, 27, 7, 7, 43};
+
+static void simPut16(u8 *mem, int add, int val)
+{
+	s16 v = (s16)val;
+	memcpy(&mem[add], &v, 2);
+}
+
+static int simGet16(const u8 *mem, int add)
+{
+	u16 v;
+	memcpy(&v, &mem[add], 2);
+	return v;
+}
+
+static void simBoardReset(SimBoardType *b, int stack)
+{
+	ModbusSetingsType mb;
+	u32 aux32;
+	int i;
+
+	memset(b->mem, 0, sizeof(b->mem));
+	for (i = 0; i < TCP_CH_NR_MAX; i++)
+	{
+		b->mem[TCP_TYPE1 + i] = TC_TYPE_K;
+	}
+	b->mem[DIAG_TEMPERATURE_MEM_ADD] = 38;
+	simPut16(b->mem, DIAG_5V_MEM_ADD, 5050);
+	simPut16(b->mem, I2C_MEM_WDT_INTERVAL_GET_ADD, 120);
+	simPut16(b->mem, I2C_MEM_WDT_INIT_INTERVAL_GET_ADD, 270);
+	aux32 = 10;
+	memcpy(&b->mem[I2C_MEM_WDT_POWER_OFF_INTERVAL_GET_ADD], &aux32, 4);
+	b->mem[REVISION_HW_MAJOR_MEM_ADD] = SIM_HW_MAJOR;
+	b->mem[REVISION_HW_MINOR_MEM_ADD] = SIM_HW_MINOR;
+	b->mem[REVISION_MAJOR_MEM_ADD] = SIM_FW_MAJOR;
+	b->mem[REVISION_MINOR_MEM_ADD] = SIM_FW_MINOR;
+	simPut16(b->mem, TCP_SPS1_ADD, SIM_SPS);
+	simPut16(b->mem, TCP_SPS2_ADD, SIM_SPS);
+	simPut16(b->mem, TCP_RASP_VOLT, 5100);
+	memset(&mb, 0, sizeof(mb));
+	mb.mbBaud = 38400;
+	mb.mbStopB = 1;
+	mb.add = 1;
+	memcpy(&b->mem[I2C_MODBUS_SETINGS_ADD], &mb, sizeof(mb));
+	for (i = 0; i < TCP_THERMISTORS_NR_MAX; i++)
+	{
+		simPut16(b->mem, I2C_THERMISTOR1_ADD + 2 * i, 250 + 10 * stack);
+	}
+	b->mem[I2C_MAV_FILT_SIZE] = 10;
+	b->wdtReloadUs = commTimeUs();
+	b->wdtActive = 0;
+	b->cycle = 0;
+	b->seed = 0x5eed + stack;
+}
+
+/*
+ * simParseBoards:
+ *	"<bus>:<first>-<last> ..." e.g. "1:0-7 3:0-1" or "1:0,2,5"
+ */
+static void simParseBoards(const char *spec)
+{
+	const char *p = spec;
+	char *end;
+	int bus, first, last, i;
+
+	while (*p)
+	{
+		bus = (int)strtol(p, &end, 10);
+		if (end == p || *end != ':' || bus < 0 || bus >= COMM_BUS_MAX)
+		{
+			return;
+		}
+		p = end + 1;
+		do
+		{
+			first = (int)strtol(p, &end, 10);
+			if (end == p)
+			{
+				return;
+			}
+			last = first;
+			p = end;
+			if (*p == '-')
+			{
+				last = (int)strtol(p + 1, &end, 10);
+				p = end;
+			}
+			for (i = first; i <= last && i < SIM_STACK_MAX; i++)
+			{
+				if (i >= 0)
+				{
+					gSimBus[bus].board[i].present = 1;
+					simBoardReset(&gSimBus[bus].board[i], i);
+					gSimBus[bus].boards++;
+				}
+			}
+		}
+		while (*p == ',' && *++p);
+		while (*p == ' ')
+		{
+			p++;
+		}
+	}
+}
+
+static void simInit(void)
+{
+	const char *env;
+	int i;
+
+	gSimStartUs = commTimeUs();
+	for (i = 0; i < COMM_BUS_MAX; i++)
+	{
+		pthread_mutex_init(&gSimBus[i].mutex, NULL);
+	}
+	env = getenv("SMTC_SIM_BOARDS");
+	simParseBoards(env ? env : SIM_DEFAULT_BOARDS);
+	env = getenv("SMTC_SIM_LATENCY_US");
+	if (env)
+	{
+		gSimLatencyUs = atoi(env);
+	}
+	env = getenv("SMTC_SIM_BYTE_US");
+	if (env)
+	{
+		gSimByteUs = atoi(env);
+	}
+}
+
+/*
+ * simUpdate:
+ *	Refresh the measurement registers from a slow synthetic waveform plus
+ *	noise reduced by the moving average filter size, and run the watchdog.
+ *	Like on the card the values change only once per ADC conversion cycle
+ *	(SMTC_ADC_CH_NR conversions at TCP_SPS1_ADD samples per second), each
+ *	card with its own phase.
+ */
+static void simUpdate(SimBoardType *b, int stack, uint64_t nowUs)
+{
+	double t;
+	double temp, noise;
+	int fsz = b->mem[I2C_MAV_FILT_SIZE];
+	int sps = simGet16(b->mem, TCP_SPS1_ADD);
+	int type, period, i;
+	uint64_t cycleUs, cycle;
+	u32 resets = 0;
+
+	if (fsz < 1)
+	{
+		fsz = 1;
+	}
+	cycleUs = sps > 0 ? (uint64_t)SMTC_ADC_CH_NR * 1000000ULL / sps : 1;
+	cycle = (nowUs - gSimStartUs + (uint64_t)stack * 37000ULL % cycleUs)
+		/ cycleUs + 1;
+	t = (double) (cycle * cycleUs) / 1e6;
+	for (i = 0; i < TCP_CH_NR_MAX && cycle != b->cycle; i++)
+	{
+		noise = ((double)rand_r(&b->seed) / RAND_MAX - 0.5) * 2.0 / sqrt(fsz);
+		temp = 22.0 + 3.0 * stack + 1.5 * i
+			+ 4.0 * sin(2 * SIM_PI * t / (90 + 13 * i)) + noise;
+		type = b->mem[TCP_TYPE1 + i];
+		if (type > TC_TYPE_T)
+		{
+			type = TC_TYPE_K;
+		}
+		simPut16(b->mem, TCP_VAL1_ADD + TEMP_DATA_SIZE * i,
+			(int)lrint(temp * TEMP_SCALE_FACTOR));
+		simPut16(b->mem, TCP_MV1_ADD + MV_DATA_SIZE * i,
+			(int)lrint(temp * gSeebeck[type] / 1000 * MV_SCALE_FACTOR));
+	}
+	b->cycle = cycle;
+	if (b->wdtActive)
+	{
+		period = simGet16(b->mem, I2C_MEM_WDT_INTERVAL_GET_ADD);
+		if (nowUs - b->wdtReloadUs > (uint64_t)period * 1000000ULL)
+		{
+			memcpy(&resets, &b->mem[I2C_MEM_WDT_RESET_COUNT_ADD], 2);
+			resets = (resets + 1) & 0xffff;
+			memcpy(&b->mem[I2C_MEM_WDT_RESET_COUNT_ADD], &resets, 2);
+			b->wdtReloadUs = nowUs;
+			b->wdtActive = 0;
+		}
+	}
+}
+
+static int simInRange(int add, int size, int first, int last)
+{
+	return add >= first && add + size - 1 <= last;
+}
+
+static void simWrite(SimBoardType *b, int add, const u8 *data, int size)
+{
+	int val;
+
+	if (simInRange(add, size, TCP_TYPE1, TCP_TYPE8))
+	{
+		for (val = 0; val < size; val++)
+		{
+			if (data[val] <= TC_TYPE_T)
+			{
+				b->mem[add + val] = data[val];
+			}
+		}
+	}
+	else if (add == I2C_MEM_WDT_RESET_ADD && size >= 1)
+	{
+		if (data[0] == WDT_RESET_SIGNATURE)
+		{
+			b->wdtReloadUs = commTimeUs();
+			b->wdtActive = 1;
+		}
+	}
+	else if (add == I2C_MEM_WDT_INTERVAL_SET_ADD && size == 2)
+	{
+		memcpy(&b->mem[I2C_MEM_WDT_INTERVAL_GET_ADD], data, 2);
+	}
+	else if (add == I2C_MEM_WDT_INIT_INTERVAL_SET_ADD && size == 2)
+	{
+		memcpy(&b->mem[I2C_MEM_WDT_INIT_INTERVAL_GET_ADD], data, 2);
+	}
+	else if (add == I2C_MEM_WDT_POWER_OFF_INTERVAL_SET_ADD && size == 4)
+	{
+		memcpy(&b->mem[I2C_MEM_WDT_POWER_OFF_INTERVAL_GET_ADD], data, 4);
+	}
+	else if (add == I2C_MEM_WDT_CLEAR_RESET_COUNT_ADD && size >= 1)
+	{
+		if (data[0] == WDT_RESET_COUNT_SIGNATURE)
+		{
+			simPut16(b->mem, I2C_MEM_WDT_RESET_COUNT_ADD, 0);
+		}
+	}
+	else if (simInRange(add, size, I2C_MODBUS_SETINGS_ADD,
+		TCP_LED_THRESHOLD8 + 1)
+		|| simInRange(add, size, I2C_CALIB_RES, I2C_CALIB_CH))
+	{
+		memcpy(&b->mem[add], data, size);
+	}
+	else if (add == I2C_MAV_FILT_SIZE && size == 1)
+	{
+		if (data[0] >= 1 && data[0] <= 40)
+		{
+			b->mem[add] = data[0];
+		}
+	}
+}
+
+static void simDelay(int size)
+{
+	struct timespec ts;
+	long us = gSimLatencyUs + (long)gSimByteUs * size;
+
+	if (us <= 0)
+	{
+		return;
+	}
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000;
+	nanosleep(&ts, NULL);
+}
+
+static int simOpen(int bus)
+{
+	pthread_once(&gSimOnce, simInit);
+	if (gSimBus[bus].boards == 0)
+	{
+		return -1;
+	}
+	return bus;
+}
+
+static int simClose(int handle)
+{
+	(void)handle;
+	return 0;
+}
+
+static int simXfer(int handle, int addr, const uint8_t *wr, int wrSize,
+	uint8_t *rd, int rdSize)
+{
+	SimBusType *bus = &gSimBus[handle];
+	SimBoardType *b;
+	int stack = addr - SLAVE_OWN_ADDRESS_BASE;
+	int add;
+	int ret = 0;
+
+	if (wrSize < 1 || stack < 0 || stack >= SIM_STACK_MAX)
+	{
+		return -1;
+	}
+	add = wr[0];
+	if (add + wrSize - 1 > SLAVE_BUFF_SIZE || add + rdSize > SLAVE_BUFF_SIZE + 1)
+	{
+		return -1;
+	}
+	// the bus mutex is held across the delay: one transaction per bus at a time
+	pthread_mutex_lock(&bus->mutex);
+	b = &bus->board[stack];
+	simDelay(wrSize + rdSize);
+	if (!b->present)
+	{
+		ret = -1; // NAK
+	}
+	else
+	{
+		simUpdate(b, stack, commTimeUs());
+		if (wrSize > 1)
+		{
+			simWrite(b, add, wr + 1, wrSize - 1);
+		}
+		if (rdSize > 0)
+		{
+			memcpy(rd, &b->mem[add], rdSize);
+		}
+	}
+	pthread_mutex_unlock(&bus->mutex);
+	return ret;
+}
+
+static int simBuses(int *list, int max)
+{
+	int i;
+	int n = 0;
+
+	pthread_once(&gSimOnce, simInit);
+	for (i = 0; i < COMM_BUS_MAX && n < max; i++)
+	{
+		if (gSimBus[i].boards > 0)
+		{
+			list[n++] = i;
+		}
+	}
+	return n;
+}
+
+const CommTransportType COMM_TRANSPORT_SIM =
+	{"sim", &simOpen, &simClose, &simXfer, &simBuses};
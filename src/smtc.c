@@ -13,8 +13,8 @@
 #include <stdint.h>
 #include <string.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
-#include <semaphore.h>
 
 #include "smtc.h"
 #include "comm.h"
@@ -22,13 +22,17 @@
 #include "wdt.h"
 #include "led.h"
 #include "rs485.h"
+#include "trace.h"
+#include "libsmtc.h"
+#include "out.h"
 
 #define VERSION_BASE	(int)1
 #define VERSION_MAJOR	(int)0
 #define VERSION_MINOR	(int)3
 
 #define UNUSED(X) (void)X      /* To avoid gcc/g++ warnings */
-#define THREAD_SAFE
+#define BATCH_LINE_MAX	512
+#define BATCH_ARGS_MAX	16
 
 void usage(void);
 const char *tcTypes[TC_TYPE_T + 1] = {"B(0)", "E(1)", "J(2)", "K(3)", "N(4)",
@@ -59,6 +63,22 @@ const CliCmdType CMD_LIST =
 		"\tUsage:      smtc -list\n", "",
 		"\tExample:    smtc -list display all the connected thermocouples cards \n"};
 
+int doBatch(int argc, char *argv[]);
+const CliCmdType CMD_BATCH =
+	{"-b", 1, &doBatch,
+		"\t-b:         Run the commands read from a file or stdin, one per line, in one process\n",
+		"\tUsage:      smtc -b\n",
+		"\tUsage:      smtc -b <file>\n",
+		"\tExample:    printf \"0 read 1\\n0 readmv 2\\n\" | smtc -b; Read channel 1 temperature and channel 2 voltage of card #0\n"};
+
+int doScan(int argc, char *argv[]);
+const CliCmdType CMD_SCAN =
+	{"-scan", 1, &doScan,
+		"\t-scan:      Probe the selected (default all) i2c buses in parallel and print the cards found as JSON\n",
+		"\tUsage:      smtc -scan\n",
+		"\tUsage:      smtc -scan <bus>\n",
+		"\tExample:    smtc -scan; Print bus, stack level, versions and card type of every card\n"};
+
 int doSmtcRead(int argc, char *argv[]);
 const CliCmdType CMD_READ =
 	{"read", 2, &doSmtcRead, "\tread:       Read smtc channel temperature\n",
@@ -126,6 +146,14 @@ const CliCmdType CMD_FILT_SIZE_WRITE =
 		"\tUsage:      smtc <id> fszwr <value> \n", "",
 		"\tExample:    smtc 0 fszwr 10; Set the moving average filter size or number of samples to 10\n"};
 
+int doTraceDump(int argc, char *argv[]);
+const CliCmdType CMD_TRACE_DUMP =
+	{"-trace", 1, &doTraceDump,
+		"\t-trace:     Display a bus traffic trace recorded with SMTC_RECORD=<file>\n",
+		"\tUsage:      smtc -trace <file>\n",
+		"\tUsage:      smtc -trace <file> sum  Display only per board statistics\n",
+		"\tExample:    smtc -trace bus.trc; Display every transaction recorded in bus.trc\n"};
+
 char *warranty =
 	"	       Copyright (c) 2016-2023 Sequent Microsystems\n"
 		"                                                             \n"
@@ -151,141 +179,174 @@ const CliCmdType *gCmdArray[] = {&CMD_HELP, &CMD_WAR, &CMD_LIST, &CMD_VERSION,
 	//&CMD_CALIB,
 	//&CMD_CALIB_RST,
 	&CMD_RS485_READ, &CMD_RS485_WRITE, &CMD_SNS_TYPE_READ, &CMD_SNS_TYPE_WRITE,
-	&CMD_FILT_SIZE_READ, &CMD_FILT_SIZE_WRITE,
-	NULL}; //null terminated array of cli structure pointers
+	&CMD_FILT_SIZE_READ, &CMD_FILT_SIZE_WRITE, &CMD_TRACE_DUMP, &CMD_BUS_TEST,
+	&CMD_SCAN, &CMD_POLL, &CMD_BATCH,
+	&CMD_STREAM, &CMD_SCHED, &CMD_BENCH, &CMD_FLIGHT, &CMD_ANALYZE, NULL}; //null terminated array of cli structure pointers
+
+static SmtcBoardType gBoard[COMM_BUS_MAX][SMTC_STACK_MAX];
+static int gBusSel[COMM_BUS_MAX];
+static int gBusSelCount = 0;
 
-int doBoardInit(int stack)
+/*
+ * doBusSelect:
+ *	Parse a bus selector, one bus number or a comma separated list. The
+ *	first bus is the default one for the card ids without a bus.
+ */
+static int doBusSelect(const char *arg)
 {
-	int dev = 0;
-	int add = 0;
-	uint8_t buff;
+	char *end;
+	long bus;
+	int cnt = 0;
 
-	if ( (stack < 0) || (stack > 7))
-	{
-		printf("Invalid stack level [0..7]!");
-		return ERROR;
-	}
-	add = stack + SLAVE_OWN_ADDRESS_BASE;
-	dev = i2cSetup(add);
-	if (dev == -1)
-	{
-		return ERROR;
-	}
-	if (ERROR == i2cMem8Read(dev, REVISION_MAJOR_MEM_ADD, &buff, 1))
+	while (cnt < COMM_BUS_MAX)
 	{
-		printf("Thermocouple card  id %d not detected\n", stack);
-		return ERROR;
+		bus = strtol(arg, &end, 10);
+		if (end == arg || bus < 0 || bus >= COMM_BUS_MAX
+			|| (*end != 0 && *end != ','))
+		{
+			printf("Invalid bus number [0..%d]!\n", COMM_BUS_MAX - 1);
+			return ARG_ERR;
+		}
+		gBusSel[cnt++] = (int)bus;
+		if (*end == 0)
+		{
+			break;
+		}
+		arg = end + 1;
 	}
+	gBusSelCount = cnt;
+	return OK;
+}
 
-	return dev;
+int doBusDefault(void)
+{
+	return gBusSelCount > 0 ? gBusSel[0] : COMM_DEFAULT_BUS;
 }
 
-int boardCheck(u8 add)
+/*
+ * doBusList:
+ *	The buses selected with --bus or SMTC_BUS, all the buses the transport
+ *	can reach when there is no selection
+ */
+int doBusList(int *list, int max)
 {
-	int dev;
-	u8 buff;
+	int i;
 
-	dev = i2cSetup(add);
-	if (dev == -1)
+	if (gBusSelCount == 0)
 	{
-		return ERROR;
+		return commBusList(list, max);
 	}
-	return (i2cMem8Read(dev, REVISION_MAJOR_MEM_ADD, &buff, 1));
-}
-
-int smtcHwTypeGet(int dev, int *hw)
-{
-	u8 buff;
-	if (FAIL == i2cMem8Read(dev, TCP_CARD_TYPE, &buff, 1))
+	for (i = 0; i < gBusSelCount && i < max; i++)
 	{
-		return ERROR;
+		list[i] = gBusSel[i];
 	}
-	*hw = buff;
-	return OK;
+	return i;
 }
 
-int smtcChGet(int dev, u8 channel, float *temperature)
-{
-	u8 buff[sizeof(int16_t)];
-	int16_t val = 0;
-
-	if (NULL == temperature)
-	{
-		return ERROR;
-	}
+/*
+ * doUserBegin:
+ *	Take the rights of the user running the setuid binary, to open or
+ *	create the files named on the command line; doUserEnd() takes back the
+ *	rights of the binary. Both return 0 or -1.
+ */
+static uid_t gBinaryEuid;
 
-	if ( (channel < CHANNEL_NR_MIN) || (channel > TCP_CH_NR_MAX))
+int doUserBegin(void)
+{
+	gBinaryEuid = geteuid();
+	if (gBinaryEuid != getuid() && 0 != seteuid(getuid()))
 	{
-		printf("Invalid smtc channel nr!\n");
-		return ERROR;
+		return -1;
 	}
+	return 0;
+}
 
-	if (FAIL
-		== i2cMem8Read(dev, TCP_VAL1_ADD + sizeof(int16_t) * (channel - 1), buff,
-			sizeof(int16_t)))
+int doUserEnd(void)
+{
+	if (gBinaryEuid != geteuid() && 0 != seteuid(gBinaryEuid))
 	{
-		return ERROR;
+		return -1;
 	}
+	return 0;
+}
 
-	memcpy(&val, buff, sizeof(int16_t));
-	*temperature = (float)val / TEMP_SCALE_FACTOR;
-	return OK;
+/*
+ * doBoardOpen:
+ *	Return the handle of the card "id", a stack level on the default bus or
+ *	"<bus>:<stack>", opening it on first use. Handles stay open for the life
+ *	of the process.
+ */
+static int doIdBus(const char *id)
+{
+	return NULL != strchr(id, ':') ? atoi(id) : doBusDefault();
 }
 
-int smtcChGetMv(int dev, u8 channel, float *voltage)
+SmtcBoardType* doBoardOpen(const char *id)
 {
-	u8 buff[sizeof(int16_t)];
-	int16_t val = 0;
+	const char *p;
+	int bus = doIdBus(id);
+	int stack;
+	int ret;
 
-	if (NULL == voltage)
+	p = strchr(id, ':');
+	stack = atoi(NULL != p ? p + 1 : id);
+	if (bus < 0 || bus >= COMM_BUS_MAX)
 	{
-		return ERROR;
+		printf("Invalid bus number [0..%d]!\n", COMM_BUS_MAX - 1);
+		return NULL;
 	}
-
-	if ( (channel < CHANNEL_NR_MIN) || (channel > TCP_CH_NR_MAX))
+	if ( (stack < 0) || (stack >= SMTC_STACK_MAX))
 	{
-		printf("Invalid sensor channel nr!\n");
-		return ERROR;
+		printf("Invalid stack level [0..7]!");
+		return NULL;
 	}
-
-	if (FAIL
-		== i2cMem8Read(dev, TCP_MV1_ADD + sizeof(int16_t) * (channel - 1), buff,
-			sizeof(int16_t)))
+	if (gBoard[bus][stack].valid)
 	{
-		return ERROR;
+		return &gBoard[bus][stack];
 	}
-
-	memcpy(&val, buff, sizeof(int16_t));
-	*voltage = (float)val / MV_SCALE_FACTOR;
-	return OK;
-}
-
-int smtcChGetConnTemp(int dev, u8 channel, float *voltage)
-{
-	u8 buff[sizeof(int16_t)];
-	int16_t val = 0;
-
-	if (NULL == voltage)
+	ret = smtcOpen(&gBoard[bus][stack], bus, stack);
+	if (ret == SMTC_ERR_OPEN)
 	{
-		return ERROR;
+		printf("Failed to open the bus.\n");
+		return NULL;
 	}
-
-	if ( (channel < CHANNEL_NR_MIN) || (channel > TCP_THERMISTORS_NR_MAX))
+	if (ret != SMTC_OK)
 	{
-		printf("Invalid thermistor channel nr![1..10]\n");
-		return ERROR;
+		printf("Thermocouple card  id %d not detected\n", stack);
+		return NULL;
 	}
+	return &gBoard[bus][stack];
+}
 
-	if (FAIL
-		== i2cMem8Read(dev, I2C_THERMISTOR1_ADD + sizeof(int16_t) * (channel - 1),
-			buff, sizeof(int16_t)))
-	{
-		return ERROR;
-	}
+/*
+ * doOutBoard:
+ *	Start an output record identifying the card
+ */
+void doOutBoard(const SmtcBoardType *board)
+{
+	outBegin();
+	outTag("bus", board->bus);
+	outTag("id", board->stack);
+}
 
-	memcpy(&val, buff, sizeof(int16_t));
-	*voltage = (float)val / 10;
-	return OK;
+void doOutChannel(const SmtcBoardType *board, int ch)
+{
+	doOutBoard(board);
+	outTag("ch", ch);
+}
+
+/*
+ * doOutDiag:
+ *	The health fields of a board or diagnostics record
+ */
+void doOutDiag(const SmtcDiagRawType *diag)
+{
+	outInt("cpu_temp", diag->cpuTemp);
+	outFixed("supply_5v", diag->supply5vMv, 3);
+	outFixed("rasp_v", diag->raspMv, 3);
+	outInt("adc_reinit", (int)diag->adc.reinit);
+	outInt("sps1", diag->adc.sps[0]);
+	outInt("sps2", diag->adc.sps[1]);
 }
 
 /*
@@ -296,13 +357,13 @@ int smtcChGetConnTemp(int dev, u8 channel, float *voltage)
 int doSmtcRead(int argc, char *argv[])
 {
 	int ch = 0;
-	float val = 0;
-	int dev = 0;
+	int16_t val = 0;
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 4)
@@ -312,20 +373,22 @@ int doSmtcRead(int argc, char *argv[])
 		if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
 		{
 			printf("Thermocouple channel number value out of range!\n");
-			exit(1);
+			return ERROR;
 		}
 
-		if (OK != smtcChGet(dev, (u8)ch, &val))
+		if (SMTC_OK != smtcReadRaw(board, ch, &val))
 		{
 			printf("Fail to read!\n");
-			exit(1);
+			return ERROR;
 		}
-		printf("%.1f\n", val);
+		doOutChannel(board, ch);
+		outFixed("temp", val, 1);
+		outEnd();
 	}
 	else
 	{
 		printf("Usage: %s read temperature value\n", argv[0]);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -333,13 +396,13 @@ int doSmtcRead(int argc, char *argv[])
 int doSmtcReadMv(int argc, char *argv[])
 {
 	int ch = 0;
-	float val = 0;
-	int dev = 0;
+	int16_t val = 0;
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 4)
@@ -348,20 +411,22 @@ int doSmtcReadMv(int argc, char *argv[])
 		if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
 		{
 			printf("Thermocouple channel number value out of range!\n");
-			exit(1);
+			return ERROR;
 		}
 
-		if (OK != smtcChGetMv(dev, (u8)ch, &val))
+		if (SMTC_OK != smtcReadMvRaw(board, ch, &val))
 		{
 			printf("Fail to read!\n");
-			exit(1);
+			return ERROR;
 		}
-		printf("%.2f\n", val);
+		doOutChannel(board, ch);
+		outFixed("mv", val, 2);
+		outEnd();
 	}
 	else
 	{
 		printf("Usage: %s read voltage  value\n", argv[0]);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -369,13 +434,13 @@ int doSmtcReadMv(int argc, char *argv[])
 int doSmtcReadConnTemp(int argc, char *argv[])
 {
 	int ch = 0;
-	float val = 0;
-	int dev = 0;
+	int16_t val = 0;
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 4)
@@ -384,20 +449,22 @@ int doSmtcReadConnTemp(int argc, char *argv[])
 		if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_THERMISTORS_NR_MAX))
 		{
 			printf("Thermistor channel number value out of range![1..10]\n");
-			exit(1);
+			return ERROR;
 		}
 
-		if (OK != smtcChGetConnTemp(dev, (u8)ch, &val))
+		if (SMTC_OK != smtcReadConnRaw(board, ch, &val))
 		{
 			printf("Fail to read!\n");
-			exit(1);
+			return ERROR;
 		}
-		printf("%.1f\n", val);
+		doOutChannel(board, ch);
+		outFixed("temp", val, 1);
+		outEnd();
 	}
 	else
 	{
 		printf("Usage: %s read connector temperature\n", argv[0]);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -451,58 +518,16 @@ int doHelp(int argc, char *argv[])
 }
 
 //********************** Calibration *************************
-int smtcSetCalib(int dev, int channel, float value)
-{
-	u8 buff[sizeof(float) + 1];
-
-	if ( (value < 0) || (value > 4000))
-	{
-		return ERROR;
-	}
-
-	if ( (channel < CHANNEL_NR_MIN) || (channel > TCP_CH_NR_MAX))
-	{
-		printf("Invalid smtc channel nr!\n");
-		return ERROR;
-	}
-	memcpy(buff, &value, sizeof(float));
-	buff[sizeof(float)] = channel;
-	if (FAIL == i2cMem8Write(dev, I2C_CALIB_RES, buff, sizeof(float) + 1))
-	{
-		return ERROR;
-	}
-	return OK;
-}
-
-int smtcResetCalib(int dev, int channel)
-{
-	u8 buff[sizeof(float) + 1];
-	float value = -1;
-
-	if ( (channel < CHANNEL_NR_MIN) || (channel > TCP_CH_NR_MAX))
-	{
-		printf("Invalid smtc channel nr!\n");
-		return ERROR;
-	}
-	memcpy(buff, &value, sizeof(float));
-	buff[sizeof(float)] = channel;
-	if (FAIL == i2cMem8Write(dev, I2C_CALIB_RES, buff, sizeof(float) + 1))
-	{
-		return ERROR;
-	}
-	return OK;
-}
-
 int doSmtcCalib(int argc, char *argv[])
 {
 	int ch = 0;
 	float val = 0;
-	int dev = 0;
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 5)
@@ -511,21 +536,21 @@ int doSmtcCalib(int argc, char *argv[])
 		if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
 		{
 			printf("Thermocouple channel number value out of range!\n");
-			exit(1);
+			return ERROR;
 		}
 		val = atof(argv[4]);
 
-		if (OK != smtcSetCalib(dev, ch, val))
+		if (SMTC_OK != smtcCalibSet(board, ch, val))
 		{
 			printf("Fail to calibrate!\n");
-			exit(1);
+			return ERROR;
 		}
 		printf("OK\n");
 	}
 	else
 	{
 		printf("%s", CMD_CALIB.usage1);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -533,13 +558,12 @@ int doSmtcCalib(int argc, char *argv[])
 int doSmtcCalibRst(int argc, char *argv[])
 {
 	int ch = 0;
+	SmtcBoardType *board;
 
-	int dev = 0;
-
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 4)
@@ -548,20 +572,20 @@ int doSmtcCalibRst(int argc, char *argv[])
 		if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
 		{
 			printf("Thermocouple channel number value out of range!\n");
-			exit(1);
+			return ERROR;
 		}
 
-		if (OK != smtcResetCalib(dev, ch))
+		if (SMTC_OK != smtcCalibReset(board, ch))
 		{
 			printf("Fail to calibrate!\n");
-			exit(1);
+			return ERROR;
 		}
 		printf("OK\n");
 	}
 	else
 	{
 		printf("%s", CMD_CALIB_RST.usage1);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -579,6 +603,7 @@ int doVersion(int argc, char *argv[])
 
 int doList(int argc, char *argv[])
 {
+	SmtcTopoType topo[SMTC_STACK_MAX];
 	int ids[8];
 	int i;
 	int cnt = 0;
@@ -586,13 +611,14 @@ int doList(int argc, char *argv[])
 	UNUSED(argc);
 	UNUSED(argv);
 
-	for (i = 0; i < 8; i++)
+	cnt = smtcScanBus(doBusDefault(), topo, SMTC_STACK_MAX);
+	if (cnt < 0)
 	{
-		if (boardCheck(SLAVE_OWN_ADDRESS_BASE + i) == OK)
-		{
-			ids[cnt] = i;
-			cnt++;
-		}
+		cnt = 0;
+	}
+	for (i = 0; i < cnt; i++)
+	{
+		ids[i] = topo[i].stack;
 	}
 	printf("%d board(s) detected\n", cnt);
 	if (cnt > 0)
@@ -608,13 +634,62 @@ int doList(int argc, char *argv[])
 	return OK;
 }
 
+/*
+ * doScan:
+ *	Machine readable topology, one JSON object per card
+ */
+int doScan(int argc, char *argv[])
+{
+	SmtcTopoType topo[COMM_BUS_MAX * SMTC_STACK_MAX];
+	int list[COMM_BUS_MAX];
+	int bus;
+	int cnt;
+	int i;
+
+	if (argc == 2)
+	{
+		cnt = smtcScanBuses(list, doBusList(list, COMM_BUS_MAX), topo,
+			COMM_BUS_MAX * SMTC_STACK_MAX);
+	}
+	else if (argc == 3)
+	{
+		bus = atoi(argv[2]);
+		if (bus < 0 || bus >= COMM_BUS_MAX)
+		{
+			printf("Invalid bus number [0..%d]!\n", COMM_BUS_MAX - 1);
+			return ARG_ERR;
+		}
+		cnt = smtcScanBus(bus, topo, SMTC_STACK_MAX);
+		if (cnt < 0)
+		{
+			cnt = 0;
+		}
+	}
+	else
+	{
+		return ARG_CNT_ERR;
+	}
+	printf("[");
+	for (i = 0; i < cnt; i++)
+	{
+		printf("%s\n {\"bus\":%d,\"stack\":%d,\"hw\":\"%d.%d\",\"fw\":\"%d.%02d\","
+			"\"type\":%d}", i ? "," : "", topo[i].bus, topo[i].stack,
+			(int)topo[i].hwMajor, (int)topo[i].hwMinor, (int)topo[i].fwMajor,
+			(int)topo[i].fwMinor, topo[i].cardType);
+	}
+	printf("%s]\n", cnt ? "\n" : "");
+	return OK;
+}
+
 //#define DEBUG_ADS
 /* 
  * Self test for production
  */
 int doBoard(int argc, char *argv[])
 {
-	int dev = 0;
+	SmtcBoardType *board;
+	SmtcDiagType diag;
+	SmtcDiagRawType raw;
 #ifdef DEBUG_ADS
 	int reinit = 0;
 	u8 cardType = 0;
@@ -622,55 +697,61 @@ int doBoard(int argc, char *argv[])
 	{
 		0,
 		0};
-#endif	
-	s8 saux8 = 0;
 	u8 buff[5] = {0, 0, 0, 0, 0};
+#endif	
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 3)
 	{
 #ifdef DEBUG_ADS
-		if (FAIL == i2cMem8Read(dev, TCP_SPS1_ADD, buff, 5))
+		if (FAIL == i2cMem8Read(board->dev, TCP_SPS1_ADD, buff, 5))
 		{
-			exit(1);
+			return ERROR;
 		}
 		memcpy(sps, buff, 4);
 		cardType = buff[4];
-		if (FAIL == i2cMem8Read(dev, TCP_REINIT_COUNT, buff, 4))
+		if (FAIL == i2cMem8Read(board->dev, TCP_REINIT_COUNT, buff, 4))
 		{
-			exit(1);
+			return ERROR;
 		}
 		memcpy(&reinit, buff, 4);
 #endif		
-		if (FAIL == i2cMem8Read(dev, DIAG_TEMPERATURE_MEM_ADD, buff, 3))
+		if (outFormat() != OUT_TEXT)
 		{
-			exit(1);
+			if (SMTC_OK != smtcDiagRawGet(board, &raw))
+			{
+				return ERROR;
+			}
+			doOutBoard(board);
+			outFixed("fw", board->fwMajor * 100 + board->fwMinor, 2);
+			outFixed("hw", board->hwMajor * 100 + board->hwMinor, 2);
+			doOutDiag(&raw);
+			outEnd();
+			return OK;
 		}
-		memcpy(&saux8, buff, 1);
-
-		if (FAIL == i2cMem8Read(dev, REVISION_MAJOR_MEM_ADD, buff, 2))
+		if (SMTC_OK != smtcDiagGet(board, &diag))
 		{
-			exit(1);
+			return ERROR;
 		}
-		printf("Thermocouple card firmware version %d.%02d\n", (int)buff[0],
-			(int)buff[1]);
+		printf("Thermocouple card firmware version %d.%02d\n",
+			(int)board->fwMajor, (int)board->fwMinor);
 #ifdef DEBUG_ADS
 		printf("ADC: ARC = %d, SPS1 = %d, SPS2 = %d, Card Type = %d\n", reinit,
 		(int)sps[0], (int)sps[1], (int)cardType);
 #endif		
-		printf("CPU Temp %dC\n", (int)saux8);
+		printf("CPU Temp %dC\n", diag.cpuTemp);
 
 	}
 #ifdef DEBUG_ADS	
 	else if (argc == 4)
 	{
 		printf("Perform reset..");
-		if (FAIL == i2cMem8Write(dev, 0xaa, buff, 1))
+		if (FAIL == i2cMem8Write(board->dev, 0xaa, buff, 1))
 		{
 			printf("fail!\n");
 		}
@@ -693,64 +774,14 @@ int doWarranty(int argc UNU, char *argv[] UNU)
 	return OK;
 }
 
-int sensorTypeRead(int dev, int ch, int *val)
-{
-	u8 buff;
-
-	if (NULL == val)
-	{
-		return ERROR;
-	}
-
-	if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
-	{
-		printf("Invalid thermocouple channel number!\n");
-		return ERROR;
-	}
-
-	if (FAIL == i2cMem8Read(dev, TCP_TYPE1 + ch - 1, &buff, 1))
-	{
-		return ERROR;
-	}
-
-	*val = buff;
-	return OK;
-}
-
-int sensorWrite(int dev, int ch, int val)
-{
-	u8 buff;
-
-	if (val < TC_TYPE_B || val > TC_TYPE_T)
-	{
-		printf(
-			"Invalid thermocouple type! Use 0..7 : (B, E, J, K, N, R, S, T)\n");
-		return ERROR;
-	}
-
-	if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
-	{
-		printf("Invalid thermocouple channel number!\n");
-		return ERROR;
-	}
-
-	buff = val;
-	if (FAIL == i2cMem8Write(dev, TCP_TYPE1 + ch - 1, &buff, 1))
-	{
-		return ERROR;
-	}
-
-	return OK;
-}
-
 int doSnsTypeRead(int argc, char *argv[])
 {
 	int ch = 0;
 	int val = 0;
-	int dev = 0;
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
 		return ERROR;
 	}
@@ -758,7 +789,13 @@ int doSnsTypeRead(int argc, char *argv[])
 	if (argc == 4)
 	{
 		ch = atoi(argv[3]);
-		if (OK != sensorTypeRead(dev, ch, &val))
+		if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
+		{
+			printf("Invalid thermocouple channel number!\n");
+			printf("Fail to read!\n");
+			return ERROR;
+		}
+		if (SMTC_OK != smtcTypeGet(board, ch, &val))
 		{
 			printf("Fail to read!\n");
 			return ERROR;
@@ -766,7 +803,7 @@ int doSnsTypeRead(int argc, char *argv[])
 		if (val < TC_TYPE_B || val > TC_TYPE_T)
 		{
 			printf("Unknown thermocouple type!\n");
-
+			return ERROR;
 		}
 		printf("%s\n", tcTypes[val]);
 	}
@@ -781,10 +818,10 @@ int doSnsTypeWrite(int argc, char *argv[])
 {
 	int ch = 0;
 	int val = 0;
-	int dev = 0;
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
 		return ERROR;
 	}
@@ -793,7 +830,20 @@ int doSnsTypeWrite(int argc, char *argv[])
 		ch = atoi(argv[3]);
 		val = atoi(argv[4]);
 
-		if (OK != sensorWrite(dev, ch, val))
+		if (val < TC_TYPE_B || val > TC_TYPE_T)
+		{
+			printf(
+				"Invalid thermocouple type! Use 0..7 : (B, E, J, K, N, R, S, T)\n");
+			printf("Fail to write!\n");
+			return ERROR;
+		}
+		if ( (ch < CHANNEL_NR_MIN) || (ch > TCP_CH_NR_MAX))
+		{
+			printf("Invalid thermocouple channel number!\n");
+			printf("Fail to write!\n");
+			return ERROR;
+		}
+		if (SMTC_OK != smtcTypeSet(board, ch, val))
 		{
 			printf("Fail to write!\n");
 			return ERROR;
@@ -809,24 +859,24 @@ int doSnsTypeWrite(int argc, char *argv[])
 
 int doFiltSizeRd(int argc, char *argv[])
 {
-	int dev = 0;
-	u8 buff;
+	SmtcBoardType *board;
+	int val = 0;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
 		return ERROR;
 	}
 
 	if (argc == 3)
 	{
-		if (FAIL == i2cMem8Read(dev, I2C_MAV_FILT_SIZE, &buff, 1))
+		if (SMTC_OK != smtcFilterSizeGet(board, &val))
 		{
 			printf("Fail to read!\n");
 			return ERROR;
 		}
 
-		printf("%d\n", (int)buff);
+		printf("%d\n", val);
 	}
 	else
 	{
@@ -837,12 +887,11 @@ int doFiltSizeRd(int argc, char *argv[])
 
 int doFiltSizeWrite(int argc, char *argv[])
 {
-	int dev = 0;
+	SmtcBoardType *board;
 	int val = 0;
-	u8 buff;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
 		return ERROR;
 	}
@@ -855,8 +904,7 @@ int doFiltSizeWrite(int argc, char *argv[])
 			printf("Invalid filter size value [1..40]\n");
 			return ERROR;
 		}
-		buff = 0xff & val;
-		if (FAIL == i2cMem8Write(dev, I2C_MAV_FILT_SIZE, &buff, 1))
+		if (SMTC_OK != smtcFilterSizeSet(board, val))
 		{
 			printf("Fail to write!\n");
 			return ERROR;
@@ -871,6 +919,199 @@ int doFiltSizeWrite(int argc, char *argv[])
 	return OK;
 }
 
+/*
+ * doTraceDump:
+ *	Decode a recorded trace, one line per transaction, followed by the
+ *	transaction count, error count and duration per slave
+ */
+int doTraceDump(int argc, char *argv[])
+{
+	TraceRecType rec;
+	FILE *f;
+	uint64_t start;
+	int cnt[COMM_BUS_MAX][8];
+	int err[COMM_BUS_MAX][8];
+	uint64_t durSum[COMM_BUS_MAX][8];
+	uint32_t durMax[COMM_BUS_MAX][8];
+	int summary = 0;
+	int ret, i, stack, bus;
+
+	if (argc != 3 && argc != 4)
+	{
+		return ARG_CNT_ERR;
+	}
+	summary = (argc == 4) && (0 == strcasecmp(argv[3], "sum"));
+	f = traceReadOpen(argv[2], &start);
+	if (NULL == f)
+	{
+		printf("Fail to open trace file %s!\n", argv[2]);
+		return ERROR;
+	}
+	memset(cnt, 0, sizeof(cnt));
+	memset(err, 0, sizeof(err));
+	memset(durSum, 0, sizeof(durSum));
+	memset(durMax, 0, sizeof(durMax));
+	memset(&rec, 0, sizeof(rec));
+	while ( (ret = traceReadNext(f, &rec)) == 1)
+	{
+		stack = rec.addr - SLAVE_OWN_ADDRESS_BASE;
+		if (rec.bus < COMM_BUS_MAX && stack >= 0 && stack < 8)
+		{
+			cnt[rec.bus][stack]++;
+			err[rec.bus][stack] += (rec.flags & TRACE_FLAG_ERR) ? 1 : 0;
+			durSum[rec.bus][stack] += rec.durUs;
+			if (rec.durUs > durMax[rec.bus][stack])
+			{
+				durMax[rec.bus][stack] = rec.durUs;
+			}
+		}
+		if (summary)
+		{
+			continue;
+		}
+		printf("%10llu %6u %2d 0x%02x %s 0x%02x", (unsigned long long)rec.tUs,
+			rec.durUs, rec.bus, rec.addr, rec.rdSize ? "R" : "W",
+			rec.wrSize ? rec.wr[0] : 0);
+		for (i = 1; i < rec.wrSize; i++)
+		{
+			printf(" %02x", rec.wr[i]);
+		}
+		if (rec.flags & TRACE_FLAG_ERR)
+		{
+			printf(" ERR");
+		}
+		else
+		{
+			for (i = 0; i < rec.rdSize; i++)
+			{
+				printf(" %02x", rec.rd[i]);
+			}
+		}
+		printf("\n");
+	}
+	fclose(f);
+	if (ret < 0)
+	{
+		printf("Trace truncated!\n");
+	}
+	for (bus = 0; bus < COMM_BUS_MAX; bus++)
+	{
+		for (stack = 0; stack < 8; stack++)
+		{
+			if (cnt[bus][stack])
+			{
+				printf("Bus %d Id %d: %d transactions, %d errors, %llu us avg, %u us max\n",
+					bus, stack, cnt[bus][stack], err[bus][stack],
+					(unsigned long long) (durSum[bus][stack] / cnt[bus][stack]),
+					durMax[bus][stack]);
+			}
+		}
+	}
+	return OK;
+}
+
+static int doCommand(int argc, char *argv[]);
+
+/*
+ * doBatch:
+ *	Run newline separated commands ("0 read 1", "1 stypewr 3 3", ...) in
+ *	this process. Card handles stay open between commands and the bus of a
+ *	card command is locked from its first use to the end of the batch, or
+ *	until a command that may start threads of its own: a command without
+ *	card id or "stream".
+ *	Empty lines and lines starting with '#' are skipped, a leading "smtc"
+ *	is ignored. Returns ERROR if any command failed.
+ */
+int doBatch(int argc, char *argv[])
+{
+	char line[BATCH_LINE_MAX];
+	char *args[BATCH_ARGS_MAX + 1];
+	int locked[COMM_BUS_MAX];
+	FILE *f = stdin;
+	char *tok, *save;
+	int n, bus, i;
+	int ret = OK;
+
+	if (argc == 3)
+	{
+		f = fopen(argv[2], "r");
+		if (NULL == f)
+		{
+			printf("Fail to open %s\n", argv[2]);
+			return ERROR;
+		}
+	}
+	else if (argc != 2)
+	{
+		return ARG_CNT_ERR;
+	}
+	memset(locked, 0, sizeof(locked));
+	while (NULL != fgets(line, sizeof(line), f))
+	{
+		n = 1;
+		args[0] = argv[0];
+		for (tok = strtok_r(line, " \t\r\n", &save);
+			tok != NULL && n < BATCH_ARGS_MAX;
+			tok = strtok_r(NULL, " \t\r\n", &save))
+		{
+			if (n == 1 && 0 == strcmp(tok, "smtc"))
+			{
+				continue;
+			}
+			args[n++] = tok;
+		}
+		args[n] = NULL;
+		if (n == 1 || args[1][0] == '#')
+		{
+			continue;
+		}
+		if (0 == strcasecmp(args[1], CMD_BATCH.name))
+		{
+			printf("Nested batch not allowed\n");
+			ret = ERROR;
+			continue;
+		}
+		if (args[1][0] != '-'
+			&& (n < 3 || 0 != strcasecmp(args[2], CMD_STREAM.name)))
+		{
+			bus = doIdBus(args[1]);
+			if (bus >= 0 && bus < COMM_BUS_MAX && !locked[bus])
+			{
+				commLock(bus);
+				locked[bus] = 1;
+			}
+		}
+		else
+		{
+			for (i = 0; i < COMM_BUS_MAX; i++)
+			{
+				if (locked[i])
+				{
+					commUnlock(i);
+					locked[i] = 0;
+				}
+			}
+		}
+		if (OK != doCommand(n, args))
+		{
+			ret = ERROR;
+		}
+		fflush(stdout);
+	}
+	for (i = 0; i < COMM_BUS_MAX; i++)
+	{
+		if (locked[i])
+		{
+			commUnlock(i);
+		}
+	}
+	if (f != stdin)
+	{
+		fclose(f);
+	}
+	return ret;
+}
+
 void usage(void)
 {
 	int i = 0;
@@ -889,25 +1130,22 @@ void usage(void)
 		}
 		i++;
 	}
-	printf("Where: <id> = Board level id = 0..7\n");
+	printf("Where: <id> = Board level id = 0..7, or <bus>:<id> for a card on another i2c bus\n");
+	printf("Options: --bus <bus>[,<bus>...] select the i2c bus(es), default 1 (SMTC_BUS)\n");
+	printf("         --format text|json|csv|bin output format, default text (SMTC_FORMAT)\n");
 	printf("Type smtc -h <command> for more help\n");
 }
 
-int main(int argc, char *argv[])
+/*
+ * doCommand:
+ *	Find the command in gCmdArray and run it. Returns the command result,
+ *	or -1 for an unknown command.
+ */
+static int doCommand(int argc, char *argv[])
 {
 	int i = 0;
-	int ret = OK;
+	int ret;
 
-	if (argc == 1)
-	{
-		usage();
-		return -1;
-	}
-#ifdef THREAD_SAFE
-	sem_t *semaphore = sem_open("/SMI2C_SEM", O_CREAT, 0666, 1);
-	int semVal = 2;
-	sem_wait(semaphore);
-#endif
 	while (NULL != gCmdArray[i])
 	{
 		if ( (gCmdArray[i]->name != NULL) && (gCmdArray[i]->namePos < argc))
@@ -932,13 +1170,6 @@ int main(int argc, char *argv[])
 						printf("%s", gCmdArray[i]->usage2);
 					}
 				}
-#ifdef THREAD_SAFE
-				sem_getvalue(semaphore, &semVal);
-				if (semVal < 1)
-				{
-					sem_post(semaphore);
-				}
-#endif
 				return ret;
 			}
 		}
@@ -946,12 +1177,61 @@ int main(int argc, char *argv[])
 	}
 	printf("Invalid command option\n");
 	usage();
-#ifdef THREAD_SAFE
-	sem_getvalue(semaphore, &semVal);
-	if (semVal < 1)
+	return -1;
+}
+
+/*
+ * main:
+ *	Global options come before the command. Every bus transaction holds the
+ *	bus lock shared with the other Sequent Microsystems tools (see
+ *	commLock()), so there is no command wide lock.
+ */
+int main(int argc, char *argv[])
+{
+	const char *env;
+
+	env = getenv("SMTC_BUS");
+	if (env && *env && OK != doBusSelect(env))
 	{
-		sem_post(semaphore);
+		return -1;
 	}
-#endif
-	return -1;
+	env = getenv("SMTC_FORMAT");
+	if (env && *env && 0 != outFormatSet(env))
+	{
+		printf("Invalid format %s [text/json/csv/bin]\n", env);
+		return -1;
+	}
+	while (argc > 1 && 0 == strncmp(argv[1], "--", 2))
+	{
+		if (0 == strcmp(argv[1], "--bus") && argc > 2)
+		{
+			if (OK != doBusSelect(argv[2]))
+			{
+				return -1;
+			}
+		}
+		else if (0 == strcmp(argv[1], "--format") && argc > 2)
+		{
+			if (0 != outFormatSet(argv[2]))
+			{
+				printf("Invalid format %s [text/json/csv/bin]\n", argv[2]);
+				return -1;
+			}
+		}
+		else
+		{
+			printf("Invalid option %s\n", argv[1]);
+			usage();
+			return -1;
+		}
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+	}
+	if (argc == 1)
+	{
+		usage();
+		return -1;
+	}
+	return doCommand(argc, argv);
 }
@@ -2,6 +2,7 @@
 #define SMTC_H_
 
 #include <stdint.h>
+#include "libsmtc.h"
 
 
 #define RETRY_TIMES	10
@@ -137,8 +138,14 @@ typedef struct
 
 //const CliCmdType *gCmdArray[];
 
-int doBoardInit(int stack);
-int rtdHwTypeGet(int dev, int* hw);
+SmtcBoardType* doBoardOpen(const char *id);
+void doOutBoard(const SmtcBoardType *board);
+void doOutChannel(const SmtcBoardType *board, int ch);
+void doOutDiag(const SmtcDiagRawType *diag);
+int doBusDefault(void);
+int doBusList(int *list, int max);
+int doUserBegin(void);
+int doUserEnd(void);
 
 //LED's
 extern const CliCmdType CMD_READ_LED_MODE;
@@ -161,4 +168,15 @@ extern const CliCmdType CMD_WDT_GET_OFF_PERIOD;
 extern const CliCmdType CMD_WDT_GET_RESETS_COUNT;
 extern const CliCmdType CMD_WDT_CLR_RESETS_COUNT;
 
+//Bus test
+extern const CliCmdType CMD_BUS_TEST;
+
+//Acquisition
+extern const CliCmdType CMD_POLL;
+extern const CliCmdType CMD_STREAM;
+extern const CliCmdType CMD_SCHED;
+extern const CliCmdType CMD_BENCH;
+extern const CliCmdType CMD_FLIGHT;
+extern const CliCmdType CMD_ANALYZE;
+
 #endif //SMTC_H_
@@ -1,7 +1,10 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <termios.h>
 #include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
 
 #include "thread.h"
 
@@ -64,6 +67,59 @@ int piHiPri (const int pri)
   return sched_setscheduler (0, SCHED_RR, &sched) ;
 }
 
+/*
+ * piThreadRt:
+ *	Pin the calling thread to one cpu (< 0 - leave it free) and run it
+ *	SCHED_FIFO at priority pri (0 - keep the normal scheduling)
+ *********************************************************************************
+ */
+
+int piThreadRt (const int cpu, const int pri)
+{
+  struct sched_param sched ;
+  cpu_set_t set ;
+  int ret = 0 ;
+
+  if (cpu >= 0)
+  {
+    CPU_ZERO (&set) ;
+    CPU_SET (cpu, &set) ;
+    if (pthread_setaffinity_np (pthread_self (), sizeof (set), &set) != 0)
+      ret = -1 ;
+  }
+  if (pri > 0)
+  {
+    memset (&sched, 0, sizeof(sched)) ;
+    if (pri > sched_get_priority_max (SCHED_FIFO))
+      sched.sched_priority = sched_get_priority_max (SCHED_FIFO) ;
+    else
+      sched.sched_priority = pri ;
+    if (pthread_setschedparam (pthread_self (), SCHED_FIFO, &sched) != 0)
+      ret = -1 ;
+  }
+  return ret ;
+}
+
+/*
+ * piMemLock:
+ *	Lock all the pages of the process in memory, the current and the
+ *	future ones, and fault in some stack now so a real time loop does not
+ *	take page faults later
+ *********************************************************************************
+ */
+
+int piMemLock (void)
+{
+  volatile unsigned char stack [PI_STACK_PREFAULT] ;
+  int i ;
+
+  if (mlockall (MCL_CURRENT | MCL_FUTURE) != 0)
+    return -1 ;
+  for (i = 0 ; i < PI_STACK_PREFAULT ; i += 1024)
+    stack [i] = 0 ;
+  return stack [0] ;
+}
+
 /*
  * upThreadCreate:
  *	Create and start a thread
@@ -8,9 +8,13 @@
 
 #define	PI_THREAD(X)	void *X (UNU void *dummy)
 
+#define PI_STACK_PREFAULT	(64 * 1024)
+
 
 void busyWait(int ms);
 void startThread(void);
 int checkThreadResult(void);
+int piThreadRt(const int cpu, const int pri);
+int piMemLock(void);
 
 #endif
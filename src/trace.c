@@ -0,0 +1,334 @@
+/*
+ * trace.c:
+ *	Bus traffic recorder and the replay transport backend
+ *
+ *	A trace is a small header followed by one variable size record per bus
+ *	transaction: time since the previous record, duration, bus, slave
+ *	address, error flag, written bytes and (on success) read bytes.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+#define TRACE_HEADER_SIZE	16
+#define TRACE_REC_HEAD_SIZE	13
+
+static FILE *gRecFile = NULL;
+static uint64_t gRecLastUs = 0;
+static pthread_mutex_t gRecMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static TraceRecType *gReplay = NULL;
+static int gReplayCount = 0;
+static int gReplayCursor = 0;
+static int gReplayTiming = 1;
+static pthread_mutex_t gReplayMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void tracePut32(uint8_t *p, uint32_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+static uint32_t traceGet32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16)
+		| ((uint32_t)p[3] << 24);
+}
+
+//************************ Recorder ****************************
+
+int traceRecordOpen(const char *fileName)
+{
+	uint8_t head[TRACE_HEADER_SIZE];
+	struct timeval tv;
+	uint64_t wall;
+
+	gRecFile = fopen(fileName, "wb");
+	if (NULL == gRecFile)
+	{
+		return -1;
+	}
+	gettimeofday(&tv, NULL);
+	wall = (uint64_t)tv.tv_sec * 1000000ULL + tv.tv_usec;
+	memset(head, 0, sizeof(head));
+	memcpy(head, TRACE_MAGIC, 4);
+	head[4] = TRACE_VERSION;
+	tracePut32(&head[8], (uint32_t)wall);
+	tracePut32(&head[12], (uint32_t)(wall >> 32));
+	if (fwrite(head, sizeof(head), 1, gRecFile) != 1)
+	{
+		fclose(gRecFile);
+		gRecFile = NULL;
+		return -1;
+	}
+	gRecLastUs = commTimeUs();
+	return 0;
+}
+
+int traceRecordActive(void)
+{
+	return gRecFile != NULL;
+}
+
+void traceRecord(int bus, int addr, uint64_t startUs, uint32_t durUs,
+	const uint8_t *wr, int wrSize, const uint8_t *rd, int rdSize, int err)
+{
+	uint8_t buff[TRACE_REC_HEAD_SIZE + 2 * COMM_XFER_MAX];
+	uint64_t dt;
+	int len = TRACE_REC_HEAD_SIZE;
+
+	pthread_mutex_lock(&gRecMutex);
+	if (NULL == gRecFile)
+	{
+		pthread_mutex_unlock(&gRecMutex);
+		return;
+	}
+	dt = startUs > gRecLastUs ? startUs - gRecLastUs : 0;
+	gRecLastUs = startUs;
+	tracePut32(&buff[0], dt > UINT32_MAX ? UINT32_MAX : (uint32_t)dt);
+	tracePut32(&buff[4], durUs);
+	buff[8] = (uint8_t)bus;
+	buff[9] = (uint8_t)addr;
+	buff[10] = err ? TRACE_FLAG_ERR : 0;
+	buff[11] = (uint8_t)wrSize;
+	buff[12] = (uint8_t)rdSize;
+	memcpy(&buff[len], wr, wrSize);
+	len += wrSize;
+	if (!err && rdSize > 0)
+	{
+		memcpy(&buff[len], rd, rdSize);
+		len += rdSize;
+	}
+	fwrite(buff, len, 1, gRecFile);
+	pthread_mutex_unlock(&gRecMutex);
+}
+
+//************************ Reader ****************************
+
+FILE* traceReadOpen(const char *fileName, uint64_t *startUs)
+{
+	uint8_t head[TRACE_HEADER_SIZE];
+	FILE *f = fopen(fileName, "rb");
+
+	if (NULL == f)
+	{
+		return NULL;
+	}
+	if (fread(head, sizeof(head), 1, f) != 1 || memcmp(head, TRACE_MAGIC, 4)
+		|| head[4] != TRACE_VERSION)
+	{
+		fclose(f);
+		return NULL;
+	}
+	if (startUs)
+	{
+		*startUs = traceGet32(&head[8]) | ((uint64_t)traceGet32(&head[12]) << 32);
+	}
+	return f;
+}
+
+/*
+ * traceReadNext:
+ *	Returns 1 when a record was read, 0 at the end of the file, -1 on a
+ *	truncated or corrupt record. rec->tUs accumulates, so pass the same
+ *	record structure (zeroed before the first call) on every call.
+ */
+int traceReadNext(FILE *f, TraceRecType *rec)
+{
+	uint8_t head[TRACE_REC_HEAD_SIZE];
+	size_t n;
+
+	n = fread(head, 1, sizeof(head), f);
+	if (n == 0)
+	{
+		return 0;
+	}
+	if (n != sizeof(head))
+	{
+		return -1;
+	}
+	rec->tUs += traceGet32(&head[0]);
+	rec->durUs = traceGet32(&head[4]);
+	rec->bus = head[8];
+	rec->addr = head[9];
+	rec->flags = head[10];
+	rec->wrSize = head[11];
+	rec->rdSize = head[12];
+	if (rec->wrSize > COMM_XFER_MAX || rec->rdSize > COMM_XFER_MAX)
+	{
+		return -1;
+	}
+	if (rec->wrSize && fread(rec->wr, rec->wrSize, 1, f) != 1)
+	{
+		return -1;
+	}
+	if (! (rec->flags & TRACE_FLAG_ERR) && rec->rdSize
+		&& fread(rec->rd, rec->rdSize, 1, f) != 1)
+	{
+		return -1;
+	}
+	return 1;
+}
+
+//************************ Replay backend ****************************
+
+int traceReplayLoad(const char *fileName)
+{
+	TraceRecType rec;
+	TraceRecType *aux;
+	const char *env;
+	int size = 0;
+	FILE *f;
+
+	f = traceReadOpen(fileName, NULL);
+	if (NULL == f)
+	{
+		return -1;
+	}
+	memset(&rec, 0, sizeof(rec));
+	free(gReplay);
+	gReplay = NULL;
+	gReplayCount = 0;
+	gReplayCursor = 0;
+	while (traceReadNext(f, &rec) == 1)
+	{
+		if (gReplayCount == size)
+		{
+			size = size ? 2 * size : 1024;
+			aux = realloc(gReplay, size * sizeof(TraceRecType));
+			if (NULL == aux)
+			{
+				break;
+			}
+			gReplay = aux;
+		}
+		gReplay[gReplayCount++] = rec;
+	}
+	fclose(f);
+	env = getenv("SMTC_REPLAY_TIMING");
+	gReplayTiming = env ? atoi(env) : 1;
+	return gReplayCount > 0 ? 0 : -1;
+}
+
+static int replayOpen(int bus)
+{
+	int i;
+
+	for (i = 0; i < gReplayCount; i++)
+	{
+		if (gReplay[i].bus == bus)
+		{
+			return bus;
+		}
+	}
+	return -1;
+}
+
+static int replayClose(int handle)
+{
+	(void)handle;
+	return 0;
+}
+
+static int replayMatch(const TraceRecType *r, int bus, int addr,
+	const uint8_t *wr, int wrSize, int rdSize)
+{
+	return r->bus == bus && r->addr == addr && r->wrSize == wrSize
+		&& r->rdSize == rdSize && 0 == memcmp(r->wr, wr, wrSize);
+}
+
+// the slave shows up somewhere in the recording
+static int replayKnown(int bus, int addr)
+{
+	int i;
+
+	for (i = 0; i < gReplayCount; i++)
+	{
+		if (gReplay[i].bus == bus && gReplay[i].addr == addr)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * replayXfer:
+ *	Serve the next recorded transaction with the same bus, slave, written
+ *	bytes and read size, searching forward from the previous match and
+ *	wrapping around, and spend the recorded duration doing it. Writes that
+ *	were never recorded succeed so a modified poller can still be replayed.
+ */
+static int replayXfer(int handle, int addr, const uint8_t *wr, int wrSize,
+	uint8_t *rd, int rdSize)
+{
+	const TraceRecType *r = NULL;
+	struct timespec ts;
+	int i, idx;
+
+	pthread_mutex_lock(&gReplayMutex);
+	for (i = 0; i < gReplayCount; i++)
+	{
+		idx = (gReplayCursor + i) % gReplayCount;
+		if (replayMatch(&gReplay[idx], handle, addr, wr, wrSize, rdSize))
+		{
+			r = &gReplay[idx];
+			gReplayCursor = idx + 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&gReplayMutex);
+	if (NULL == r)
+	{
+		return rdSize > 0 || !replayKnown(handle, addr) ? -1 : 0;
+	}
+	if (gReplayTiming && r->durUs > 0)
+	{
+		ts.tv_sec = r->durUs / 1000000;
+		ts.tv_nsec = (long)(r->durUs % 1000000) * 1000;
+		nanosleep(&ts, NULL);
+	}
+	if (r->flags & TRACE_FLAG_ERR)
+	{
+		return -1;
+	}
+	if (rdSize > 0)
+	{
+		memcpy(rd, r->rd, rdSize);
+	}
+	return 0;
+}
+
+static int replayBuses(int *list, int max)
+{
+	uint32_t seen = 0;
+	int i;
+	int n = 0;
+
+	for (i = 0; i < gReplayCount && n < max; i++)
+	{
+		if (gReplay[i].bus < COMM_BUS_MAX && !(seen & (1u << gReplay[i].bus)))
+		{
+			seen |= 1u << gReplay[i].bus;
+			list[n++] = gReplay[i].bus;
+		}
+	}
+	return n;
+}
+
+const CommTransportType COMM_TRANSPORT_REPLAY =
+	{"replay", &replayOpen, &replayClose, &replayXfer, &replayBuses};
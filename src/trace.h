@@ -0,0 +1,37 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "comm.h"
+
+#define TRACE_MAGIC		"SMTR"
+#define TRACE_VERSION	1
+#define TRACE_FLAG_ERR	0x01
+
+typedef struct
+{
+	uint64_t tUs; // start of the transaction, relative to the trace start
+	uint32_t durUs;
+	uint8_t bus;
+	uint8_t addr;
+	uint8_t flags;
+	uint8_t wrSize;
+	uint8_t rdSize;
+	uint8_t wr[COMM_XFER_MAX];
+	uint8_t rd[COMM_XFER_MAX];
+} TraceRecType;
+
+extern const CommTransportType COMM_TRANSPORT_REPLAY;
+
+int traceRecordOpen(const char *fileName);
+int traceRecordActive(void);
+void traceRecord(int bus, int addr, uint64_t startUs, uint32_t durUs,
+	const uint8_t *wr, int wrSize, const uint8_t *rd, int rdSize, int err);
+
+FILE* traceReadOpen(const char *fileName, uint64_t *startUs);
+int traceReadNext(FILE *f, TraceRecType *rec);
+
+int traceReplayLoad(const char *fileName);
+
+#endif //TRACE_H_
@@ -2,9 +2,10 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include "comm.h"
+#include "libsmtc.h"
 
 #include "wdt.h"
+#include "out.h"
 
 extern const CliCmdType *gCmdArray[];
 //************************ WDT PART ****************************
@@ -21,31 +22,26 @@ const CliCmdType CMD_WDT_RELOAD =
 
 int doWdtReload(int argc, char *argv[])
 {
-	int dev = 0;
-	u8 buff[2] =
-	{
-		0,
-		0};
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 3)
 	{
-		buff[0] = WDT_RESET_SIGNATURE;
-		if (OK != i2cMem8Write(dev, I2C_MEM_WDT_RESET_ADD, buff, 1))
+		if (SMTC_OK != smtcWdtReload(board))
 		{
 			printf("Fail to write watchdog reset key!\n");
-			exit(1);
+			return ERROR;
 		}
 	}
 	else
 	{
 		printf("Invalid params number:\n %s", CMD_WDT_RELOAD.usage1);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -63,17 +59,13 @@ const CliCmdType CMD_WDT_SET_PERIOD =
 
 int doWdtSetPeriod(int argc, char *argv[])
 {
-	int dev = 0;
-	u16 period;
-	u8 buff[2] =
-	{
-		0,
-		0};
+	SmtcBoardType *board;
+	int period;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 4)
@@ -82,19 +74,18 @@ int doWdtSetPeriod(int argc, char *argv[])
 		if (0 == period)
 		{
 			printf("Invalid period!\n");
-			exit(1);
+			return ERROR;
 		}
-		memcpy(buff, &period, 2);
-		if (OK != i2cMem8Write(dev, I2C_MEM_WDT_INTERVAL_SET_ADD, buff, 2))
+		if (SMTC_OK != smtcWdtPeriodSet(board, period))
 		{
 			printf("Fail to write watchdog period!\n");
-			exit(1);
+			return ERROR;
 		}
 	}
 	else
 	{
 		printf("Invalid params number:\n %s", CMD_WDT_SET_PERIOD.usage1);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -112,33 +103,30 @@ const CliCmdType CMD_WDT_GET_PERIOD =
 
 int doWdtGetPeriod(int argc, char *argv[])
 {
-	int dev = 0;
-	u16 period;
-	u8 buff[2] =
-	{
-		0,
-		0};
+	SmtcBoardType *board;
+	int period;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 3)
 	{
-		if (OK != i2cMem8Read(dev, I2C_MEM_WDT_INTERVAL_GET_ADD, buff, 2))
+		if (SMTC_OK != smtcWdtPeriodGet(board, &period))
 		{
 			printf("Fail to read watchdog period!\n");
-			exit(1);
+			return ERROR;
 		}
-		memcpy(&period, buff, 2);
-		printf("%d\n", (int)period);
+		doOutBoard(board);
+		outInt("period", period);
+		outEnd();
 	}
 	else
 	{
 		printf("Invalid params number:\n %s", CMD_WDT_GET_PERIOD.usage1);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -156,17 +144,13 @@ const CliCmdType CMD_WDT_SET_INIT_PERIOD =
 
 int doWdtSetInitPeriod(int argc, char *argv[])
 {
-	int dev = 0;
-	u16 period;
-	u8 buff[2] =
-	{
-		0,
-		0};
+	SmtcBoardType *board;
+	int period;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 4)
@@ -175,19 +159,18 @@ int doWdtSetInitPeriod(int argc, char *argv[])
 		if (0 == period)
 		{
 			printf("Invalid period!\n");
-			exit(1);
+			return ERROR;
 		}
-		memcpy(buff, &period, 2);
-		if (OK != i2cMem8Write(dev, I2C_MEM_WDT_INIT_INTERVAL_SET_ADD, buff, 2))
+		if (SMTC_OK != smtcWdtInitPeriodSet(board, period))
 		{
 			printf("Fail to write watchdog period!\n");
-			exit(1);
+			return ERROR;
 		}
 	}
 	else
 	{
 		printf("Invalid params number:\n %s", CMD_WDT_SET_INIT_PERIOD.usage1);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -205,33 +188,30 @@ const CliCmdType CMD_WDT_GET_INIT_PERIOD =
 
 int doWdtGetInitPeriod(int argc, char *argv[])
 {
-	int dev = 0;
-	u16 period;
-	u8 buff[2] =
-	{
-		0,
-		0};
+	SmtcBoardType *board;
+	int period;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 3)
 	{
-		if (OK != i2cMem8Read(dev, I2C_MEM_WDT_INIT_INTERVAL_GET_ADD, buff, 2))
+		if (SMTC_OK != smtcWdtInitPeriodGet(board, &period))
 		{
 			printf("Fail to read watchdog period!\n");
-			exit(1);
+			return ERROR;
 		}
-		memcpy(&period, buff, 2);
-		printf("%d\n", (int)period);
+		doOutBoard(board);
+		outInt("init_period", period);
+		outEnd();
 	}
 	else
 	{
 		printf("Invalid params number:\n %s", CMD_WDT_GET_INIT_PERIOD.usage1);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -249,41 +229,33 @@ const CliCmdType CMD_WDT_SET_OFF_PERIOD =
 
 int doWdtSetOffPeriod(int argc, char *argv[])
 {
-	int dev = 0;
-	u32 period;
-	u8 buff[4] =
-	{
-		0,
-		0,
-		0,
-		0};
+	SmtcBoardType *board;
+	int period;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 4)
 	{
 		period = (u32)atoi(argv[3]);
-		if ( (0 == period) || (period > WDT_MAX_OFF_INTERVAL_S))
+		if ( (0 == period) || ((u32)period > WDT_MAX_OFF_INTERVAL_S))
 		{
 			printf("Invalid period!\n");
-			exit(1);
+			return ERROR;
 		}
-		memcpy(buff, &period, 4);
-		if (OK
-			!= i2cMem8Write(dev, I2C_MEM_WDT_POWER_OFF_INTERVAL_SET_ADD, buff, 4))
+		if (SMTC_OK != smtcWdtOffPeriodSet(board, period))
 		{
 			printf("Fail to write watchdog period!\n");
-			exit(1);
+			return ERROR;
 		}
 	}
 	else
 	{
 		printf("Invalid params number:\n %s", CMD_WDT_SET_OFF_PERIOD.usage1);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -301,36 +273,30 @@ const CliCmdType CMD_WDT_GET_OFF_PERIOD =
 
 int doWdtGetOffPeriod(int argc, char *argv[])
 {
-	int dev = 0;
-	u32 period;
-	u8 buff[4] =
-	{
-		0,
-		0,
-		0,
-		0};
+	SmtcBoardType *board;
+	int period;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
-		exit(1);
+		return ERROR;
 	}
 
 	if (argc == 3)
 	{
-		if (OK
-			!= i2cMem8Read(dev, I2C_MEM_WDT_POWER_OFF_INTERVAL_GET_ADD, buff, 4))
+		if (SMTC_OK != smtcWdtOffPeriodGet(board, &period))
 		{
 			printf("Fail to read watchdog period!\n");
-			exit(1);
+			return ERROR;
 		}
-		memcpy(&period, buff, 4);
-		printf("%d\n", (int)period);
+		doOutBoard(board);
+		outInt("off_period", period);
+		outEnd();
 	}
 	else
 	{
 		printf("Invalid params number:\n %s", CMD_WDT_GET_OFF_PERIOD.usage1);
-		exit(1);
+		return ERROR;
 	}
 	return OK;
 }
@@ -348,28 +314,25 @@ const CliCmdType CMD_WDT_GET_RESETS_COUNT =
 
 int doWdtGetResetCount(int argc, char *argv[])
 {
-	int dev = 0;
-	u16 period;
-	u8 buff[2] =
-	{
-		0,
-		0};
+	SmtcBoardType *board;
+	int period;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
 		return ERROR;
 	}
 
 	if (argc == 3)
 	{
-		if (OK != i2cMem8Read(dev, I2C_MEM_WDT_RESET_COUNT_ADD, buff, 2))
+		if (SMTC_OK != smtcWdtResetCountGet(board, &period))
 		{
 			printf("Fail to read watchdog reset count!\n");
 			return ERROR;
 		}
-		memcpy(&period, buff, 2);
-		printf("%d\n", (int)period);
+		doOutBoard(board);
+		outInt("resets", period);
+		outEnd();
 	}
 	else
 	{
@@ -392,22 +355,17 @@ const CliCmdType CMD_WDT_CLR_RESETS_COUNT =
 
 int doWdtClearResets(int argc, char *argv[])
 {
-	int dev = 0;
-	u8 buff[2] =
-	{
-		0,
-		0};
+	SmtcBoardType *board;
 
-	dev = doBoardInit(atoi(argv[1]));
-	if (dev <= 0)
+	board = doBoardOpen(argv[1]);
+	if (NULL == board)
 	{
 		return ERROR;
 	}
 
 	if (argc == 3)
 	{
-		buff[0] = WDT_RESET_COUNT_SIGNATURE;
-		if (OK != i2cMem8Write(dev, I2C_MEM_WDT_CLEAR_RESET_COUNT_ADD, buff, 1))
+		if (SMTC_OK != smtcWdtResetCountClear(board))
 		{
 			printf("Fail to clear the reset count!\n");
 			return ERROR;
@@ -0,0 +1,199 @@
+/*
+ * wheel.c:
+ *	Hierarchical timer wheel: 256 one tick slots, then two levels of 64
+ *	slots each covering 64 times the range of the level below. Adding and
+ *	expiring a timer is O(1), timers on the upper levels are moved down
+ *	(cascaded) when the lower level wraps. No allocation, the caller owns
+ *	the timers.
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "wheel.h"
+
+static void wheelListInit(WheelTimerType *head)
+{
+	head->next = head;
+	head->prev = head;
+}
+
+static void wheelListAdd(WheelTimerType *head, WheelTimerType *t)
+{
+	t->prev = head->prev;
+	t->next = head;
+	head->prev->next = t;
+	head->prev = t;
+}
+
+void wheelInit(WheelType *w, uint64_t now)
+{
+	int i, l;
+
+	memset(w, 0, sizeof(WheelType));
+	w->now = now;
+	for (i = 0; i < WHEEL_SLOTS0; i++)
+	{
+		wheelListInit(&w->slot0[i]);
+	}
+	for (l = 0; l < WHEEL_LEVELS - 1; l++)
+	{
+		for (i = 0; i < WHEEL_SLOTS; i++)
+		{
+			wheelListInit(&w->slot[l][i]);
+		}
+	}
+}
+
+static int wheelShift(int level)
+{
+	return WHEEL_BITS0 + level * WHEEL_BITS;
+}
+
+/*
+ * wheelPlace:
+ *	Put a timer in the slot matching its distance from "now"; a timer due
+ *	"now" goes to the slot about to be run. Timers beyond the range of the
+ *	top level wait in the top level and are placed again when it cascades.
+ */
+static void wheelPlace(WheelType *w, WheelTimerType *t)
+{
+	uint64_t exp = t->expires;
+	uint64_t delta;
+	int l;
+
+	delta = exp - w->now;
+	if (delta < WHEEL_SLOTS0)
+	{
+		wheelListAdd(&w->slot0[exp & (WHEEL_SLOTS0 - 1)], t);
+		return;
+	}
+	for (l = 0; l < WHEEL_LEVELS - 2; l++)
+	{
+		if (delta < (1ULL << wheelShift(l + 1)))
+		{
+			break;
+		}
+	}
+	if (delta >= (1ULL << wheelShift(WHEEL_LEVELS - 1)))
+	{
+		exp = w->now + (1ULL << wheelShift(WHEEL_LEVELS - 1)) - 1;
+	}
+	wheelListAdd(&w->slot[l][(exp >> wheelShift(l)) & (WHEEL_SLOTS - 1)], t);
+}
+
+/*
+ * wheelAdd:
+ *	Start a timer expiring at tick t->expires, at the earliest the tick
+ *	after the last processed one
+ */
+void wheelAdd(WheelType *w, WheelTimerType *t)
+{
+	if (t->expires <= w->now)
+	{
+		t->expires = w->now + 1;
+	}
+	wheelPlace(w, t);
+}
+
+void wheelDel(WheelTimerType *t)
+{
+	if (NULL != t->next)
+	{
+		t->prev->next = t->next;
+		t->next->prev = t->prev;
+		t->next = t->prev = NULL;
+	}
+}
+
+static void wheelCascade(WheelType *w, int level)
+{
+	WheelTimerType *head, *t, *next;
+
+	head = &w->slot[level][(w->now >> wheelShift(level)) & (WHEEL_SLOTS - 1)];
+	t = head->next;
+	wheelListInit(head);
+	while (t != head)
+	{
+		next = t->next;
+		wheelPlace(w, t);
+		t = next;
+	}
+}
+
+/*
+ * wheelAdvance:
+ *	Move the wheel to tick "now" and collect up to "max" expired timers.
+ *	Periodic timers are put back for their next expiry, one shot timers
+ *	leave the wheel. Timers that could not be returned stay due for the
+ *	next call.
+ */
+int wheelAdvance(WheelType *w, uint64_t now, WheelTimerType **due, int max)
+{
+	WheelTimerType *head, *t;
+	int n = 0;
+	int l;
+
+	for (;;)
+	{
+		// the slot of the last processed tick holds what did not fit before
+		head = &w->slot0[w->now & (WHEEL_SLOTS0 - 1)];
+		while (head->next != head && n < max)
+		{
+			t = head->next;
+			wheelDel(t);
+			due[n++] = t;
+			if (t->period > 0)
+			{
+				t->expires = w->now + t->period;
+				wheelPlace(w, t);
+			}
+		}
+		if (n >= max || w->now >= now)
+		{
+			break;
+		}
+		w->now++;
+		for (l = 0; l < WHEEL_LEVELS - 1; l++)
+		{
+			if ( (w->now & ((1ULL << wheelShift(l)) - 1)) != 0)
+			{
+				break;
+			}
+			wheelCascade(w, l);
+		}
+	}
+	return n;
+}
+
+/*
+ * wheelNext:
+ *	Earliest tick with a timer in the first level, or the end of the first
+ *	level when it is empty (the upper levels cascade there). Sleeping until
+ *	then never misses a timer.
+ */
+uint64_t wheelNext(const WheelType *w)
+{
+	uint64_t tick;
+
+	for (tick = w->now + 1; tick <= w->now + WHEEL_SLOTS0; tick++)
+	{
+		if (w->slot0[tick & (WHEEL_SLOTS0 - 1)].next
+			!= &w->slot0[tick & (WHEEL_SLOTS0 - 1)])
+		{
+			return tick;
+		}
+		if ( (tick & (WHEEL_SLOTS0 - 1)) == 0)
+		{
+			return tick; // cascade point
+		}
+	}
+	return w->now + WHEEL_SLOTS0;
+}
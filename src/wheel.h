@@ -0,0 +1,34 @@
+#ifndef WHEEL_H_
+#define WHEEL_H_
+
+#include <stdint.h>
+
+#define WHEEL_LEVELS		3
+#define WHEEL_BITS0			8
+#define WHEEL_BITS			6
+#define WHEEL_SLOTS0		(1 << WHEEL_BITS0)
+#define WHEEL_SLOTS			(1 << WHEEL_BITS)
+
+typedef struct WheelTimer
+{
+	struct WheelTimer *next;
+	struct WheelTimer *prev;
+	uint64_t expires; // tick
+	uint32_t period; // ticks, 0 - one shot
+	void *arg;
+} WheelTimerType;
+
+typedef struct
+{
+	uint64_t now; // last processed tick
+	WheelTimerType slot0[WHEEL_SLOTS0]; // list heads
+	WheelTimerType slot[WHEEL_LEVELS - 1][WHEEL_SLOTS];
+} WheelType;
+
+void wheelInit(WheelType *w, uint64_t now);
+void wheelAdd(WheelType *w, WheelTimerType *t);
+void wheelDel(WheelTimerType *t);
+int wheelAdvance(WheelType *w, uint64_t now, WheelTimerType **due, int max);
+uint64_t wheelNext(const WheelType *w);
+
+#endif //WHEEL_H_
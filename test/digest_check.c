@@ -0,0 +1,72 @@
+/*
+ * digest_check.c:
+ *	Checks of the t-digest: merges of digests with partly full buffers,
+ *	built with the address sanitizer by "make check".
+ *
+ *	Copyright (c) 2016-2023 Sequent Microsystem
+ *	<http://www.sequentmicrosystem.com>
+ ***********************************************************************
+ *	Author: Alexandru Burcea
+ ***********************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "digest.h"
+
+static int gFail = 0;
+
+static void check(int cond, const char *what)
+{
+	if (!cond)
+	{
+		printf("FAIL: %s\n", what);
+		gFail = 1;
+	}
+}
+
+/*
+ * fill:
+ *	"n" values of a ramp from lo, leaving "n" mod DIGEST_BUFFER of them in
+ *	the buffer
+ */
+static void fill(DigestType *d, float lo, int n)
+{
+	int i;
+
+	digestInit(d);
+	for (i = 0; i < n; i++)
+	{
+		digestAdd(d, lo + (float)i);
+	}
+}
+
+int main(void)
+{
+	static DigestType a, b, c;
+	float q;
+
+	// both digests hold centroids and an almost full buffer
+	fill(&a, 0, 20 * DIGEST_BUFFER - 1);
+	fill(&b, 20 * DIGEST_BUFFER - 1, 20 * DIGEST_BUFFER - 1);
+	check(a.buffered == DIGEST_BUFFER - 1 && b.buffered == DIGEST_BUFFER - 1,
+		"buffers partly full");
+	digestMerge(&a, &b);
+	check(a.count == 2.0 * (20 * DIGEST_BUFFER - 1), "merged count");
+	check(a.min == 0 && a.max == 40 * DIGEST_BUFFER - 3, "merged extremes");
+	q = digestQuantile(&a, 0.5);
+	check(fabsf(q - (20 * DIGEST_BUFFER - 1)) < 0.01f * 40 * DIGEST_BUFFER,
+		"merged median");
+	q = digestQuantile(&a, 0.99);
+	check(fabsf(q - 0.99f * (40 * DIGEST_BUFFER - 2)) < 0.005f * 40 * DIGEST_BUFFER,
+		"merged p99");
+
+	// a digest of buffered values only into one with centroids
+	fill(&c, 0, 10);
+	digestMerge(&c, &a);
+	check(c.count == a.count + 10, "merge into a buffer only digest");
+
+	printf("digest: %s\n", gFail ? "failed" : "ok");
+	return gFail;
+}